@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ACTIONPLAN_H
+#define ACTIONPLAN_H
+#pragma once
+
+#include "Platform.h"
+
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * The operations that a plan can hold.
+ */
+enum PlanOperation
+{
+	/** Create a directory at Dest, copying the attributes of the directory at Src. */
+	PlanCreateDirectory,
+	/** Create a link at Dest pointing to NewTarget, replacing any link already there. */
+	PlanCopy,
+	/** Create a link at Dest pointing to NewTarget and then delete the link at Src. */
+	PlanMove,
+	/** Change the target of the link at Src from OldTarget to NewTarget. */
+	PlanFix,
+	/** Delete the link at Src. */
+	PlanRemove
+};
+
+/**
+ * A single operation of a plan.
+ */
+struct PlanAction
+{
+	typedef std::basic_string<TCHAR> String;
+
+	PlanOperation Operation;
+	/** The reparse tag of the link, or zero for a directory. */
+	DWORD Tag;
+	/** The full path of the existing link or directory. */
+	String Src;
+	/** The full path of the link or directory to create, or empty. */
+	String Dest;
+	/** The target of the link when the plan was made, or empty. */
+	String OldTarget;
+	/** The target the link is given, or empty. */
+	String NewTarget;
+};
+
+/**
+ * A list of the operations that cplink, mvlink, fixlink or rmlink would perform, recorded by a dry run so that they can
+ * be applied later without walking the tree again.
+ *
+ * A plan is a UTF-8 JSON Lines file holding one flat object per operation, for example:
+ *
+ *		{"op":"copy","type":"symlink","src":"C:\\a\\x","dest":"D:\\a\\x","old":"C:\\t","new":"D:\\t"}
+ *
+ * The "op" member is one of "mkdir", "copy", "move", "fix" or "remove" and "type" is either "junction" or "symlink".
+ * Members that don't apply to an operation are left out. A directory is always recorded before anything beneath it.
+ *
+ * Operations may be added from several threads at once.
+ */
+class ActionPlan
+{
+public:
+	ActionPlan();
+	~ActionPlan();
+
+	/**
+	 * Creates a new plan file, replacing any existing one, and opens it for adding operations.
+	 *
+	 * @param PlanPath The path of the plan file to create.
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Create(LPCTSTR PlanPath);
+
+	/**
+	 * Appends an operation to the plan.
+	 *
+	 * @param Operation The operation to record.
+	 * @param Tag The reparse tag of the link, or zero for a directory.
+	 * @param Src The full path of the existing link or directory.
+	 * @param Dest The full path of the link or directory to create, or NULL.
+	 * @param OldTarget The current target of the link, or NULL.
+	 * @param NewTarget The target the link is given, or NULL.
+	 */
+	void Add(PlanOperation Operation, DWORD Tag, LPCTSTR Src, LPCTSTR Dest, LPCTSTR OldTarget, LPCTSTR NewTarget);
+
+	/**
+	 * Flushes and closes a plan opened with Create.
+	 *
+	 * @return Returns zero if every operation was written, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Close();
+
+	/**
+	 * Reads every operation of an existing plan file.
+	 *
+	 * @param PlanPath The path of the plan file to read.
+	 * @param Actions The operations of the plan, in the order they were recorded. [OUT]
+	 * @return Returns zero if the operation was successful, ERROR_BAD_FORMAT if a line of the file is not a valid
+	 *		operation, otherwise a non-zero value if an error occurred.
+	 */
+	static DWORD Load(LPCTSTR PlanPath, std::vector<PlanAction>& Actions);
+
+private:
+	FILE* File;
+	std::mutex Lock;
+	/** The first error that occurred while writing, if any. */
+	DWORD WriteError;
+
+	// Not copyable
+	ActionPlan(const ActionPlan&);
+	ActionPlan& operator=(const ActionPlan&);
+};
+
+#endif //ACTIONPLAN_H
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef APPLYPLAN_H
+#define APPLYPLAN_H
+#pragma once
+
+#include "ActionPlan.h"
+#include "Platform.h"
+
+#include <atomic>
+
+struct applyplanOptions
+{
+	/** Set to true to enable verbose logging. */
+	bool bVerbose;
+	/** The number of worker threads used to apply the plan. Zero uses one per processor. */
+	int NumThreads;
+
+	applyplanOptions()
+		: bVerbose(false)
+		, NumThreads(0)
+	{
+	}
+};
+
+struct applyplanStats
+{
+	/** The number of operations that failed. */
+	std::atomic<size_t> NumFailed;
+	/** The number of operations on links that were applied. */
+	std::atomic<size_t> NumApplied;
+	/** The number of operations that were skipped because the link changed since the plan was made. */
+	std::atomic<size_t> NumSkipped;
+
+	applyplanStats()
+		: NumFailed(0)
+		, NumApplied(0)
+		, NumSkipped(0)
+	{
+	}
+};
+
+/**
+ * Performs the operations of a plan recorded by a dry run of cplink, mvlink, fixlink or rmlink, without walking the
+ * tree again.
+ *
+ * Directories are created first, one level of the tree at a time. The operations on links are then applied by
+ * parallel workers. The sources of moved links are deleted last, once every destination link has been created. A fix
+ * is skipped if the link no longer has the target it had when the plan was made.
+ *
+ * @param PlanPath The path of the plan file to apply.
+ * @param Operation The link operation of the tool applying the plan. A plan holding any other operation on links is
+ *		rejected.
+ * @param Options The options controlling how the plan is applied.
+ * @param Stats The statistics to update while applying the plan. [OUT]
+ * @return Returns zero if the plan could be read, otherwise a non-zero value on failure.
+ */
+DWORD applyplan(LPCTSTR PlanPath, PlanOperation Operation, const applyplanOptions& Options, applyplanStats& Stats);
+
+#endif //APPLYPLAN_H
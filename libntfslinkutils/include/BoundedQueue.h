@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+
+/**
+ * A fixed capacity first in, first out queue that any number of threads may push to and pop from at once without
+ * taking a lock.
+ *
+ * Each slot carries a sequence number that tells producers and consumers whose turn it is to use the slot, so the
+ * only shared writes are a single compare and swap on the head or tail plus the store that hands the slot over. This
+ * is the bounded queue described by Dmitry Vyukov.
+ *
+ * Push and Pop wait while the queue is full or empty, spinning and yielding briefly and then blocking on a condition
+ * variable, so that an idle stage of a pipeline does not use a processor however long it waits. The lock behind the
+ * condition variables is only taken by a thread about to block and by the thread that wakes it. Once every producer
+ * is finished the queue is closed, after which Pop drains the remaining values and then returns false.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+	/**
+	 * @param Capacity The maximum number of values the queue holds. Rounded up to a power of two.
+	 */
+	explicit BoundedQueue(size_t Capacity)
+		: Head(0)
+		, Tail(0)
+		, bClosed(false)
+		, NumWaitingPush(0)
+		, NumWaitingPop(0)
+	{
+		size_t capacity = 2;
+		while (capacity < Capacity)
+		{
+			capacity *= 2;
+		}
+
+		Mask = capacity - 1;
+		Slots = new Slot[capacity];
+		for (size_t i = 0; i < capacity; i++)
+		{
+			Slots[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~BoundedQueue()
+	{
+		delete[] Slots;
+	}
+
+	/**
+	 * Adds a value to the back of the queue if there is room.
+	 *
+	 * @return Returns true if the value was added, otherwise false if the queue is full.
+	 */
+	bool TryPush(const T& Value)
+	{
+		size_t pos = Tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Slot& slot = Slots[pos & Mask];
+			intptr_t difference = (intptr_t)slot.Sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+			if (difference == 0)
+			{
+				// The slot is free. Claim it by moving the tail past it.
+				if (Tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					slot.Value = Value;
+					slot.Sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				// The slot still holds the value from the previous lap
+				return false;
+			}
+			else
+			{
+				pos = Tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Removes the value at the front of the queue if there is one.
+	 *
+	 * @param Value The removed value. [OUT]
+	 * @return Returns true if a value was removed, otherwise false if the queue is empty.
+	 */
+	bool TryPop(T& Value)
+	{
+		size_t pos = Head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Slot& slot = Slots[pos & Mask];
+			intptr_t difference = (intptr_t)slot.Sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1);
+			if (difference == 0)
+			{
+				// The slot is full. Claim it by moving the head past it.
+				if (Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					Value = slot.Value;
+					slot.Sequence.store(pos + Mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0)
+			{
+				// The producer has not filled the slot yet
+				return false;
+			}
+			else
+			{
+				pos = Head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/**
+	 * Adds a value to the back of the queue, waiting for room if the queue is full.
+	 */
+	void Push(const T& Value)
+	{
+		for (int attempt = 0; !TryPush(Value); attempt++)
+		{
+			if (attempt < SpinAttempts)
+			{
+				Backoff(attempt);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(WaitLock);
+			NumWaitingPush.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while (IsFull())
+			{
+				NotFull.wait(lock);
+			}
+			NumWaitingPush.fetch_sub(1);
+		}
+
+		Wake(NumWaitingPop, NotEmpty);
+	}
+
+	/**
+	 * Removes the value at the front of the queue, waiting for one to arrive if the queue is empty.
+	 *
+	 * @param Value The removed value. [OUT]
+	 * @return Returns true if a value was removed, otherwise false if the queue is closed and empty.
+	 */
+	bool Pop(T& Value)
+	{
+		for (int attempt = 0; !TryPop(Value); attempt++)
+		{
+			// Values pushed before the queue was closed are visible once the close is, so one more try drains them
+			if (bClosed.load(std::memory_order_acquire))
+			{
+				if (!TryPop(Value))
+				{
+					return false;
+				}
+				break;
+			}
+
+			if (attempt < SpinAttempts)
+			{
+				Backoff(attempt);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(WaitLock);
+			NumWaitingPop.fetch_add(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			while (IsEmpty() && !bClosed.load(std::memory_order_acquire))
+			{
+				NotEmpty.wait(lock);
+			}
+			NumWaitingPop.fetch_sub(1);
+		}
+
+		Wake(NumWaitingPush, NotFull);
+		return true;
+	}
+
+	/**
+	 * Marks the queue as finished. Must only be called once nothing else will be pushed.
+	 */
+	void Close()
+	{
+		std::lock_guard<std::mutex> lock(WaitLock);
+		bClosed.store(true, std::memory_order_release);
+		NotEmpty.notify_all();
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<size_t> Sequence;
+		T Value;
+	};
+
+	/** The number of times Push and Pop retry before blocking. */
+	enum { SpinAttempts = 64 };
+
+	/**
+	 * Backs off briefly while waiting on another thread. Spins, then yields.
+	 */
+	static void Backoff(int Attempt)
+	{
+		if (Attempt >= 16)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	/** Returns true if the slot at the head holds no value yet, the same test that TryPop makes. */
+	bool IsEmpty() const
+	{
+		size_t pos = Head.load(std::memory_order_relaxed);
+		return (intptr_t)Slots[pos & Mask].Sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0;
+	}
+
+	/** Returns true if the slot at the tail still holds the value from the previous lap, the same test that TryPush
+	 *  makes. */
+	bool IsFull() const
+	{
+		size_t pos = Tail.load(std::memory_order_relaxed);
+		return (intptr_t)Slots[pos & Mask].Sequence.load(std::memory_order_acquire) - (intptr_t)pos < 0;
+	}
+
+	/**
+	 * Wakes a thread blocked on the given condition, if any. The fence pairs with the one taken by a blocking thread
+	 * after it counts itself, so that either it sees the change just made or it is seen to be waiting.
+	 */
+	void Wake(std::atomic<int>& NumWaiting, std::condition_variable& Condition)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (NumWaiting.load(std::memory_order_relaxed) > 0)
+		{
+			std::lock_guard<std::mutex> lock(WaitLock);
+			Condition.notify_one();
+		}
+	}
+
+	Slot* Slots;
+	size_t Mask;
+	// Kept on separate cache lines so that producers and consumers do not contend
+	char Pad0[64];
+	std::atomic<size_t> Head;
+	char Pad1[64];
+	std::atomic<size_t> Tail;
+	char Pad2[64];
+	std::atomic<bool> bClosed;
+
+	/** Guards blocking on NotFull and NotEmpty. */
+	std::mutex WaitLock;
+	std::condition_variable NotFull;
+	std::condition_variable NotEmpty;
+	/** The number of threads blocked in Push and in Pop. */
+	std::atomic<int> NumWaitingPush;
+	std::atomic<int> NumWaitingPop;
+
+	// Not copyable
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+};
+
+#endif //BOUNDEDQUEUE_H
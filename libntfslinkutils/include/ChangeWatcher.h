@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef CHANGEWATCHER_H
+#define CHANGEWATCHER_H
+#pragma once
+
+#include "Platform.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Reports the entries of a tree that are created or changed, so that a tree can be kept in sync by visiting only
+ * what changed instead of walking it again.
+ *
+ * The TreeWalker asks the watcher to watch each directory just before it enumerates it, so that nothing changed during
+ * the walk is missed and directories the walk prunes are never watched. Backends that watch a whole subtree at once
+ * may ignore directories beneath one they already watch.
+ *
+ * Changes are reported in batches. Once a change arrives the watcher keeps gathering until none has arrived for
+ * SettleTime milliseconds, or MaxBatchTime milliseconds have passed, so that a burst such as a tree being unpacked is
+ * handled as one batch. If the platform drops changes because too many arrived at once, every watched directory is
+ * reported so that the caller walks it again.
+ *
+ * Created with CreateChangeWatcher. WatchDirectory may be called from several threads at once, and Stop from any
+ * thread.
+ */
+class ChangeWatcher
+{
+public:
+	virtual ~ChangeWatcher() {}
+
+	/**
+	 * Starts watching a directory for entries being created, changed or moved into it. Watching a directory again
+	 * has no effect.
+	 *
+	 * @param Path The full path of the directory.
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	virtual DWORD WatchDirectory(LPCTSTR Path) = 0;
+
+	/**
+	 * Waits for the next batch of changes.
+	 *
+	 * @param Paths The full paths of the entries that were created or changed, in no particular order and possibly
+	 *		including entries that have since been deleted again. [OUT]
+	 * @return Returns zero if the operation was successful, ERROR_OPERATION_ABORTED once Stop has been called,
+	 *		otherwise a non-zero value if an error occurred.
+	 */
+	virtual DWORD WaitForChanges(std::vector<std::basic_string<TCHAR> >& Paths) = 0;
+
+	/**
+	 * Makes the current and every later call to WaitForChanges return ERROR_OPERATION_ABORTED.
+	 */
+	virtual void Stop() = 0;
+
+	/** How long a batch waits for more changes after the last one, in milliseconds. */
+	static const int SettleTime = 100;
+	/** The longest a batch waits for more changes after the first one, in milliseconds. */
+	static const int MaxBatchTime = 1000;
+};
+
+#endif //CHANGEWATCHER_H
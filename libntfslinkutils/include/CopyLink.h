@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef COPYLINK_H
+#define COPYLINK_H
+#pragma once
+
+#include "ActionPlan.h"
+#include "ChangeWatcher.h"
+#include "PathFilter.h"
+#include "Platform.h"
+#include "RewriteRules.h"
+#include "RootMap.h"
+#include "TreeWalker.h"
+
+#include <atomic>
+#include <memory.h>
+
+struct cplinkOptions
+{
+	/** Set to true to enable verbose logging. */
+	bool bVerbose;
+	/** The maximum file tree depth to traverse before stopping. */
+	int MaxDepth;
+	/** The number of worker threads used to traverse the tree. Zero uses one per processor. */
+	int NumThreads;
+	/** The order in which directories are traversed. */
+	WalkOrder Order;
+	/** The plan to record each operation to instead of performing it, or NULL. */
+	ActionPlan* Plan;
+	/** The counters to report the progress of the walk to, or NULL. */
+	WalkProgress* Progress;
+	/** The filter that decides which directories are walked and which links are processed, or NULL. */
+	const PathFilter* Filter;
+	/** The number of worker threads used to read and rewrite link targets. Zero uses one per processor. */
+	int NumReadThreads;
+	/** The number of worker threads used to create the links at the destination. Zero uses one per processor. */
+	int NumCreateThreads;
+	/** Set to true to create destination directories only on the path to a link that is copied, rather than one for
+	 *  every source directory walked. */
+	bool bLazyDirectories;
+	/** The rules to rewrite targets with. Takes the place of OldTargetBase and NewTargetBase when set. */
+	const RewriteRules* Rules;
+	/** The old roots to rebase targets from and the new roots to rebase them to. Takes the place of OldTargetBase and NewTargetBase when set. */
+	const RootMap* Roots;
+	/** The watcher to keep copying created and changed links with once the initial walk is done, or NULL to stop after
+	 *  the walk. Not used together with a plan. */
+	ChangeWatcher* Watcher;
+	/** The root to rebase targets to. */
+	TCHAR NewTargetBase[MAX_PATH];
+	/** The root to rebase targets from. Only targets beneath it are rebased. */
+	TCHAR OldTargetBase[MAX_PATH];
+
+	cplinkOptions()
+		: bVerbose(false)
+		, MaxDepth(-1)
+		, NumThreads(0)
+		, Order(WalkDepthFirst)
+		, Plan(NULL)
+		, Progress(NULL)
+		, Filter(NULL)
+		, NumReadThreads(0)
+		, NumCreateThreads(0)
+		, bLazyDirectories(false)
+		, Rules(NULL)
+		, Roots(NULL)
+		, Watcher(NULL)
+	{
+		memset(NewTargetBase, 0, sizeof(NewTargetBase));
+		memset(OldTargetBase, 0, sizeof(OldTargetBase));
+	}
+};
+
+struct cplinkStats
+{
+	/** The number of file objects that failed to be moved. */
+	std::atomic<size_t> NumFailed;
+	/** The number of file objects successfully copied. */
+	std::atomic<size_t> NumCopied;
+	/** The number of file objects that were skipped. */
+	std::atomic<size_t> NumSkipped;
+
+	cplinkStats()
+		: NumFailed(0)
+		, NumCopied(0)
+		, NumSkipped(0)
+	{
+	}
+};
+
+/**
+ * Copies all reparse points in the specified source path to a given destination and rebases the target of each based on
+ * the options set (when applicable).
+ *
+ * The copy runs as a pipeline of three stages connected by bounded queues: the tree walker enumerates the source, a
+ * second set of workers reads and rewrites the target of each link found, and a third set creates the links at the
+ * destination. Each stage has its own workers, so the latency of metadata calls on remote volumes overlaps rather than
+ * adding up link by link.
+ *
+ * By default every source directory walked is mirrored at the destination, whether or not a link is copied beneath it.
+ * With lazy directories the creators instead make the missing directories above each link just before creating it.
+ * The directories known to exist are cached, so each one is checked and created at most once however many links it
+ * holds.
+ *
+ * With a watcher in the options, links and directories that are created or changed in the source afterwards keep
+ * being copied until the watcher is stopped. Deletions are not carried over to the destination.
+ *
+ * @param Src The path of the source file to copy.
+ * @param Dest The path of the destination to copy Src to.
+ * @param Options The options controlling the copy.
+ * @param Stats The statistics to update while copying. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value on failure.
+ */
+DWORD cplink(LPCTSTR Src, LPCTSTR Dest, const cplinkOptions& Options, cplinkStats& Stats);
+
+#endif //COPYLINK_H
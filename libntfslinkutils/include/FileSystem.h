@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FILESYSTEM_H
+#define FILESYSTEM_H
+#pragma once
+
+#include "PathBuffer.h"
+#include "Platform.h"
+
+class ChangeWatcher;
+
+/**
+ * Describes a single entry of a directory as reported by the directory enumeration itself.
+ */
+struct DirectoryEntry
+{
+	/** The name of the entry, relative to the directory being enumerated. */
+	LPCTSTR Name;
+	/** The file attributes of the entry. */
+	DWORD Attributes;
+	/** The reparse tag of the entry if it is a reparse point, otherwise zero. */
+	DWORD ReparseTag;
+};
+
+/** The value of DirectoryHandle::Native for a directory that isn't held open. */
+#define INVALID_DIRECTORY_HANDLE ((intptr_t)-1)
+
+/**
+ * A directory that is held open while its entries are being enumerated. Entries can be read, retargeted and deleted
+ * by name relative to the open directory, so that the path of the directory isn't resolved again for each of them.
+ */
+struct DirectoryHandle
+{
+	/** The full path of the directory. */
+	LPCTSTR Path;
+	/** The open directory, a file descriptor on POSIX, a HANDLE on Windows and zero for MemoryFileSystem, or
+	 *  INVALID_DIRECTORY_HANDLE if the backend enumerated the directory without opening it. */
+	intptr_t Native;
+
+	/** Returns true if entries can be named relative to the directory. */
+	bool IsOpen() const { return Native != INVALID_DIRECTORY_HANDLE; }
+};
+
+/**
+ * Callback invoked by EnumerateDirectory with each batch of entries found, other than '.' and '..'. The entries, their
+ * names and the directory handle are only valid for the duration of the call.
+ *
+ * @param Context The context pointer given to EnumerateDirectory.
+ * @param Directory The directory being enumerated.
+ * @param Entries The entries that were found.
+ * @param NumEntries The number of entries in the batch. Never zero.
+ */
+typedef void (*EnumerateCallback)(void* Context, const DirectoryHandle& Directory, const DirectoryEntry* Entries,
+	size_t NumEntries);
+
+/**
+ * Expands the specified path to a full path. Trailing path separators are removed unless the path is a root.
+ *
+ * On Windows the full path is given the \\?\ prefix, so that it and every path built from it may be up to
+ * MAX_LONG_PATH characters long instead of MAX_PATH.
+ *
+ * @param Path The path to expand.
+ * @param FullPath The full path. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetFullPath(LPCTSTR Path, PathBuffer& FullPath);
+
+/**
+ * Joins a directory path and the name of one of its entries.
+ *
+ * @param Dest The combined path. [OUT]
+ * @param Directory The path of the directory.
+ * @param Name The name of the entry to append to Directory.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if the result is too long.
+ */
+DWORD CombinePath(PathBuffer& Dest, LPCTSTR Directory, LPCTSTR Name);
+
+/**
+ * Retrieves the file attributes of the specified path. Reparse points are not followed.
+ *
+ * @param Path The path of the file object to query.
+ * @param Attributes The file attributes of Path. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetPathAttributes(LPCTSTR Path, DWORD& Attributes);
+
+/**
+ * Retrieves the time the specified file object was last written to. For a directory this changes whenever an entry is
+ * added to, removed from or renamed within it.
+ *
+ * @param Path The path of the file object to query.
+ * @param Time The last write time of Path, in an unspecified platform dependent unit. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time);
+
+/**
+ * Renames a file, replacing the destination if it already exists. Used for the index and journal files, so the rename
+ * always happens on the native file system whichever backend is active.
+ *
+ * @param OldPath The path of the file to rename.
+ * @param NewPath The new path of the file.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD ReplacePath(LPCTSTR OldPath, LPCTSTR NewPath);
+
+/**
+ * Creates a new directory with the attributes of an existing template directory. The security of the template is not
+ * copied, the new directory inherits the security of its parent instead.
+ *
+ * @param TemplatePath The path of the directory to copy attributes from.
+ * @param Path The path of the directory to create.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path);
+
+/**
+ * Invokes Callback with the entries contained in the specified directory, in batches of as many entries as the
+ * platform reads at once. The attributes and reparse tag of each entry are taken from the enumeration, so no
+ * additional query per entry is needed.
+ *
+ * The native backends keep the directory open for the whole enumeration and hand the open directory to Callback, so
+ * that links found in it can be read and changed with the *At functions of ReparsePoint.h.
+ *
+ * @param Path The path of the directory to enumerate.
+ * @param Callback The function to invoke for each batch of entries.
+ * @param Context An opaque pointer that is passed through to Callback.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD EnumerateDirectory(LPCTSTR Path, EnumerateCallback Callback, void* Context);
+
+/**
+ * Sets the size of the buffer that the native backend reads directory entries into. A larger buffer reads more
+ * entries per system call. Only Linux lets the size be chosen. Windows always uses a large fetch of its own size.
+ *
+ * @param Bytes The size of the buffer, in bytes.
+ */
+void SetEnumerateBufferSize(size_t Bytes);
+
+/**
+ * Creates a watcher that reports the entries created or changed on the active backend: ReadDirectoryChangesW on
+ * Windows, inotify on Linux and the backend itself for MemoryFileSystem.
+ *
+ * @return Returns the new watcher, which the caller deletes, or NULL if the backend can't watch for changes.
+ */
+ChangeWatcher* CreateChangeWatcher();
+
+#endif //FILESYSTEM_H
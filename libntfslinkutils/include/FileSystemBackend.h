@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FILESYSTEMBACKEND_H
+#define FILESYSTEMBACKEND_H
+#pragma once
+
+#include "ChangeWatcher.h"
+#include "FileSystem.h"
+#include "PathBuffer.h"
+#include "Platform.h"
+#include "ReparsePoint.h"
+
+/**
+ * The file system operations that the link engines are built on. The free functions of FileSystem.h and
+ * ReparsePoint.h time each operation and pass it on to the active backend, so the engines, the tree walker and the
+ * tools never call the operating system directly.
+ *
+ * Three backends are provided. NtfsFileSystem wraps libntfslinks and the Win32 API, PosixFileSystem works with
+ * symbolic links through the POSIX API, and MemoryFileSystem keeps a tree in memory with an optional delay added to
+ * each operation so that traversal and scheduling can be measured without depending on a disk.
+ *
+ * Every method returns zero if the operation was successful, otherwise the same error code that the Win32 API would
+ * have returned. Implementations must allow every method to be called from several threads at once.
+ *
+ * The *At methods are only given a directory that the same backend handed to an EnumerateCallback as open, and only
+ * while that callback is running.
+ */
+class FileSystemBackend
+{
+public:
+	virtual ~FileSystemBackend() {}
+
+	/**
+	 * Retrieves the file attributes of the specified path. Reparse points are not followed.
+	 */
+	virtual DWORD GetAttributes(LPCTSTR Path, DWORD& Attributes) = 0;
+
+	/**
+	 * Retrieves the time the specified file object was last written to. See GetLastWriteTime in FileSystem.h.
+	 */
+	virtual DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time) = 0;
+
+	/**
+	 * Invokes Callback with each batch of entries contained in the specified directory, other than '.' and '..'.
+	 */
+	virtual DWORD Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context) = 0;
+
+	/**
+	 * Retrieves the tag, target and print name of a reparse point. Returns ERROR_NOT_A_REPARSE_POINT if Path exists
+	 * but is not a reparse point.
+	 */
+	virtual DWORD ReadLink(LPCTSTR Path, libntfslinks::ReparsePointInfo& Info) = 0;
+
+	/**
+	 * Retrieves a reparse point named relative to a directory that is held open by Enumerate. See ReadLink.
+	 */
+	virtual DWORD ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, libntfslinks::ReparsePointInfo& Info) = 0;
+
+	/**
+	 * Creates a junction if Tag is IO_REPARSE_TAG_MOUNT_POINT, otherwise a symbolic link.
+	 */
+	virtual DWORD CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target) = 0;
+
+	/**
+	 * Replaces the target of an existing link without the link ever being missing.
+	 */
+	virtual DWORD SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target) = 0;
+
+	/**
+	 * Replaces the target of a link named relative to a directory that is held open by Enumerate. See SetLinkTarget.
+	 */
+	virtual DWORD SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target) = 0;
+
+	/**
+	 * Deletes a junction if Tag is IO_REPARSE_TAG_MOUNT_POINT, otherwise a symbolic link.
+	 */
+	virtual DWORD DeleteLink(DWORD Tag, LPCTSTR Path) = 0;
+
+	/**
+	 * Deletes a link named relative to a directory that is held open by Enumerate. See DeleteLink.
+	 */
+	virtual DWORD DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name) = 0;
+
+	/**
+	 * Renames a file or directory, replacing the destination if it is a file that already exists.
+	 */
+	virtual DWORD Rename(LPCTSTR OldPath, LPCTSTR NewPath) = 0;
+
+	/**
+	 * Creates a new directory with the attributes of an existing template directory.
+	 */
+	virtual DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path) = 0;
+
+	/**
+	 * Creates an empty plain file. Fails if the path already exists.
+	 */
+	virtual DWORD CreateEmptyFile(LPCTSTR Path) = 0;
+
+	/**
+	 * Deletes a plain file.
+	 */
+	virtual DWORD RemoveFile(LPCTSTR Path) = 0;
+
+	/**
+	 * Deletes an empty directory.
+	 */
+	virtual DWORD RemoveEmptyDirectory(LPCTSTR Path) = 0;
+
+	/**
+	 * Creates a watcher that reports changes made to this file system. See CreateChangeWatcher in FileSystem.h.
+	 */
+	virtual ChangeWatcher* CreateWatcher() = 0;
+};
+
+/**
+ * Makes the given backend the one that every file system operation goes through. Must be called before any other
+ * thread is started, and the backend must outlive its use.
+ *
+ * @param Backend The backend to use, or NULL to return to the native backend of the platform.
+ */
+void SetFileSystemBackend(FileSystemBackend* Backend);
+
+/**
+ * Returns the backend that file system operations currently go through.
+ */
+FileSystemBackend& GetFileSystemBackend();
+
+#endif //FILESYSTEMBACKEND_H
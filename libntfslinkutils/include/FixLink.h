@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef FIXLINK_H
+#define FIXLINK_H
+#pragma once
+
+#include "ActionPlan.h"
+#include "ChangeWatcher.h"
+#include "LinkSelector.h"
+#include "PathBuffer.h"
+#include "PathFilter.h"
+#include "Platform.h"
+#include "RewriteRules.h"
+#include "TreeWalker.h"
+
+#include <atomic>
+#include <memory.h>
+#include <vector>
+
+struct fixlinkOptions
+{
+	/** Set to true to enable verbose logging. */
+	bool bVerbose;
+	/** The maximum file tree depth to traverse before stopping. */
+	int MaxDepth;
+	/** The number of worker threads used to traverse the tree. Zero uses one per processor. */
+	int NumThreads;
+	/** The order in which directories are traversed. */
+	WalkOrder Order;
+	/** The plan to record each operation to instead of performing it, or NULL. */
+	ActionPlan* Plan;
+	/** The counters to report the progress of the walk to, or NULL. */
+	WalkProgress* Progress;
+	/** The filter that decides which directories are walked and which links are processed, or NULL. */
+	const PathFilter* Filter;
+	/** The selector that decides which links are processed by their target, or NULL. */
+	const LinkSelector* Selector;
+	/** The rules to rewrite targets with. Takes the place of OldTargetBase and NewTargetBase when set. */
+	const RewriteRules* Rules;
+	/** The watcher to keep fixing created and changed links with once the initial walk is done, or NULL to stop after
+	 *  the walk. Not used together with a plan or an index. */
+	ChangeWatcher* Watcher;
+	/** The path of the link index to reuse and update, or empty to walk the entire tree. */
+	PathBuffer IndexPath;
+	/** The path to rebase targets to. */
+	TCHAR NewTargetBase[MAX_PATH];
+	/** The path to rebase targets from. */
+	TCHAR OldTargetBase[MAX_PATH];
+
+	fixlinkOptions()
+		: bVerbose(false)
+		, MaxDepth(-1)
+		, NumThreads(0)
+		, Order(WalkDepthFirst)
+		, Plan(NULL)
+		, Progress(NULL)
+		, Filter(NULL)
+		, Selector(NULL)
+		, Rules(NULL)
+		, Watcher(NULL)
+	{
+		memset(NewTargetBase, 0, sizeof(NewTargetBase));
+		memset(OldTargetBase, 0, sizeof(OldTargetBase));
+	}
+};
+
+struct fixlinkStats
+{
+	/** The number of file objects that failed to be moved. */
+	std::atomic<size_t> NumFailed;
+	/** The number of file objects successfully modified. */
+	std::atomic<size_t> NumModified;
+	/** The number of file objects that were skipped. */
+	std::atomic<size_t> NumSkipped;
+
+	fixlinkStats()
+		: NumFailed(0)
+		, NumModified(0)
+		, NumSkipped(0)
+	{
+	}
+};
+
+/**
+ * Modifies the target path of all reparse points in the given path.
+ *
+ * @param Path The path of the reparse point or directory tree to traverse and modify.
+ * @param Options The options controlling the modification.
+ * @param Stats The statistics to update while modifying. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value on failure.
+ */
+DWORD fixlink(LPCTSTR Path, const fixlinkOptions& Options, fixlinkStats& Stats);
+
+/**
+ * Modifies the target path of all reparse points in each of the given paths. The paths are walked together by one pool
+ * of threads, and a path nested beneath another is only walked once. With a watcher in the options, links that are
+ * created or changed afterwards keep being modified until the watcher is stopped.
+ *
+ * @param Paths The paths of the reparse points or directory trees to traverse and modify.
+ * @param Options The options controlling the modification.
+ * @param Stats The statistics to update while modifying. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if any path could not be read.
+ *		The remaining paths are still modified.
+ */
+DWORD fixlink(const std::vector<LPCTSTR>& Paths, const fixlinkOptions& Options, fixlinkStats& Stats);
+
+#endif //FIXLINK_H
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef INOTIFYWATCHER_H
+#define INOTIFYWATCHER_H
+#pragma once
+
+#ifdef __linux__
+
+#include "ChangeWatcher.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Watches for changes with inotify. Each directory is watched on its own, since inotify does not watch subtrees, and
+ * the entries created in it or moved into it are reported.
+ *
+ * A directory that is deleted drops its watch automatically. One that is created or moved into a watched directory is
+ * reported as a change, and walking it again watches it in turn.
+ */
+class InotifyWatcher : public ChangeWatcher
+{
+public:
+	InotifyWatcher();
+	virtual ~InotifyWatcher();
+
+	/**
+	 * Creates the inotify instance. Must be called before anything else.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Open();
+
+	virtual DWORD WatchDirectory(LPCTSTR Path);
+	virtual DWORD WaitForChanges(std::vector<std::basic_string<TCHAR> >& Paths);
+	virtual void Stop();
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	void ReadEvents(std::vector<String>& Paths);
+
+	/** The inotify instance. */
+	int Fd;
+	/** Written to by Stop to wake WaitForChanges. Writing to a pipe is safe from a signal handler. */
+	int StopPipe[2];
+
+	/** Guards Directories. */
+	std::mutex Lock;
+	/** The path of each watched directory, keyed on its watch descriptor. */
+	std::map<int, String> Directories;
+
+	// Not copyable
+	InotifyWatcher(const InotifyWatcher&);
+	InotifyWatcher& operator=(const InotifyWatcher&);
+};
+
+#endif //__linux__
+
+#endif //INOTIFYWATCHER_H
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef JSON_H
+#define JSON_H
+#pragma once
+
+#include "Platform.h"
+
+#include <string>
+
+/**
+ * Helpers for the line oriented JSON records written by plans and by the JSON output of the tools. Records are flat
+ * objects of string and number members, built by appending members to an empty string and then closing it with "}".
+ */
+
+/**
+ * Appends a JSON string holding the given value, escaping quotes, backslashes and control characters.
+ */
+void AppendJsonString(std::basic_string<TCHAR>& Record, LPCTSTR Value);
+
+/**
+ * Appends a "name":"value" member to a record, opening the record if it is empty. Nothing is appended if the value is
+ * NULL or empty.
+ */
+void AppendJsonMember(std::basic_string<TCHAR>& Record, LPCTSTR Name, LPCTSTR Value);
+
+/**
+ * Appends a "name":value member holding a number to a record, opening the record if it is empty.
+ */
+void AppendJsonMember(std::basic_string<TCHAR>& Record, LPCTSTR Name, ULONGLONG Value);
+
+/**
+ * Skips any whitespace at the start of the text.
+ *
+ * @param Text The text to read. Advanced past the whitespace. [IN/OUT]
+ */
+void SkipJsonSpace(LPCTSTR& Text);
+
+/**
+ * Reads a JSON string.
+ *
+ * @param Text The text to read, starting at the opening quote. Advanced past the closing quote. [IN/OUT]
+ * @param Value The unescaped string. [OUT]
+ * @return Returns false if the text is not a valid string.
+ */
+bool ReadJsonString(LPCTSTR& Text, std::basic_string<TCHAR>& Value);
+
+#endif //JSON_H
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LINKCOMMAND_H
+#define LINKCOMMAND_H
+#pragma once
+
+#include "Platform.h"
+
+/**
+ * The command line tools built on the library. Each is a thin front end that runs its command through
+ * RunLinkCommand, and ntfslink runs any of them from a single binary.
+ */
+enum LinkCommand
+{
+	/** cplink, which copies links from one tree to another. */
+	CommandCopy,
+	/** fixlink, which rewrites the targets of links in place. */
+	CommandFix,
+	/** mvlink, which moves links from one tree to another. */
+	CommandMove,
+	/** rmlink, which deletes links. */
+	CommandRemove,
+	NumLinkCommands
+};
+
+/**
+ * Looks up a command by the name of its tool, such as "cplink", or by its short name, such as "cp". Any leading
+ * directory and trailing ".exe" are ignored, so that the argv[0] of a copy or link of ntfslink may be passed as is.
+ *
+ * @param Name The name to look up, compared without regard to case.
+ * @param Command The command with the given name. [OUT]
+ * @return Returns true if a command was found, otherwise false.
+ */
+bool FindLinkCommand(LPCTSTR Name, LinkCommand& Command);
+
+/**
+ * Prints the short and full name of each command along with what it does.
+ */
+void PrintLinkCommands();
+
+/**
+ * Prints the version and copyright information shared by all of the tools.
+ */
+void PrintLinkVersion();
+
+/**
+ * Runs a command as its tool would: parses the options and paths, performs the operations or applies a plan and
+ * prints the execution statistics. Every tool accepts the same options in the same way, apart from those that only
+ * apply to some of them, such as /PIPE.
+ *
+ * @param Command The command to run.
+ * @param argc The number of arguments, including the name of the command.
+ * @param argv The name of the command followed by its arguments.
+ * @return Returns zero if every operation succeeded, otherwise a non-zero value to exit the process with.
+ */
+int RunLinkCommand(LinkCommand Command, int argc, TCHAR* argv[]);
+
+#endif //LINKCOMMAND_H
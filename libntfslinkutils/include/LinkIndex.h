@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LINKINDEX_H
+#define LINKINDEX_H
+#pragma once
+
+#include "FileSystem.h"
+#include "Platform.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * A persistent record of the links and subdirectories found in each directory of previously walked trees, along with
+ * the last write time of every directory at the moment it was enumerated.
+ *
+ * A directory whose last write time still matches the index has had no entries added, removed or renamed since it
+ * was recorded, so its links and subdirectories can be replayed from the index instead of enumerating it again. Only
+ * directories that changed are read from disk. Plain files are never recorded, keeping the index small.
+ *
+ * The index file is memory mapped when loaded and all lookups read directly from the mapping. A new index is built
+ * from the directories visited by the current walk and written out with Save, carrying over the records of any
+ * directories outside of the walked roots.
+ *
+ * File layout (native byte order, strings are null terminated TCHAR arrays in a shared pool):
+ *
+ *		IndexHeader
+ *		IndexDirectory[NumDirectories], sorted by path
+ *		IndexEntry[NumEntries], grouped by directory
+ *		TCHAR Strings[NumStrings]
+ */
+class LinkIndex
+{
+public:
+	typedef std::basic_string<TCHAR> String;
+
+	/** A link or subdirectory recorded for a directory. */
+	struct Entry
+	{
+		/** The name of the entry. */
+		String Name;
+		/** The file attributes of the entry. */
+		DWORD Attributes;
+		/** The reparse tag of the entry if it is a reparse point, otherwise zero. */
+		DWORD ReparseTag;
+		/** The last known target of the entry if it is a link, otherwise empty. */
+		String Target;
+	};
+
+	LinkIndex();
+	~LinkIndex();
+
+	/**
+	 * Maps an existing index file into memory.
+	 *
+	 * @param IndexPath The path of the index file to load.
+	 * @return Returns zero if the operation was successful, ERROR_FILE_NOT_FOUND if there is no index file yet,
+	 *		ERROR_BAD_FORMAT if the file is not a valid index, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Load(LPCTSTR IndexPath);
+
+	/**
+	 * Writes the index built by the current walk, plus the loaded records of directories outside of the walked roots,
+	 * to a new index file. The file is written beside IndexPath and then renamed over it.
+	 *
+	 * @param IndexPath The path of the index file to write.
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Save(LPCTSTR IndexPath);
+
+	/**
+	 * Marks the start of a walk at the given root. Loaded records beneath the root are replaced by whatever the walk
+	 * records when the index is saved.
+	 *
+	 * @param Root The full path of the root.
+	 */
+	void AddRoot(LPCTSTR Root);
+
+	/**
+	 * Replays the recorded entries of a directory if it has not changed since it was recorded. The replayed records
+	 * are carried over into the new index.
+	 *
+	 * @param Path The full path of the directory.
+	 * @param LastWriteTime The current last write time of the directory.
+	 * @param Callback The function to invoke with the recorded entries.
+	 * @param Context An opaque pointer that is passed through to Callback.
+	 * @return Returns true if the directory was replayed, otherwise false if it must be enumerated.
+	 */
+	bool ReplayDirectory(LPCTSTR Path, ULONGLONG LastWriteTime, EnumerateCallback Callback, void* Context);
+
+	/**
+	 * Records the links and subdirectories found by enumerating a directory.
+	 *
+	 * @param Path The full path of the directory.
+	 * @param LastWriteTime The last write time of the directory, taken before it was enumerated.
+	 * @param Entries The links and subdirectories of the directory.
+	 */
+	void AddDirectory(LPCTSTR Path, ULONGLONG LastWriteTime, const std::vector<Entry>& Entries);
+
+	/**
+	 * Records the current target of a link so that it is stored in the index.
+	 *
+	 * @param Path The full path of the link.
+	 * @param Target The target of the link.
+	 */
+	void SetLinkTarget(LPCTSTR Path, LPCTSTR Target);
+
+private:
+	struct IndexHeader;
+	struct IndexDirectory;
+	struct IndexEntry;
+
+	/** A directory recorded by the current walk. */
+	struct Directory
+	{
+		String Path;
+		ULONGLONG LastWriteTime;
+		std::vector<Entry> Entries;
+	};
+
+	const IndexDirectory* FindDirectory(LPCTSTR Path) const;
+	void ReadEntry(const IndexEntry& Record, Entry& Result) const;
+	bool IsUnderRoot(LPCTSTR Path) const;
+	void Unmap();
+
+	/** The loaded index, or NULL if none is loaded. */
+	const IndexHeader* Header;
+	const IndexDirectory* Directories;
+	const IndexEntry* Entries;
+	const TCHAR* Strings;
+	size_t MappedSize;
+#ifdef _WIN32
+	HANDLE hFile;
+	HANDLE hMapping;
+#else
+	int hFile;
+#endif
+
+	/** Guards the records of the current walk. */
+	std::mutex Lock;
+	std::vector<String> Roots;
+	std::vector<Directory*> NewDirectories;
+	std::map<String, String> LinkTargets;
+
+	// Not copyable
+	LinkIndex(const LinkIndex&);
+	LinkIndex& operator=(const LinkIndex&);
+};
+
+#endif //LINKINDEX_H
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LINKSELECTOR_H
+#define LINKSELECTOR_H
+#pragma once
+
+#include "Platform.h"
+#include "RootMap.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+/**
+ * Selects links by their target: those whose target lies beneath one of a set of roots, those whose target no longer
+ * exists, or those that satisfy both. The target is the one already read from the link, so selecting a link costs no
+ * further query of the link itself.
+ *
+ * Roots match whole path components, ignoring case on Windows, the same as the roots of /R.
+ *
+ * Whether a target exists is answered from the entries of the directory that contains it. Each such directory is
+ * enumerated once and its entries are kept, so the thousands of links that typically point into the same directory
+ * cost a single enumeration between them rather than one query each. A directory that can't be enumerated for any
+ * reason other than not existing falls back to querying each target, so that a link is never taken for dangling
+ * because its target couldn't be read. The entries are kept for the life of the selector, so a target deleted after
+ * its directory was enumerated is still taken to exist.
+ *
+ * Once configured, the selector may be used from several threads at once.
+ */
+class LinkSelector
+{
+public:
+	LinkSelector();
+
+	/**
+	 * Selects only links whose target is beneath the given root. May be called more than once, in which case a
+	 * target beneath any of the roots is selected.
+	 */
+	void AddTargetRoot(LPCTSTR Root);
+
+	/**
+	 * Selects only links whose target does not exist.
+	 */
+	void SelectDangling() { bDangling = true; }
+
+	/** Returns true if only links whose target does not exist are selected. */
+	bool IsDanglingSelected() const { return bDangling; }
+
+	/** Returns true if every link is selected. */
+	bool IsEmpty() const { return Roots.IsEmpty() && !bDangling; }
+
+	/**
+	 * Determines if a link is selected.
+	 *
+	 * @param Path The full path of the link. Relative targets are resolved against its directory.
+	 * @param Target The target of the link.
+	 */
+	bool IsSelected(LPCTSTR Path, LPCTSTR Target) const;
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	/** The entries of a directory containing link targets. */
+	struct DirectoryNames
+	{
+		/** Set once the directory has been enumerated. Until then other threads wait on Loaded. */
+		bool bLoaded;
+		/** Set if the directory was enumerated. Otherwise Names is empty and bMissing tells why. */
+		bool bReadable;
+		/** Set if the directory does not exist, in which case neither does anything in it. */
+		bool bMissing;
+		/** The names of the entries, folded on Windows. */
+		std::set<String> Names;
+	};
+
+	bool TargetExists(LPCTSTR Target) const;
+
+	RootMap Roots;
+	bool bDangling;
+
+	mutable std::mutex Lock;
+	mutable std::condition_variable Loaded;
+	/** The directories enumerated so far, keyed on their folded path. */
+	mutable std::map<String, DirectoryNames> Directories;
+
+	// Not copyable
+	LinkSelector(const LinkSelector&);
+	LinkSelector& operator=(const LinkSelector&);
+};
+
+#endif //LINKSELECTOR_H
@@ -0,0 +1,112 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOG_H
+#define LOG_H
+#pragma once
+
+#include "Platform.h"
+
+/**
+ * A snapshot of how far along a tool is, written as a progress record while JSON output is enabled.
+ */
+struct LogProgress
+{
+	/** The number of directory entries enumerated so far. */
+	ULONGLONG NumScanned;
+	/** The number of links processed so far, whether they succeeded, failed or were skipped. */
+	ULONGLONG NumProcessed;
+	/** The number of operations that failed so far. */
+	ULONGLONG NumFailed;
+	/** The level of the directory most recently enumerated. */
+	int Depth;
+};
+
+/**
+ * Fills in a snapshot of the progress. Called from the progress thread while the tool is running.
+ */
+typedef void (*ProgressCallback)(LogProgress& Progress);
+
+/**
+ * Prints a friendly message based on the given error code.
+ */
+void PrintErrorMessage(DWORD ErrorCode, LPCTSTR Path);
+
+/**
+ * Prints a formatted message, or writes it as a message record when JSON output is enabled.
+ *
+ * Messages are added to a buffer owned by the calling thread and written to the standard output by a background
+ * thread, so logging is cheap and safe from any number of threads. The messages of each thread stay in order, but
+ * those of different threads may be written in a different order than they were logged.
+ */
+void LogMessage(LPCTSTR Format, ...);
+
+/**
+ * Prints the execution statistics of a tool, or writes them as a summary record when JSON output is enabled.
+ * Everything logged beforehand is written first.
+ *
+ * @param Label The name of the count of successful operations, such as "Copied".
+ * @param NumSucceeded The number of operations that succeeded.
+ * @param NumSkipped The number of operations that were skipped.
+ * @param NumFailed The number of operations that failed.
+ */
+void LogSummary(LPCTSTR Label, size_t NumSucceeded, size_t NumSkipped, size_t NumFailed);
+
+/**
+ * Prints the latency of each operation recorded while metrics were enabled, or writes one stats record per operation
+ * when JSON output is enabled. Operations that never ran are left out. Everything logged beforehand is written first.
+ */
+void LogStats();
+
+/**
+ * Switches all output to JSON records, one per line, until CloseLog is called. A progress record is written every
+ * IntervalMs milliseconds from a background thread.
+ *
+ * Records are objects with a "type" member of "progress", "message", "error", "summary" or "stats":
+ *
+ *	{"type":"progress","elapsed_ms":n,"scanned":n,"processed":n,"rate":n,"failed":n,"depth":n}
+ *	{"type":"message","text":"..."}
+ *	{"type":"error","code":n,"message":"...","path":"..."}
+ *	{"type":"summary","<label>":n,"skipped":n,"failed":n,"elapsed_ms":n}
+ *	{"type":"stats","operation":"...","count":n,"total_ns":n,"mean_ns":n,"p50_ns":n,"p90_ns":n,"p99_ns":n,"max_ns":n}
+ *
+ * The rate is the number of links processed per second since the previous progress record.
+ *
+ * @param Callback The function that reports the progress of the tool.
+ * @param IntervalMs The number of milliseconds between progress records.
+ */
+void StartJsonOutput(ProgressCallback Callback, int IntervalMs);
+
+/**
+ * Writes out everything that has been logged and stops the background threads. Must be called before the tool exits,
+ * once no other thread is logging.
+ */
+void CloseLog();
+
+#endif //LOG_H
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORYCHANGEWATCHER_H
+#define MEMORYCHANGEWATCHER_H
+#pragma once
+
+#include "ChangeWatcher.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+class MemoryFileSystem;
+
+/**
+ * Watches a MemoryFileSystem for changes, standing in for the watchers of real file systems so that watch mode can be
+ * exercised without a disk. Like inotify, only entries created in or moved into a watched directory are reported.
+ *
+ * Changes are handed out as soon as there are any rather than after they settle, so that a caller driving the tree
+ * sees each change it makes without waiting.
+ */
+class MemoryChangeWatcher : public ChangeWatcher
+{
+public:
+	/**
+	 * @param FileSystem The file system to watch. Must outlive the watcher.
+	 */
+	explicit MemoryChangeWatcher(MemoryFileSystem& FileSystem);
+	virtual ~MemoryChangeWatcher();
+
+	virtual DWORD WatchDirectory(LPCTSTR Path);
+	virtual DWORD WaitForChanges(std::vector<std::basic_string<TCHAR> >& Paths);
+	virtual void Stop();
+
+	/**
+	 * Called by the file system for every entry created or changed.
+	 *
+	 * @param Path The full path of the entry.
+	 */
+	void AddChange(const std::basic_string<TCHAR>& Path);
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	MemoryFileSystem& FileSystem;
+
+	/** Guards the members below. */
+	std::mutex Lock;
+	std::condition_variable Changed;
+	/** The watched directories. */
+	std::set<String> Directories;
+	/** The changes not yet handed out. */
+	std::vector<String> Pending;
+	bool bStopped;
+
+	// Not copyable
+	MemoryChangeWatcher(const MemoryChangeWatcher&);
+	MemoryChangeWatcher& operator=(const MemoryChangeWatcher&);
+};
+
+#endif //MEMORYCHANGEWATCHER_H
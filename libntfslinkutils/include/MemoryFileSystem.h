@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MEMORYFILESYSTEM_H
+#define MEMORYFILESYSTEM_H
+#pragma once
+
+#include "FileSystemBackend.h"
+#include "Metrics.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+class MemoryChangeWatcher;
+
+/**
+ * A backend that keeps the whole tree in memory. Junctions and symbolic links are stored with their tags as they are
+ * on NTFS, on every platform, and directories are enumerated in name order so that every run over the same tree
+ * visits the entries in the same order.
+ *
+ * Each operation can be given a fixed delay, which stands in for the latency of a real disk or network share. The
+ * delay is spent outside of the lock that guards the tree, so operations overlap the way they would against a real
+ * file system and traversal and scheduling changes can be measured on any machine without touching a disk.
+ *
+ * Paths are compared exactly, without folding case. The tree starts out empty and its top level directories are
+ * added with AddDirectory before it is used.
+ *
+ * CreateWatcher returns a MemoryChangeWatcher, which is told about every entry created, moved or given a new target.
+ */
+class MemoryFileSystem : public FileSystemBackend
+{
+public:
+	MemoryFileSystem();
+
+	/**
+	 * Adds a directory at the top of the tree. Its parent does not need to exist.
+	 *
+	 * @param Path The full path of the directory to add.
+	 * @return Returns zero if the operation was successful, otherwise ERROR_ALREADY_EXISTS.
+	 */
+	DWORD AddDirectory(LPCTSTR Path);
+
+	/**
+	 * Sets the delay added to every operation of the given kind. Must be called before the backend is shared.
+	 *
+	 * Renames are delayed as MetricModify, and creating and deleting plain files as MetricCreate and MetricDelete.
+	 *
+	 * @param Operation The kind of operation to delay.
+	 * @param Microseconds The delay, in microseconds. Zero adds no delay.
+	 */
+	void SetLatency(MetricOperation Operation, DWORD Microseconds);
+
+	/**
+	 * Sets the same delay for every kind of operation.
+	 */
+	void SetLatency(DWORD Microseconds);
+
+	/** Returns the number of operations performed so far. */
+	ULONGLONG GetOperationCount() const { return NumOperations; }
+
+	/**
+	 * Starts or stops telling a watcher about changes. Called by MemoryChangeWatcher itself.
+	 */
+	void AddWatcher(MemoryChangeWatcher* Watcher);
+	void RemoveWatcher(MemoryChangeWatcher* Watcher);
+
+	virtual DWORD GetAttributes(LPCTSTR Path, DWORD& Attributes);
+	virtual DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time);
+	virtual DWORD Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context);
+	virtual DWORD ReadLink(LPCTSTR Path, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target);
+	virtual DWORD DeleteLink(DWORD Tag, LPCTSTR Path);
+	virtual DWORD DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name);
+	virtual DWORD Rename(LPCTSTR OldPath, LPCTSTR NewPath);
+	virtual DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path);
+	virtual DWORD CreateEmptyFile(LPCTSTR Path);
+	virtual DWORD RemoveFile(LPCTSTR Path);
+	virtual DWORD RemoveEmptyDirectory(LPCTSTR Path);
+	virtual ChangeWatcher* CreateWatcher();
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	struct Node
+	{
+		DWORD Attributes;
+		/** The reparse tag of a link, otherwise zero. */
+		DWORD Tag;
+		/** The target of a link. */
+		String Target;
+		/** Bumped whenever the node or, for a directory, its list of entries changes. */
+		ULONGLONG WriteTime;
+		/** The names of the entries of a directory, in order. */
+		std::set<String> Children;
+	};
+
+	typedef std::map<String, Node> NodeMap;
+
+	void Delay(MetricOperation Operation);
+	Node* FindParent(const String& Path, String& Name);
+	DWORD AddNode(LPCTSTR Path, const Node& NewNode);
+	DWORD RemoveNode(LPCTSTR Path, DWORD Attributes);
+	void NotifyChange(const String& Path);
+
+	/** Guards Nodes, Clock and Watchers. */
+	std::mutex Lock;
+	/** Every node of the tree, keyed on its full path. */
+	NodeMap Nodes;
+	/** The source of write times. */
+	ULONGLONG Clock;
+	/** The watchers to tell about changes. */
+	std::vector<MemoryChangeWatcher*> Watchers;
+	/** The delay of each kind of operation, in microseconds. */
+	DWORD Latency[NumMetricOperations];
+	std::atomic<ULONGLONG> NumOperations;
+
+	// Not copyable
+	MemoryFileSystem(const MemoryFileSystem&);
+	MemoryFileSystem& operator=(const MemoryFileSystem&);
+};
+
+#endif //MEMORYFILESYSTEM_H
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef METRICS_H
+#define METRICS_H
+#pragma once
+
+#include "Platform.h"
+
+/**
+ * The file system and string operations whose latency is recorded.
+ */
+enum MetricOperation
+{
+	/** Reading the entries of a directory, not counting the time spent handling each entry. */
+	MetricEnumerate,
+	/** Querying the attributes or last write time of a path. */
+	MetricQuery,
+	/** Reading the tag and target of a reparse point. */
+	MetricRead,
+	/** Creating a link. */
+	MetricCreate,
+	/** Replacing the target of an existing link. */
+	MetricModify,
+	/** Deleting a link. */
+	MetricDelete,
+	/** Creating a directory. */
+	MetricCreateDirectory,
+	/** Rewriting or rebasing a link target. */
+	MetricRewrite,
+	NumMetricOperations
+};
+
+/**
+ * A summary of the latencies recorded for one operation. Percentiles are the upper bound of the power of two bucket
+ * that holds them, so they are accurate to within a factor of two.
+ */
+struct MetricSummary
+{
+	ULONGLONG Count;
+	ULONGLONG TotalNs;
+	ULONGLONG MaxNs;
+	ULONGLONG P50Ns;
+	ULONGLONG P90Ns;
+	ULONGLONG P99Ns;
+};
+
+/** Set by EnableMetrics. Checked inline so that the hot paths cost a single test while metrics are off. */
+extern bool bMetricsEnabled;
+
+/**
+ * Turns the recording of latencies on or off. Must be called before any other thread is started.
+ */
+void EnableMetrics(bool bEnable);
+
+/**
+ * Returns the current value of the high resolution clock, in ticks.
+ */
+ULONGLONG ReadMetricClock();
+
+/**
+ * Adds a latency to the histogram of an operation. May be called from several threads at once.
+ *
+ * @param Operation The operation that was timed.
+ * @param Ticks The time the operation took, as measured by ReadMetricClock.
+ */
+void RecordMetric(MetricOperation Operation, ULONGLONG Ticks);
+
+/**
+ * Summarizes the latencies recorded for an operation so far.
+ */
+void GetMetricSummary(MetricOperation Operation, MetricSummary& Summary);
+
+/**
+ * Returns the name of an operation as shown in summaries.
+ */
+LPCTSTR GetMetricName(MetricOperation Operation);
+
+/**
+ * Times an operation from construction to destruction and records it, if metrics are enabled. Work done on behalf of
+ * somebody else, such as a callback, can be left out by pausing the timer around it.
+ */
+class MetricTimer
+{
+public:
+	MetricTimer(MetricOperation Operation)
+		: Operation(Operation)
+		, Start(bMetricsEnabled ? ReadMetricClock() : 0)
+		, Elapsed(0)
+	{
+	}
+
+	~MetricTimer()
+	{
+		if (bMetricsEnabled)
+		{
+			RecordMetric(Operation, Elapsed + ReadMetricClock() - Start);
+		}
+	}
+
+	/** Stops counting time until Resume is called. */
+	void Pause()
+	{
+		if (bMetricsEnabled)
+		{
+			Elapsed += ReadMetricClock() - Start;
+		}
+	}
+
+	/** Starts counting time again after Pause. */
+	void Resume()
+	{
+		if (bMetricsEnabled)
+		{
+			Start = ReadMetricClock();
+		}
+	}
+
+private:
+	MetricOperation Operation;
+	ULONGLONG Start;
+	ULONGLONG Elapsed;
+
+	// Not copyable
+	MetricTimer(const MetricTimer&);
+	MetricTimer& operator=(const MetricTimer&);
+};
+
+#endif //METRICS_H
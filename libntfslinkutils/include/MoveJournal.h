@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MOVEJOURNAL_H
+#define MOVEJOURNAL_H
+#pragma once
+
+#include "Platform.h"
+
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/**
+ * An append-only record of the progress of a two phase move, allowing an interrupted move to resume where it stopped.
+ *
+ * The journal is a UTF-8 text file with one record per line:
+ *
+ *		R <source root>			The move the journal belongs to. Written when the journal is created.
+ *		T <destination root>
+ *		C <tag> <source path>	The destination of a link was created. The tag is the reparse tag in hex.
+ *		E						Every link was created and only the deletes remain.
+ *		D <source path>			The source of a link was deleted.
+ *
+ * Records are only ever appended and flushed in batches, so an interruption loses at most the last few records and
+ * can leave a partial line at the end. Losing records is harmless: a destination created again is simply replaced and
+ * a source that is already gone counts as deleted. When a journal is resumed it is first rewritten with only the
+ * records that are still needed, which drops any partial line.
+ *
+ * Records may be added from several threads at once.
+ */
+class MoveJournal
+{
+public:
+	typedef std::basic_string<TCHAR> String;
+
+	/** A link whose destination was created but whose source may not have been deleted yet. */
+	struct Entry
+	{
+		/** The full path of the source link. */
+		String Path;
+		/** The reparse tag of the source link. */
+		DWORD Tag;
+	};
+
+	MoveJournal();
+	~MoveJournal();
+
+	/**
+	 * Reads the records of an existing journal, if there is one, rewrites it with the records that are still needed
+	 * and opens it for appending.
+	 *
+	 * @param JournalPath The path of the journal file.
+	 * @param Src The full path of the source root being moved.
+	 * @param Dest The full path of the destination root.
+	 * @return Returns zero if the operation was successful, ERROR_BAD_FORMAT if the journal belongs to a different
+	 *		move, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Open(LPCTSTR JournalPath, LPCTSTR Src, LPCTSTR Dest);
+
+	/**
+	 * Flushes and closes the journal. The journal file is deleted if the move completed.
+	 *
+	 * @param bCompleted Set to true if every link was moved and the journal is no longer needed.
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Close(bool bCompleted);
+
+	/** Returns true if a previous run finished creating every link, so that the tree need not be walked again. */
+	bool IsEnumerated() const { return bEnumerated; }
+
+	/**
+	 * Looks up a link that a previous run created the destination of but did not delete.
+	 *
+	 * @param Path The full path of the source link.
+	 * @param Tag The reparse tag of the source link. [OUT]
+	 * @return Returns true if the link was found.
+	 */
+	bool FindCreated(LPCTSTR Path, DWORD& Tag) const;
+
+	/**
+	 * Returns the links that a previous run created the destination of but did not delete.
+	 */
+	void GetCreated(std::vector<Entry>& Entries) const;
+
+	/**
+	 * Records that the destination of a link was created.
+	 */
+	void AddCreated(LPCTSTR Path, DWORD Tag);
+
+	/**
+	 * Records that every link was created. The journal is flushed immediately.
+	 */
+	void AddEnumerated();
+
+	/**
+	 * Records that the sources of a batch of links were deleted. The journal is flushed immediately.
+	 */
+	void AddDeleted(const std::vector<const Entry*>& Entries);
+
+private:
+	DWORD Read(LPCTSTR JournalPath);
+	void Write(LPCTSTR Record, bool bFlush);
+
+	/** The number of records appended between flushes. */
+	enum { FlushInterval = 64 };
+
+	String JournalPath;
+	FILE* File;
+	std::mutex Lock;
+	int NumUnflushed;
+
+	String Src;
+	String Dest;
+	bool bEnumerated;
+	/** The links created but not deleted by previous runs, by source path. */
+	std::map<String, DWORD> Created;
+
+	// Not copyable
+	MoveJournal(const MoveJournal&);
+	MoveJournal& operator=(const MoveJournal&);
+};
+
+#endif //MOVEJOURNAL_H
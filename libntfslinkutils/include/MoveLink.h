@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MOVELINK_H
+#define MOVELINK_H
+#pragma once
+
+#include "ActionPlan.h"
+#include "PathBuffer.h"
+#include "PathFilter.h"
+#include "Platform.h"
+#include "RewriteRules.h"
+#include "RootMap.h"
+#include "TreeWalker.h"
+
+#include <atomic>
+#include <memory.h>
+
+struct mvlinkOptions
+{
+	/** Set to true to enable verbose logging. */
+	bool bVerbose;
+	/** The maximum file tree depth to traverse before stopping. */
+	int MaxDepth;
+	/** The number of worker threads used to traverse the tree. Zero uses one per processor. */
+	int NumThreads;
+	/** The order in which directories are traversed. */
+	WalkOrder Order;
+	/** The plan to record each operation to instead of performing it, or NULL. */
+	ActionPlan* Plan;
+	/** The counters to report the progress of the walk to, or NULL. */
+	WalkProgress* Progress;
+	/** The filter that decides which directories are walked and which links are processed, or NULL. */
+	const PathFilter* Filter;
+	/** Set to true to create every destination link before deleting any source link. */
+	bool bTwoPhase;
+	/** The rules to rewrite targets with. Takes the place of OldTargetBase and NewTargetBase when set. */
+	const RewriteRules* Rules;
+	/** The old roots to rebase targets from and the new roots to rebase them to. Takes the place of OldTargetBase and NewTargetBase when set. */
+	const RootMap* Roots;
+	/** The root to rebase targets to. */
+	TCHAR NewTargetBase[MAX_PATH];
+	/** The root to rebase targets from. Only targets beneath it are rebased. */
+	TCHAR OldTargetBase[MAX_PATH];
+	/** The path of the journal used to resume an interrupted move, or empty for no journal. A journal always makes the
+	 *  move two phase, whether or not bTwoPhase is set. */
+	PathBuffer JournalPath;
+
+	mvlinkOptions()
+		: bVerbose(false)
+		, MaxDepth(-1)
+		, NumThreads(0)
+		, Order(WalkDepthFirst)
+		, Plan(NULL)
+		, Progress(NULL)
+		, Filter(NULL)
+		, bTwoPhase(false)
+		, Rules(NULL)
+		, Roots(NULL)
+	{
+		memset(NewTargetBase, 0, sizeof(NewTargetBase));
+		memset(OldTargetBase, 0, sizeof(OldTargetBase));
+	}
+};
+
+struct mvlinkStats
+{
+	/** The number of file objects that failed to be moved. */
+	std::atomic<size_t> NumFailed;
+	/** The number of file objects successfully moved. In a two phase move a link counts once its source is deleted. */
+	std::atomic<size_t> NumMoved;
+	/** The number of file objects that were skipped. */
+	std::atomic<size_t> NumSkipped;
+
+	mvlinkStats()
+		: NumFailed(0)
+		, NumMoved(0)
+		, NumSkipped(0)
+	{
+	}
+};
+
+/**
+ * Moves all reparse points in the specified source path to a given destination and rebases the target of each based on
+ * the options set (when applicable).
+ *
+ * By default each source link is deleted as soon as its destination is created. A two phase move instead creates
+ * every destination link while walking the source tree and then deletes the sources in parallel batches, sorted by
+ * path, so that writes to the two volumes are not interleaved. With a journal the progress of both phases is recorded,
+ * and running the same move again resumes it: links already created are not read again, and once the first phase has
+ * completed the source tree is not walked at all.
+ *
+ * @param Src The path of the source file to move.
+ * @param Dest The path of the destination to move Src to.
+ * @param Options The options controlling the move.
+ * @param Stats The statistics to update while moving. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value on failure.
+ */
+DWORD mvlink(LPCTSTR Src, LPCTSTR Dest, const mvlinkOptions& Options, mvlinkStats& Stats);
+
+#endif //MOVELINK_H
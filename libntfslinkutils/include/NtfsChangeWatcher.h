@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef NTFSCHANGEWATCHER_H
+#define NTFSCHANGEWATCHER_H
+#pragma once
+
+#ifdef _WIN32
+
+#include "ChangeWatcher.h"
+#include "RootMap.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Watches for changes with ReadDirectoryChangesW. Each watched directory covers its whole subtree, so only the first
+ * directory of each tree the walker enters is opened and every directory beneath it is ignored.
+ *
+ * Every watch completes to a single I/O completion port, so there is no limit on the number of trees watched at once
+ * and Stop only has to post to the port.
+ */
+class NtfsChangeWatcher : public ChangeWatcher
+{
+public:
+	NtfsChangeWatcher();
+	virtual ~NtfsChangeWatcher();
+
+	/**
+	 * Creates the completion port. Must be called before anything else.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Open();
+
+	virtual DWORD WatchDirectory(LPCTSTR Path);
+	virtual DWORD WaitForChanges(std::vector<std::basic_string<TCHAR> >& Paths);
+	virtual void Stop();
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	/** A watched subtree. */
+	struct Watch
+	{
+		OVERLAPPED Overlapped;
+		HANDLE hDirectory;
+		String Path;
+		/** Receives the FILE_NOTIFY_INFORMATION records. Must be DWORD aligned. */
+		DWORD Buffer[16 * 1024];
+	};
+
+	DWORD Read(Watch* Dir);
+	void AddChanges(const Watch* Dir, DWORD Length, std::vector<String>& Paths);
+
+	HANDLE hPort;
+
+	/** Guards Watches and Watched. */
+	std::mutex Lock;
+	std::vector<Watch*> Watches;
+	/** The roots of the watched subtrees. */
+	RootMap Watched;
+
+	// Not copyable
+	NtfsChangeWatcher(const NtfsChangeWatcher&);
+	NtfsChangeWatcher& operator=(const NtfsChangeWatcher&);
+};
+
+#endif //_WIN32
+
+#endif //NTFSCHANGEWATCHER_H
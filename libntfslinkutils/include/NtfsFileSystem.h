@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef NTFSFILESYSTEM_H
+#define NTFSFILESYSTEM_H
+#pragma once
+
+#ifdef _WIN32
+
+#include "FileSystemBackend.h"
+
+/**
+ * The native backend on Windows. Links are created and deleted through libntfslinks, while reparse points are read
+ * and rewritten in place with FSCTL_GET_REPARSE_POINT and FSCTL_SET_REPARSE_POINT.
+ *
+ * Directories are enumerated with the basic information level, which skips the short names, and a large fetch, which
+ * lets the system read many entries per call. The entries are handed on in batches of EnumerateBatchSize.
+ *
+ * Each directory is also held open while it is enumerated, and the *At methods open its entries relative to that
+ * handle with NtCreateFile, so the object manager doesn't parse the full path of every link it reads or rewrites.
+ */
+class NtfsFileSystem : public FileSystemBackend
+{
+public:
+	virtual DWORD GetAttributes(LPCTSTR Path, DWORD& Attributes);
+	virtual DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time);
+	virtual DWORD Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context);
+	virtual DWORD ReadLink(LPCTSTR Path, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target);
+	virtual DWORD DeleteLink(DWORD Tag, LPCTSTR Path);
+	virtual DWORD DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name);
+	virtual DWORD Rename(LPCTSTR OldPath, LPCTSTR NewPath);
+	virtual DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path);
+	virtual DWORD CreateEmptyFile(LPCTSTR Path);
+	virtual DWORD RemoveFile(LPCTSTR Path);
+	virtual DWORD RemoveEmptyDirectory(LPCTSTR Path);
+	virtual ChangeWatcher* CreateWatcher();
+
+private:
+	enum { EnumerateBatchSize = 64 };
+};
+
+#endif //_WIN32
+
+#endif //NTFSFILESYSTEM_H
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef NTFSLINKS_H
+#define NTFSLINKS_H
+#pragma once
+
+#include "Platform.h"
+
+#ifdef _WIN32
+
+#include <Junction.h>
+#include <StringUtils.h>
+#include <Symlink.h>
+
+#else
+
+// libntfslinks is only available on Windows. Elsewhere the same interface is provided on top of POSIX symbolic links so
+// that the link engines can run unmodified. POSIX has no notion of a junction, so every link is reported as a symbolic
+// link and junctions are created as symbolic links.
+
+namespace libntfslinks
+{
+
+/**
+ * Determines if the specified path is a valid NTFS junction (reparse point). Always false on POSIX.
+ *
+ * @param Path The path to verify is a junction.
+ * @return Returns true if the specified path is a valid NTFS junction, otherwise false.
+ */
+bool IsJunction(LPCTSTR Path);
+
+/**
+ * Retrieves the target path for the specified junction.
+ *
+ * @param Path The path of the junction to retrieve data for.
+ * @param TargetPath The buffer to write the junction's target path to. [OUT]
+ * @param TargetSize The size of the TargetPath buffer.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetJunctionTarget(LPCTSTR Path, LPTSTR TargetPath, size_t TargetSize);
+
+/**
+ * Creates a new junction at the specified link path which points to the given target path.
+ *
+ * @param Link The path of the junction to create that will link to Target.
+ * @param Target The destination path that the new junction will point to.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD CreateJunction(LPCTSTR Link, LPCTSTR Target);
+
+/**
+ * Deletes a junction at the specified path location.
+ *
+ * @param Path The path of the junction to delete.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD DeleteJunction(LPCTSTR Path);
+
+/**
+ * Determines if the specified path is a symbolic link.
+ *
+ * @param Path The path to verify is a symbolic link.
+ * @return Returns true if the specified path is a symbolic link, otherwise false.
+ */
+bool IsSymlink(LPCTSTR Path);
+
+/**
+ * Retrieves the target path for the specified symbolic link.
+ *
+ * @param Path The path of the symbolic link to retrieve data for.
+ * @param TargetPath The buffer to write the symbolic link's target path to. [OUT]
+ * @param TargetSize The size of the TargetPath buffer.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetSymlinkTarget(LPCTSTR Path, LPTSTR TargetPath, size_t TargetSize);
+
+/**
+ * Creates a new symbolic link at the specified link path which points to the given target path.
+ *
+ * @param Link The path of the symbolic link to create that will link to Target.
+ * @param Target The destination path that the new symbolic link will point to.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD CreateSymlink(LPCTSTR Link, LPCTSTR Target);
+
+/**
+ * Deletes a symbolic link at the specified path location.
+ *
+ * @param Path The path of the symbolic link to delete.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD DeleteSymlink(LPCTSTR Path);
+
+} // namespace libntfslinks
+
+/**
+ * Finds the first occurrence of the string Sub in string Str.
+ *
+ * @param Str The string to search for the substring.
+ * @param Sub The string to search for in Str.
+ * @param StartIdx The index of Str to begin the search from. A negative starting index will count backwards from the
+ *			length of Str. Default is 0.
+ * @param Dir The direction to perform the search in. Set to 1 for a left-to-right search, set to -1 for a
+ *		right-to-left search.
+ * @return Returns the starting index of the substring in Str or -1 if not found.
+ */
+int StrFind(LPCTSTR Str, LPCTSTR Sub, int StartIdx = 0, int Dir = 1);
+
+/**
+ * Searches a string for the first occurrence of a provided search string and replaces it with another.
+ *
+ * @param SrcStr The source string to search for the substring and perform replacement on.
+ * @param Search The substring to search for.
+ * @param Replace The string to replace the substring with.
+ * @param DestStr The destination to write the resulting string to.
+ * @param StartIdx The index of Str to begin the search from. A negative starting index will count backwards from the
+ *			length of SrcStr. Default is 0.
+ * @param Dir The direction to perform the search in. Set to 1 for a left-to-right search, set to -1 for a
+ *		right-to-left search.
+ * @return Returns true if the operation was successful, otherwise false.
+ */
+bool StrReplace(LPCTSTR SrcStr, LPCTSTR Search, LPCTSTR Replace, LPTSTR DestStr, int StartIdx = 0, int Dir = 1);
+
+#endif //_WIN32
+
+#endif //NTFSLINKS_H
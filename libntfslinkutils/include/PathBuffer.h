@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PATHBUFFER_H
+#define PATHBUFFER_H
+#pragma once
+
+#include "Platform.h"
+
+/** The longest path, in characters, that Windows accepts once the path is given the \\?\ prefix. */
+#define MAX_LONG_PATH 32767
+
+/**
+ * A null terminated path that grows as needed, up to MAX_LONG_PATH characters.
+ *
+ * Paths of up to InlineSize characters are held inside the object itself, so short paths never touch the heap.
+ * Child paths are built by appending a name to the parent and truncating back to the parent afterwards, which lets a
+ * single buffer be reused for every entry of a directory without copying the parent each time.
+ */
+class PathBuffer
+{
+public:
+	PathBuffer();
+	PathBuffer(const PathBuffer& Other);
+	~PathBuffer();
+
+	PathBuffer& operator=(const PathBuffer& Other);
+
+	/** Returns the path. Never NULL. */
+	LPCTSTR Get() const { return Buffer; }
+
+	/** Returns the length of the path, in characters. */
+	size_t Length() const { return Size; }
+
+	/** Returns true if the path is empty. */
+	bool IsEmpty() const { return Size == 0; }
+
+	/**
+	 * Replaces the path with the given string.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise ERROR_FILENAME_EXCED_RANGE.
+	 */
+	DWORD Assign(LPCTSTR Path);
+
+	/**
+	 * Replaces the path with the first Length characters of the given string.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise ERROR_FILENAME_EXCED_RANGE.
+	 */
+	DWORD Assign(LPCTSTR Path, size_t Length);
+
+	/**
+	 * Appends the given string to the path as is.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise ERROR_FILENAME_EXCED_RANGE.
+	 */
+	DWORD Append(LPCTSTR Text);
+
+	/**
+	 * Appends a path component, inserting a separator unless the path is empty or already ends with one.
+	 *
+	 * @return Returns zero if the operation was successful, otherwise ERROR_FILENAME_EXCED_RANGE.
+	 */
+	DWORD AppendName(LPCTSTR Name);
+
+	/**
+	 * Shortens the path to the given length. Used to return to a parent after building one of its children.
+	 */
+	void Truncate(size_t Length);
+
+	/**
+	 * Makes room for a path of the given length and returns the buffer so that an API can write the path directly.
+	 * SetLength must be called afterwards with the length that was written.
+	 *
+	 * @param Length The number of characters to make room for, not counting the terminator.
+	 * @return Returns the writable buffer, or NULL if Length exceeds MAX_LONG_PATH.
+	 */
+	LPTSTR Reserve(size_t Length);
+
+	/**
+	 * Sets the length of a path written directly into the buffer returned by Reserve.
+	 */
+	void SetLength(size_t Length);
+
+private:
+	bool Grow(size_t Length);
+
+	enum { InlineSize = 260 };
+
+	LPTSTR Buffer;
+	size_t Size;
+	/** The number of characters the buffer can hold, not counting the terminator. */
+	size_t Capacity;
+	TCHAR Inline[InlineSize + 1];
+};
+
+#endif //PATHBUFFER_H
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+#pragma once
+
+#include "Platform.h"
+
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * The part of a link that a filter pattern is matched against.
+ */
+enum FilterField
+{
+	/** The path of the link or directory, relative to the root of the walk. */
+	FilterPath,
+	/** The target of the link. */
+	FilterTarget,
+	NumFilterFields
+};
+
+/**
+ * Include and exclude patterns that decide which links are processed and which directories are walked.
+ *
+ * A pattern starting with 're:' is an ECMAScript regular expression that may match anywhere in the path or target.
+ * Any other pattern is a glob, in which '*' matches any run of characters within a path component, '**' matches any
+ * run of characters including separators and '?' matches a single character other than a separator. A glob that has
+ * no separator in it is matched against the last component only, so 'node_modules' or '*.tmp' match at any depth,
+ * while a glob with a separator must match the whole path or target. On Windows matching ignores case and either kind
+ * of slash matches either separator.
+ *
+ * Every pattern is compiled when it is added. Globs without wildcards, the most common kind of exclusion, are kept in
+ * a set and found with a single lookup of the last component.
+ *
+ * A directory whose path matches an exclude pattern is pruned before it is enumerated, so nothing beneath it is read.
+ * Include patterns never prune, as a directory that doesn't match may still hold links that do.
+ *
+ * Once all of the patterns are added the filter is read only and may be used from several threads at once.
+ */
+class PathFilter
+{
+public:
+	/**
+	 * Adds a pattern.
+	 *
+	 * @param Field What the pattern is matched against.
+	 * @param bExclude Set to true to exclude whatever matches, otherwise only what matches is included.
+	 * @param Pattern The glob or regular expression.
+	 * @return Returns zero if the operation was successful, otherwise ERROR_BAD_FORMAT if the pattern is not valid.
+	 */
+	DWORD AddPattern(FilterField Field, bool bExclude, LPCTSTR Pattern);
+
+	/** Returns true if no patterns have been added. */
+	bool IsEmpty() const;
+
+	/** Returns true if any pattern is matched against link targets, which then have to be read before filtering. */
+	bool HasTargetPatterns() const;
+
+	/**
+	 * Determines if a directory is excluded and should not be walked.
+	 *
+	 * @param RelativePath The path of the directory relative to the root of the walk.
+	 */
+	bool IsExcludedDirectory(LPCTSTR RelativePath) const;
+
+	/**
+	 * Determines if a link passes the path patterns.
+	 *
+	 * @param RelativePath The path of the link relative to the root of the walk.
+	 */
+	bool MatchesLinkPath(LPCTSTR RelativePath) const;
+
+	/**
+	 * Determines if a link passes the target patterns.
+	 *
+	 * @param Target The target of the link.
+	 */
+	bool MatchesLinkTarget(LPCTSTR Target) const;
+
+private:
+	typedef std::basic_string<TCHAR> String;
+	typedef std::basic_regex<TCHAR> Regex;
+
+	/** The compiled patterns of one field, either all includes or all excludes. */
+	struct PatternSet
+	{
+		/** Globs without wildcards or separators, folded on Windows. */
+		std::set<String> Names;
+		/** Globs that are matched against the last component, folded on Windows. */
+		std::vector<String> NameGlobs;
+		/** Globs that are matched against the whole path, folded on Windows. */
+		std::vector<String> PathGlobs;
+		std::vector<Regex> Regexes;
+
+		bool IsEmpty() const { return Names.empty() && NameGlobs.empty() && PathGlobs.empty() && Regexes.empty(); }
+		bool Matches(LPCTSTR Path) const;
+	};
+
+	PatternSet Includes[NumFilterFields];
+	PatternSet Excludes[NumFilterFields];
+};
+
+#endif //PATHFILTER_H
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+#pragma once
+
+// The link engines are written against the Win32 API. On other platforms the small subset of types, string helpers
+// and error codes that they rely on is mapped onto the POSIX equivalents so the same engines can be built and
+// exercised on Linux.
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include <tchar.h>
+#include <strsafe.h>
+
+/** The character used to separate path components. */
+#define PATH_SEPARATOR TEXT('\\')
+
+#else
+
+#include <atomic>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef char TCHAR;
+typedef TCHAR* LPTSTR;
+typedef const TCHAR* LPCTSTR;
+typedef uint32_t DWORD;
+typedef uint64_t ULONGLONG;
+typedef int32_t HRESULT;
+
+#define TEXT(s) s
+#define MAX_PATH PATH_MAX
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define WINAPI
+
+#define _tmain main
+#define _tprintf printf
+#define _vtprintf vprintf
+#define _ftprintf fprintf
+#define _tfopen fopen
+#define _fgetts fgets
+#define _fputts fputs
+#define _tremove remove
+#define _tcslen strlen
+#define _tcscmp strcmp
+#define _tcsncmp strncmp
+#define _tcschr strchr
+#define _tcsrchr strrchr
+#define _ttoi atoi
+#define _tcstoul strtoul
+
+/** The character used to separate path components. */
+#define PATH_SEPARATOR '/'
+
+// Win32 error codes map onto their errno counterparts
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND ENOENT
+#define ERROR_PATH_NOT_FOUND ENOTDIR
+#define ERROR_ACCESS_DENIED EACCES
+#define ERROR_ALREADY_EXISTS EEXIST
+#define ERROR_DIRECTORY ENOTDIR
+#define ERROR_DIR_NOT_EMPTY ENOTEMPTY
+#define ERROR_FILENAME_EXCED_RANGE ENAMETOOLONG
+#define ERROR_NOT_ENOUGH_MEMORY ENOMEM
+#define ERROR_NOT_A_REPARSE_POINT EINVAL
+#define ERROR_BAD_FORMAT ENOEXEC
+#define ERROR_OPERATION_ABORTED ECANCELED
+
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_ATTRIBUTE_REPARSE_POINT 0x00000400
+
+#define IO_REPARSE_TAG_MOUNT_POINT 0xA0000003L
+#define IO_REPARSE_TAG_SYMLINK 0xA000000CL
+
+#define FLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
+
+#define S_OK ((HRESULT)0)
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+/**
+ * The number of file system calls made by the library. Windows reports the equivalent through GetProcessIoCounters.
+ */
+extern std::atomic<ULONGLONG> NumSystemCalls;
+
+/**
+ * Returns the error code of the last failed system call made by the calling thread.
+ */
+inline DWORD GetLastError()
+{
+	return (DWORD)errno;
+}
+
+/** Called with the value of a fiber local storage slot when a thread that set the slot exits. */
+typedef void (*PFLS_CALLBACK_FUNCTION)(void* Data);
+
+/**
+ * Allocates a thread local storage slot whose callback is called when a thread that set the slot exits. Behaves like
+ * the Win32 function of the same name, with each thread having a single fiber.
+ */
+inline DWORD FlsAlloc(PFLS_CALLBACK_FUNCTION Callback)
+{
+	pthread_key_t key;
+	return pthread_key_create(&key, Callback) == 0 ? (DWORD)key : FLS_OUT_OF_INDEXES;
+}
+
+/**
+ * Returns the value of the calling thread in the given slot, or NULL if it was never set.
+ */
+inline void* FlsGetValue(DWORD FlsIndex)
+{
+	return pthread_getspecific((pthread_key_t)FlsIndex);
+}
+
+/**
+ * Sets the value of the calling thread in the given slot.
+ */
+inline bool FlsSetValue(DWORD FlsIndex, void* Data)
+{
+	return pthread_setspecific((pthread_key_t)FlsIndex, Data) == 0;
+}
+
+/**
+ * Copies Src to Dest, truncating if Dest is too small. Behaves like the strsafe function of the same name.
+ */
+inline HRESULT StringCchCopy(LPTSTR Dest, size_t DestSize, LPCTSTR Src)
+{
+	size_t length = strlen(Src);
+	if (length >= DestSize)
+	{
+		if (DestSize > 0)
+		{
+			memcpy(Dest, Src, DestSize - 1);
+			Dest[DestSize - 1] = 0;
+		}
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+	}
+
+	memcpy(Dest, Src, length + 1);
+	return S_OK;
+}
+
+/**
+ * Appends Src to Dest, truncating if Dest is too small. Behaves like the strsafe function of the same name.
+ */
+inline HRESULT StringCchCat(LPTSTR Dest, size_t DestSize, LPCTSTR Src)
+{
+	size_t length = strnlen(Dest, DestSize);
+	if (length >= DestSize)
+	{
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+	}
+
+	return StringCchCopy(Dest + length, DestSize - length, Src);
+}
+
+/**
+ * Writes formatted data to Dest, truncating if Dest is too small. Behaves like the strsafe function of the same name.
+ */
+inline HRESULT StringCchVPrintf(LPTSTR Dest, size_t DestSize, LPCTSTR Format, va_list Args)
+{
+	int length = vsnprintf(Dest, DestSize, Format, Args);
+
+	return length >= 0 && (size_t)length < DestSize ? S_OK : STRSAFE_E_INSUFFICIENT_BUFFER;
+}
+
+/**
+ * Writes formatted data to Dest, truncating if Dest is too small. Behaves like the strsafe function of the same name.
+ */
+inline HRESULT StringCchPrintf(LPTSTR Dest, size_t DestSize, LPCTSTR Format, ...)
+{
+	va_list args;
+	va_start(args, Format);
+	HRESULT result = StringCchVPrintf(Dest, DestSize, Format, args);
+	va_end(args);
+
+	return result;
+}
+
+#endif //_WIN32
+
+#endif //PLATFORM_H
@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef POSIXFILESYSTEM_H
+#define POSIXFILESYSTEM_H
+#pragma once
+
+#ifndef _WIN32
+
+#include "FileSystemBackend.h"
+
+#include <atomic>
+
+/**
+ * The native backend on platforms other than Windows. Works with symbolic links through the POSIX API and reports
+ * every one of them as IO_REPARSE_TAG_SYMLINK. Junctions are created as symbolic links.
+ *
+ * Each system call made is counted in NumSystemCalls.
+ *
+ * On Linux directories are read with getdents64 into a large buffer, so a directory holding tens of thousands of
+ * entries takes a handful of system calls and each buffer full is handed on as one batch.
+ *
+ * The directory descriptor is handed to the callback with each batch, and the *At methods work relative to it with
+ * fstatat, readlinkat, symlinkat, renameat and unlinkat, so the kernel doesn't walk the full path again per link.
+ */
+class PosixFileSystem : public FileSystemBackend
+{
+public:
+	PosixFileSystem();
+
+	/**
+	 * Sets the size of the buffer that directory entries are read into. See SetEnumerateBufferSize in FileSystem.h.
+	 */
+	void SetEnumerateBufferSize(size_t Bytes);
+
+	virtual DWORD GetAttributes(LPCTSTR Path, DWORD& Attributes);
+	virtual DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time);
+	virtual DWORD Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context);
+	virtual DWORD ReadLink(LPCTSTR Path, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, libntfslinks::ReparsePointInfo& Info);
+	virtual DWORD CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+	virtual DWORD SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target);
+	virtual DWORD DeleteLink(DWORD Tag, LPCTSTR Path);
+	virtual DWORD DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name);
+	virtual DWORD Rename(LPCTSTR OldPath, LPCTSTR NewPath);
+	virtual DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path);
+	virtual DWORD CreateEmptyFile(LPCTSTR Path);
+	virtual DWORD RemoveFile(LPCTSTR Path);
+	virtual DWORD RemoveEmptyDirectory(LPCTSTR Path);
+	virtual ChangeWatcher* CreateWatcher();
+
+private:
+	static const size_t DefaultEnumerateBufferSize = 64 * 1024;
+	/** The smallest buffer that always holds an entry with the longest possible name. */
+	static const size_t MinEnumerateBufferSize = 4096;
+
+	std::atomic<size_t> EnumerateBufferSize;
+};
+
+#endif //_WIN32
+
+#endif //POSIXFILESYSTEM_H
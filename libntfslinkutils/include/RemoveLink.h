@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef REMOVELINK_H
+#define REMOVELINK_H
+#pragma once
+
+#include "ActionPlan.h"
+#include "LinkSelector.h"
+#include "PathBuffer.h"
+#include "PathFilter.h"
+#include "Platform.h"
+#include "TreeWalker.h"
+
+#include <atomic>
+#include <vector>
+
+struct rmlinkOptions
+{
+	/** Set to true to enable verbose logging. */
+	bool bVerbose;
+	/** The maximum file tree depth to traverse before stopping. */
+	int MaxDepth;
+	/** The number of worker threads used to traverse the tree. Zero uses one per processor. */
+	int NumThreads;
+	/** The order in which directories are traversed. */
+	WalkOrder Order;
+	/** The plan to record each operation to instead of performing it, or NULL. */
+	ActionPlan* Plan;
+	/** The counters to report the progress of the walk to, or NULL. */
+	WalkProgress* Progress;
+	/** The filter that decides which directories are walked and which links are processed, or NULL. */
+	const PathFilter* Filter;
+	/** The selector that decides which links are processed by their target, or NULL. */
+	const LinkSelector* Selector;
+	/** The path of the link index to reuse and update, or empty to walk the entire tree. */
+	PathBuffer IndexPath;
+
+	rmlinkOptions()
+		: bVerbose(false)
+		, MaxDepth(-1)
+		, NumThreads(0)
+		, Order(WalkDepthFirst)
+		, Plan(NULL)
+		, Progress(NULL)
+		, Filter(NULL)
+		, Selector(NULL)
+	{
+	}
+};
+
+struct rmlinkStats
+{
+	/** The number of file objects that failed to be moved. */
+	std::atomic<size_t> NumFailed;
+	/** The number of file objects successfully deleted. */
+	std::atomic<size_t> NumDeleted;
+	/** The number of file objects that were skipped. */
+	std::atomic<size_t> NumSkipped;
+
+	rmlinkStats()
+		: NumFailed(0)
+		, NumDeleted(0)
+		, NumSkipped(0)
+	{
+	}
+};
+
+/**
+ * Deletes all reparse points in the specified path.
+ *
+ * @param Path The path of the reparse point or directory tree to delete links from.
+ * @param Options The options controlling the deletion.
+ * @param Stats The statistics to update while deleting. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value on failure.
+ */
+DWORD rmlink(LPCTSTR Path, const rmlinkOptions& Options, rmlinkStats& Stats);
+
+/**
+ * Deletes all reparse points in each of the specified paths. The paths are walked together by one pool of threads,
+ * and a path nested beneath another is only walked once.
+ *
+ * @param Paths The paths of the reparse points or directory trees to delete links from.
+ * @param Options The options controlling the deletion.
+ * @param Stats The statistics to update while deleting. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if any path could not be read.
+ *		Links are still deleted from the remaining paths.
+ */
+DWORD rmlink(const std::vector<LPCTSTR>& Paths, const rmlinkOptions& Options, rmlinkStats& Stats);
+
+#endif //REMOVELINK_H
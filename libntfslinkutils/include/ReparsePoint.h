@@ -0,0 +1,166 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef REPARSEPOINT_H
+#define REPARSEPOINT_H
+#pragma once
+
+#include "FileSystem.h"
+#include "PathBuffer.h"
+#include "Platform.h"
+
+namespace libntfslinks
+{
+
+/**
+ * Describes the contents of a reparse point.
+ */
+struct ReparsePointInfo
+{
+	/** The reparse tag. IO_REPARSE_TAG_MOUNT_POINT for a junction and IO_REPARSE_TAG_SYMLINK for a symbolic link. */
+	DWORD Tag;
+	/** The path the link points to. Empty for reparse points that are neither a junction nor a symbolic link. */
+	PathBuffer Target;
+	/** The user friendly form of Target as displayed by the shell. */
+	PathBuffer PrintName;
+};
+
+/**
+ * Determines if the given reparse tag is one that the link utilities know how to handle.
+ */
+inline bool IsLinkTag(DWORD Tag)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT || Tag == IO_REPARSE_TAG_SYMLINK;
+}
+
+/**
+ * Returns the name of the kind of link with the given reparse tag, as shown in messages.
+ */
+inline LPCTSTR GetLinkTypeName(DWORD Tag)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT ? TEXT("junction") : TEXT("symbolic link");
+}
+
+/**
+ * Retrieves the tag, target and print name of a reparse point in a single read of its reparse data. This replaces the
+ * separate IsJunction, IsSymlink and Get*Target calls, each of which opens the path again.
+ *
+ * On POSIX this performs one lstat and one readlink, and every symbolic link is reported as IO_REPARSE_TAG_SYMLINK.
+ *
+ * @param Path The path of the reparse point to read.
+ * @param Info The contents of the reparse point. [OUT]
+ * @return Returns zero if the operation was successful, ERROR_NOT_A_REPARSE_POINT if Path exists but is not a
+ *		reparse point, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetReparsePointInfo(LPCTSTR Path, ReparsePointInfo& Info);
+
+/**
+ * Retrieves a reparse point found by EnumerateDirectory, relative to the directory that is held open while its
+ * entries are being handled. See GetReparsePointInfo.
+ *
+ * @param Directory The directory containing the reparse point, or NULL to open Name as a full path. If the directory
+ *		isn't open, Name is joined to its path.
+ * @param Name The name of the reparse point within Directory, or its full path if Directory is NULL.
+ * @param Info The contents of the reparse point. [OUT]
+ * @return Returns zero if the operation was successful, ERROR_NOT_A_REPARSE_POINT if Name exists but is not a
+ *		reparse point, otherwise a non-zero value if an error occurred.
+ */
+DWORD GetReparsePointInfoAt(const DirectoryHandle* Directory, LPCTSTR Name, ReparsePointInfo& Info);
+
+/**
+ * Replaces the target of an existing junction in place with a single FSCTL_SET_REPARSE_POINT. Unlike deleting and
+ * recreating the junction, the link never disappears and a failure leaves the original target intact.
+ *
+ * On POSIX the new link is created beside the old one and renamed over it.
+ *
+ * @param Path The path of the existing junction to modify.
+ * @param Target The new target of the junction. Relative targets are expanded to a full path against the directory
+ *		containing the junction.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD SetJunctionTarget(LPCTSTR Path, LPCTSTR Target);
+
+/**
+ * Replaces the target of an existing symbolic link in place with a single FSCTL_SET_REPARSE_POINT. Unlike deleting
+ * and recreating the link, the link never disappears and a failure leaves the original target intact.
+ *
+ * On POSIX the new link is created beside the old one and renamed over it.
+ *
+ * @param Path The path of the existing symbolic link to modify.
+ * @param Target The new target of the symbolic link. Relative targets are stored as relative links.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD SetSymlinkTarget(LPCTSTR Path, LPCTSTR Target);
+
+/**
+ * Replaces the target of an existing junction or symbolic link relative to an open directory. See SetJunctionTarget
+ * and SetSymlinkTarget.
+ *
+ * @param Tag The reparse tag of the existing link.
+ * @param Directory The directory containing the link, or NULL to open Name as a full path. If the directory isn't
+ *		open, Name is joined to its path.
+ * @param Name The name of the link within Directory, or its full path if Directory is NULL.
+ * @param Target The new target of the link.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD SetReparseTargetAt(DWORD Tag, const DirectoryHandle* Directory, LPCTSTR Name, LPCTSTR Target);
+
+/**
+ * Creates a junction if Tag is IO_REPARSE_TAG_MOUNT_POINT, otherwise a symbolic link.
+ *
+ * @param Tag The reparse tag of the link to create.
+ * @param Path The path of the link to create.
+ * @param Target The target of the new link.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD CreateReparseLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target);
+
+/**
+ * Deletes a junction if Tag is IO_REPARSE_TAG_MOUNT_POINT, otherwise a symbolic link.
+ *
+ * @param Tag The reparse tag of the link to delete.
+ * @param Path The path of the link to delete.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD DeleteReparseLink(DWORD Tag, LPCTSTR Path);
+
+/**
+ * Deletes a junction or symbolic link relative to an open directory. See DeleteReparseLink.
+ *
+ * @param Tag The reparse tag of the link to delete.
+ * @param Directory The directory containing the link, or NULL to open Name as a full path. If the directory isn't
+ *		open, Name is joined to its path.
+ * @param Name The name of the link within Directory, or its full path if Directory is NULL.
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+DWORD DeleteReparseLinkAt(DWORD Tag, const DirectoryHandle* Directory, LPCTSTR Name);
+
+} // namespace libntfslinks
+
+#endif //REPARSEPOINT_H
@@ -0,0 +1,127 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef REWRITERULES_H
+#define REWRITERULES_H
+#pragma once
+
+#include "PathBuffer.h"
+#include "Platform.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * A set of find and replace rules that are applied to link targets in a single pass.
+ *
+ * The find strings of all rules are compiled into one Aho-Corasick automaton, so each target is scanned exactly once
+ * no matter how many rules there are. Wherever matches overlap the leftmost one wins, and of those starting at the
+ * same position the longest wins. Every non-overlapping match in the target is replaced.
+ *
+ * A rules file contains one rule per line in the form '<find>|<replace>'. Blank lines and lines starting with '#' are
+ * ignored, as is any whitespace around either side of the '|'.
+ *
+ * Once compiled, the rules are read only and may be used from several threads at once.
+ */
+class RewriteRules
+{
+public:
+	RewriteRules();
+
+	/**
+	 * Adds the rules contained in a rules file and compiles them.
+	 *
+	 * @param RulesPath The path of the rules file to read.
+	 * @return Returns zero if the operation was successful, ERROR_BAD_FORMAT if a line of the file is not a valid
+	 *		rule, otherwise a non-zero value if an error occurred.
+	 */
+	DWORD Load(LPCTSTR RulesPath);
+
+	/**
+	 * Adds a single rule. Compile must be called before the rule takes effect.
+	 *
+	 * @param Find The string to search for. Must not be empty.
+	 * @param Replace The string to replace Find with.
+	 */
+	void AddRule(LPCTSTR Find, LPCTSTR Replace);
+
+	/**
+	 * Builds the matcher from the rules added so far.
+	 */
+	void Compile();
+
+	/**
+	 * Applies the rules to the given target.
+	 *
+	 * @param Target The link target to rewrite.
+	 * @param Result The rewritten target. If no rule matched this is a copy of Target. [OUT]
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if the result is too long.
+	 */
+	DWORD Rewrite(LPCTSTR Target, PathBuffer& Result) const;
+
+	/** Returns true if no rules have been added. */
+	bool IsEmpty() const { return Rules.empty(); }
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	struct Rule
+	{
+		String Find;
+		String Replace;
+	};
+
+	/** A state of the automaton. State zero is the root. */
+	struct State
+	{
+		/** The transitions to the next state for each character. */
+		std::map<TCHAR, int> Next;
+		/** The state for the longest proper suffix of this state that is also a prefix of some rule. */
+		int Fail;
+		/** The rule that ends at this state, or -1 if none does. */
+		int Rule;
+		/** The nearest state along the Fail chain that ends a rule, or -1 if there is none. */
+		int Output;
+	};
+
+	/** A match found while scanning a target. */
+	struct Match
+	{
+		size_t Start;
+		int Rule;
+	};
+
+	struct MatchOrder;
+
+	std::vector<Rule> Rules;
+	std::vector<State> States;
+};
+
+#endif //REWRITERULES_H
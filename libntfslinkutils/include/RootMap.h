@@ -0,0 +1,131 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ROOTMAP_H
+#define ROOTMAP_H
+#pragma once
+
+#include "PathBuffer.h"
+#include "Platform.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Maps old root paths to new root paths and rebases link targets from the deepest old root they are beneath.
+ *
+ * The old roots are stored in a trie keyed on path components, so a root only matches whole components of a target
+ * ("C:\Data" matches "C:\Data\x" but not "C:\Database") and a lookup costs one step per component of the target no
+ * matter how many roots there are. On Windows components are compared without regard to case, as NTFS does. The
+ * "\??\" and "\\?\" prefixes of native paths are ignored when matching and kept in the result.
+ *
+ * Targets tend to share a handful of roots, so the most recently matched roots are remembered and tried before the
+ * trie. Only roots without a deeper root beneath them are remembered, since a match against one of those is always
+ * the deepest match.
+ *
+ * Roots must all be added before the map is shared. Rebase and Contains may then be called from several threads at
+ * once.
+ */
+class RootMap
+{
+public:
+	RootMap();
+
+	/**
+	 * Adds a root to rebase from. A root that was already added is replaced.
+	 *
+	 * @param OldRoot The root that targets are rebased from.
+	 * @param NewRoot The root that targets are rebased to.
+	 */
+	void AddRoot(LPCTSTR OldRoot, LPCTSTR NewRoot);
+
+	/**
+	 * Rebases the given target from the deepest old root that it is beneath onto the matching new root.
+	 *
+	 * @param Target The link target to rebase.
+	 * @param Result The rebased target. If no root matched this is a copy of Target. [OUT]
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if the result is too long.
+	 */
+	DWORD Rebase(LPCTSTR Target, PathBuffer& Result) const;
+
+	/**
+	 * Determines if the given target is beneath any of the old roots.
+	 *
+	 * @param Target The link target to look up.
+	 * @param Length The length of the part of Target that the deepest matching old root covers, including any native
+	 *		prefix, or NULL. [OUT]
+	 */
+	bool Contains(LPCTSTR Target, size_t* Length = NULL) const;
+
+	/** Returns true if no roots have been added. */
+	bool IsEmpty() const { return Roots.empty(); }
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	struct Root
+	{
+		/** The old root without its native prefix or trailing separators. */
+		String OldRoot;
+		/** The new root without its native prefix or trailing separators. */
+		String NewRoot;
+		/** The trie node that the old root ends at. */
+		int Node;
+	};
+
+	/** A node of the trie. Node zero is the empty path. */
+	struct Node
+	{
+		/** The child node for each component, folded to lower case on Windows. */
+		std::map<String, int> Children;
+		/** The root that ends at this node, or -1 if none does. */
+		int Root;
+		/** Set when a root ends at a node beneath this one. */
+		bool bHasDeeperRoot;
+	};
+
+	int FindRecent(LPCTSTR Path, size_t& Length) const;
+	int FindRoot(LPCTSTR Path, size_t& Length) const;
+	void AddRecent(int RootIdx) const;
+
+	enum { NumRecent = 4 };
+
+	std::vector<Root> Roots;
+	std::vector<Node> Nodes;
+	/** The most recently matched roots, most recent first, or -1 for an empty slot. */
+	mutable std::atomic<int> Recent[NumRecent];
+
+	// Not copyable
+	RootMap(const RootMap&);
+	RootMap& operator=(const RootMap&);
+};
+
+#endif //ROOTMAP_H
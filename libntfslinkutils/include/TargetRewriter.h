@@ -0,0 +1,99 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TARGETREWRITER_H
+#define TARGETREWRITER_H
+#pragma once
+
+#include "PathBuffer.h"
+#include "Platform.h"
+#include "RewriteRules.h"
+#include "RootMap.h"
+
+#include <string>
+
+/**
+ * How a single old and new pair given on the command line changes a target.
+ */
+enum TargetRewriteMode
+{
+	/** Targets beneath the old root are rebased onto the new root, as cplink and mvlink do. */
+	RewriteRebase,
+	/** The last occurrence of the old string is replaced with the new string, as fixlink does. */
+	RewriteReplaceLast
+};
+
+/**
+ * Rewrites link targets the way the options of a tool ask for, so that every tool applies them in the same order: the
+ * rules if there are any, otherwise the roots, otherwise the single old and new pair. A target that none of them
+ * changes is copied as is.
+ *
+ * Once constructed the rewriter is read only and may be used from several threads at once.
+ */
+class TargetRewriter
+{
+public:
+	/**
+	 * @param Rules The rules to rewrite targets with, or NULL.
+	 * @param Roots The roots to rebase targets from, or NULL.
+	 * @param OldTarget The old root or string of a single pair, or empty if there is none.
+	 * @param NewTarget The new root or string of a single pair.
+	 * @param Mode How the single pair changes a target.
+	 */
+	TargetRewriter(const RewriteRules* Rules, const RootMap* Roots, LPCTSTR OldTarget, LPCTSTR NewTarget,
+		TargetRewriteMode Mode);
+
+	/**
+	 * Rewrites the given target.
+	 *
+	 * @param Target The link target to rewrite.
+	 * @param Result The rewritten target. If nothing matched this is a copy of Target. [OUT]
+	 * @return Returns zero if the operation was successful, otherwise a non-zero value if the result is too long.
+	 */
+	DWORD Rewrite(LPCTSTR Target, PathBuffer& Result) const;
+
+private:
+	DWORD ReplaceLast(LPCTSTR Target, PathBuffer& Result) const;
+
+	typedef std::basic_string<TCHAR> String;
+
+	const RewriteRules* Rules;
+	const RootMap* Roots;
+	/** The map that a single pair is rebased through. */
+	RootMap SingleRoot;
+	/** The strings of a single pair that is replaced rather than rebased. */
+	String Find;
+	String Replace;
+
+	// Not copyable
+	TargetRewriter(const TargetRewriter&);
+	TargetRewriter& operator=(const TargetRewriter&);
+};
+
+#endif //TARGETREWRITER_H
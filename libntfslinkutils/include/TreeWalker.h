@@ -0,0 +1,325 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef TREEWALKER_H
+#define TREEWALKER_H
+#pragma once
+
+#include "ChangeWatcher.h"
+#include "FileSystem.h"
+#include "LinkIndex.h"
+#include "PathBuffer.h"
+#include "PathFilter.h"
+#include "Platform.h"
+#include "RootMap.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * The order in which a TreeWalker enumerates the directories it finds.
+ */
+enum WalkOrder
+{
+	/** Finish each subtree before moving on to its siblings. Only the unvisited siblings along the current path are
+	 *  held in memory, which is the smallest footprint. */
+	WalkDepthFirst,
+	/** Enumerate the tree roughly level by level, visiting shallow links before deep ones. */
+	WalkBreadthFirst
+};
+
+/**
+ * Counters that a TreeWalker keeps up to date while it walks, so that another thread can report how far along it is.
+ */
+struct WalkProgress
+{
+	/** The number of directory entries enumerated so far, including those replayed from an index. */
+	std::atomic<ULONGLONG> NumScanned;
+	/** The level of the directory most recently enumerated. */
+	std::atomic<int> Depth;
+
+	WalkProgress()
+		: NumScanned(0)
+		, Depth(0)
+	{
+	}
+};
+
+/**
+ * Describes a single file object encountered while walking a directory tree.
+ */
+struct WalkEntry
+{
+	/** The full path of the file object. */
+	LPCTSTR Path;
+	/** The path of the file object relative to the root of the walk. This is empty for the root itself. */
+	LPCTSTR RelativePath;
+	/** The file attributes of the file object. */
+	DWORD Attributes;
+	/** The reparse tag of the file object as reported by the directory enumeration. Zero if not known. */
+	DWORD ReparseTag;
+	/** The level of the file object in the tree. The root is at level zero. */
+	int Depth;
+	/** The directory containing the file object if it is held open by the enumeration that found the file object,
+	 *  otherwise NULL. Only valid for the duration of the visit. */
+	const DirectoryHandle* Directory;
+	/** The name of the file object within Directory, or the same as Path if Directory is NULL. Visitors pass both to
+	 *  the *At functions of ReparsePoint.h so that the full path isn't resolved again. */
+	LPCTSTR Name;
+};
+
+/**
+ * Receives the file objects found by a TreeWalker. The walker invokes the visitor from several worker threads at once,
+ * so implementations must be thread safe.
+ */
+class TreeVisitor
+{
+public:
+	virtual ~TreeVisitor() {}
+
+	/**
+	 * Called for each directory in the tree before its contents are enumerated. A directory is always visited before
+	 * any of its children.
+	 *
+	 * @param Entry The directory that was found.
+	 * @return Returns true to enumerate the contents of the directory, otherwise false to skip it.
+	 */
+	virtual bool VisitDirectory(const WalkEntry& Entry) = 0;
+
+	/**
+	 * Called for each reparse point in the tree.
+	 *
+	 * @param Entry The reparse point that was found.
+	 */
+	virtual void VisitLink(const WalkEntry& Entry) = 0;
+
+	/**
+	 * Called when a file object in the tree could not be read.
+	 *
+	 * @param Entry The file object that failed.
+	 * @param ErrorCode The error that occurred.
+	 */
+	virtual void VisitError(const WalkEntry& Entry, DWORD ErrorCode) = 0;
+};
+
+/**
+ * Walks a directory tree with a pool of worker threads, handing every directory and reparse point to a TreeVisitor.
+ *
+ * The walk never recurses. Each worker owns a heap allocated queue of directories waiting to be enumerated, so any depth
+ * of tree can be walked without growing the stack. New subdirectories are pushed onto the queue of the worker that found
+ * them, a batch at a time as the enumeration hands entries over. In depth-first order they are taken back newest
+ * first, keeping each worker on a depth-first path through its part of the tree. In breadth-first order they are taken
+ * oldest first. A worker whose queue runs dry steals the oldest directory from another worker, which is usually the
+ * root of a large untouched subtree.
+ *
+ * A breadth-first walk holds an entire level of the tree in its queues, which can be very large. Once MaxQueuedTasks
+ * directories are waiting, workers take the newest directory instead until the queues shrink again. This drains the
+ * deepest part of the frontier first and keeps memory bounded on wide trees.
+ *
+ * Paths are not limited to MAX_PATH. Each queued directory carries its full path in the same allocation as the task
+ * itself, sized to fit, and each worker builds the paths of the entries it enumerates in a single reusable buffer.
+ *
+ * Each directory is opened once, when it is enumerated, and stays open while its entries are visited. The visitor is
+ * handed the open directory along with the name of each entry, so reading, retargeting or deleting a link works
+ * relative to it instead of resolving every component of the full path again. Only the roots are canonicalized into
+ * full paths.
+ *
+ * When given a PathFilter, directories it excludes are pruned before they are queued, so they are never enumerated,
+ * and links that don't pass its path patterns are not handed to the visitor.
+ *
+ * When given a LinkIndex, directories that have not changed since the index was written are replayed from the index
+ * rather than enumerated, and every directory that is enumerated is recorded in it.
+ *
+ * Several roots may be walked at once. They are all queued before the workers start, so one pool walks every root in
+ * parallel and a small root never waits for a large one. Roots are expanded to full paths first, duplicates are
+ * dropped and a root beneath another directory root is dropped as well, since walking the outer root already visits
+ * everything beneath it. A root that can't be read is reported to the visitor and the other roots are still walked.
+ *
+ * When given a ChangeWatcher, every directory is watched just before it is enumerated. The paths the watcher reports
+ * can then be passed to WalkChanges, which visits them as the full walk would have and walks only the directories
+ * among them, so that keeping a tree in sync costs in proportion to what changed rather than to the size of the tree.
+ */
+class TreeWalker
+{
+public:
+	/**
+	 * @param Visitor The visitor to pass all file objects to.
+	 * @param NumWorkers The number of worker threads to enumerate directories with. Zero uses one per processor.
+	 * @param MaxDepth The maximum depth of the tree to traverse, or a negative value to traverse the entire tree.
+	 * @param Index The index to replay unchanged directories from and record enumerated directories to, or NULL.
+	 * @param Order The order in which to enumerate directories.
+	 */
+	TreeWalker(TreeVisitor& Visitor, int NumWorkers = 0, int MaxDepth = -1, LinkIndex* Index = NULL,
+		WalkOrder Order = WalkDepthFirst);
+	~TreeWalker();
+
+	/**
+	 * Walks the tree at the specified root, returning once every file object has been visited.
+	 *
+	 * @param Root The path of the directory or reparse point to walk.
+	 * @return Returns zero if the root could be read, otherwise a non-zero value on failure. Failures below the root
+	 *		are reported to the visitor only.
+	 */
+	DWORD Walk(LPCTSTR Root);
+
+	/**
+	 * Walks the trees at each of the specified roots with a single pool of workers, returning once every file object
+	 * beneath all of them has been visited. Nested roots are collapsed into the outermost one, so the depth of an entry
+	 * is counted from the outermost root that contains it.
+	 *
+	 * @param Roots The paths of the directories or reparse points to walk.
+	 * @return Returns zero if every root could be read, otherwise the error of the first root that failed. Failures
+	 *		below the roots are reported to the visitor only.
+	 */
+	DWORD Walk(const std::vector<LPCTSTR>& Roots);
+
+	/**
+	 * Visits the given entries of the trees already walked, as a walk of their roots would have, then walks the
+	 * directories among them. Depths and relative paths are counted from the root each entry is beneath, and entries
+	 * that the filter or maximum depth would have kept the walk from reaching are skipped, as are entries that are not
+	 * beneath any root or no longer exist.
+	 *
+	 * @param Paths The full paths of the entries that were created or changed, as reported by a ChangeWatcher.
+	 */
+	void WalkChanges(const std::vector<std::basic_string<TCHAR> >& Paths);
+
+	/**
+	 * Sets the counters to update while walking, or NULL to not report progress.
+	 */
+	void SetProgress(WalkProgress* Progress) { this->Progress = Progress; }
+
+	/**
+	 * Sets the filter that decides which directories are walked and which links are visited, or NULL to walk
+	 * everything.
+	 */
+	void SetFilter(const PathFilter* Filter) { this->Filter = Filter; }
+
+	/**
+	 * Sets the watcher to watch each enumerated directory with, or NULL to not watch for changes.
+	 */
+	void SetWatcher(ChangeWatcher* Watcher) { this->Watcher = Watcher; }
+
+	/**
+	 * Returns the number of worker threads to start for the given requested number, which is one per processor when
+	 * NumWorkers is zero or less.
+	 */
+	static int GetNumWorkers(int NumWorkers);
+
+	/** The number of waiting directories beyond which a breadth-first walk takes the newest directory first. */
+	enum { MaxQueuedTasks = 64 * 1024 };
+
+private:
+	/** A directory waiting to be enumerated. Allocated with NewTask so that Path holds the entire path. */
+	struct WalkTask
+	{
+		int Depth;
+		/** The length of the full path of the root that the directory is beneath. */
+		size_t RootLength;
+		size_t PathLength;
+		TCHAR Path[1];
+	};
+
+	/** The pending directories of a single worker. */
+	struct WorkQueue
+	{
+		std::mutex Lock;
+		std::deque<WalkTask*> Tasks;
+	};
+
+	/** The most subdirectories of a batch that are held back before being pushed together. */
+	enum { PushBatchSize = 64 };
+
+	/** Context passed through EnumerateDirectory to EnumerateEntries. */
+	struct EnumerateContext
+	{
+		TreeWalker* Walker;
+		size_t WorkerIdx;
+		const WalkTask* Parent;
+		/** The directory being enumerated, as handed over with the current batch. */
+		const DirectoryHandle* Directory;
+		/** The worker's buffer for building the path of each entry, holding the parent path between entries. */
+		PathBuffer* EntryPath;
+		/** The links and subdirectories found so far, or NULL if the directory isn't being recorded. */
+		std::vector<LinkIndex::Entry>* Found;
+		/** The number of entries enumerated so far. */
+		ULONGLONG NumEntries;
+		/** The subdirectories of the current batch, waiting to be pushed. */
+		WalkTask* Subdirectories[PushBatchSize];
+		size_t NumSubdirectories;
+	};
+
+	void Run();
+	void WorkerMain(size_t WorkerIdx);
+	void Push(size_t WorkerIdx, WalkTask* Task);
+	void Push(size_t WorkerIdx, WalkTask* const* Tasks, size_t NumTasks);
+	WalkTask* Pop(size_t WorkerIdx);
+	void Enumerate(size_t WorkerIdx, const WalkTask* Task, PathBuffer& EntryPath);
+	static void EnumerateEntries(void* Context, const DirectoryHandle& Directory, const DirectoryEntry* Entries,
+		size_t NumEntries);
+	static void EnumerateEntry(EnumerateContext* Context, const DirectoryEntry& Entry);
+	static void PushSubdirectories(EnumerateContext* Context);
+	DWORD AddRoot(LPCTSTR Root, size_t& NextWorker);
+	bool IsReachable(LPCTSTR RelativePath, int Depth) const;
+	static WalkTask* NewTask(LPCTSTR Path, size_t PathLength, int Depth, size_t RootLength);
+	static void DeleteTask(WalkTask* Task);
+	static WalkEntry MakeEntry(LPCTSTR Path, DWORD Attributes, int Depth, size_t RootLength);
+
+	/** Returns true if the contents of a directory at the given depth should be enumerated. */
+	bool CanDescend(int Depth) const { return MaxDepth < 0 || Depth < MaxDepth; }
+
+	TreeVisitor& Visitor;
+	int MaxDepth;
+	WalkOrder Order;
+	LinkIndex* Index;
+	WalkProgress* Progress;
+	const PathFilter* Filter;
+	ChangeWatcher* Watcher;
+	/** The directory roots walked so far. */
+	RootMap Walked;
+
+	std::vector<WorkQueue*> Queues;
+	/** The number of tasks that are queued or being enumerated. The walk is complete once this reaches zero. */
+	std::atomic<long> NumPending;
+	/** The number of tasks sitting in a queue. */
+	std::atomic<long> NumQueued;
+	/** The number of workers waiting for a task. */
+	std::atomic<long> NumIdle;
+	std::mutex IdleLock;
+	std::condition_variable IdleSignal;
+
+	// Not copyable
+	TreeWalker(const TreeWalker&);
+	TreeWalker& operator=(const TreeWalker&);
+};
+
+#endif //TREEWALKER_H
@@ -0,0 +1,256 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ActionPlan.h"
+
+#include "Json.h"
+#include "PathBuffer.h"
+#include "ReparsePoint.h"
+
+namespace
+{
+
+typedef std::basic_string<TCHAR> String;
+
+/** The name of each operation, indexed by PlanOperation. */
+LPCTSTR OperationNames[] = { TEXT("mkdir"), TEXT("copy"), TEXT("move"), TEXT("fix"), TEXT("remove") };
+
+/**
+ * Parses a single record of a plan.
+ */
+bool ParseRecord(LPCTSTR Text, PlanAction& Action)
+{
+	String name;
+	String value;
+	String operation;
+	String type;
+
+	SkipJsonSpace(Text);
+	if (*Text++ != '{')
+	{
+		return false;
+	}
+
+	SkipJsonSpace(Text);
+	while (*Text != '}')
+	{
+		SkipJsonSpace(Text);
+		if (!ReadJsonString(Text, name))
+		{
+			return false;
+		}
+
+		SkipJsonSpace(Text);
+		if (*Text++ != ':')
+		{
+			return false;
+		}
+
+		SkipJsonSpace(Text);
+		if (!ReadJsonString(Text, value))
+		{
+			return false;
+		}
+
+		if (name == TEXT("op"))
+		{
+			operation = value;
+		}
+		else if (name == TEXT("type"))
+		{
+			type = value;
+		}
+		else if (name == TEXT("src"))
+		{
+			Action.Src = value;
+		}
+		else if (name == TEXT("dest"))
+		{
+			Action.Dest = value;
+		}
+		else if (name == TEXT("old"))
+		{
+			Action.OldTarget = value;
+		}
+		else if (name == TEXT("new"))
+		{
+			Action.NewTarget = value;
+		}
+
+		SkipJsonSpace(Text);
+		if (*Text == ',')
+		{
+			Text++;
+		}
+		else if (*Text != '}')
+		{
+			return false;
+		}
+	}
+
+	int op = -1;
+	for (int i = 0; i < (int)ARRAYSIZE(OperationNames); i++)
+	{
+		if (operation == OperationNames[i])
+		{
+			op = i;
+		}
+	}
+
+	Action.Operation = (PlanOperation)op;
+	Action.Tag = 0;
+	if (type == TEXT("junction"))
+	{
+		Action.Tag = IO_REPARSE_TAG_MOUNT_POINT;
+	}
+	else if (type == TEXT("symlink"))
+	{
+		Action.Tag = IO_REPARSE_TAG_SYMLINK;
+	}
+
+	// Every operation needs a source, and every operation on a link needs to know what kind of link it is
+	return op >= 0 && !Action.Src.empty() && (op == PlanCreateDirectory || Action.Tag != 0);
+}
+
+} // namespace
+
+ActionPlan::ActionPlan()
+	: File(NULL)
+	, WriteError(0)
+{
+}
+
+ActionPlan::~ActionPlan()
+{
+	if (File != NULL)
+	{
+		fclose(File);
+	}
+}
+
+DWORD ActionPlan::Create(LPCTSTR PlanPath)
+{
+#ifdef UNICODE
+	File = _tfopen(PlanPath, TEXT("wt, ccs=UTF-8"));
+#else
+	File = _tfopen(PlanPath, TEXT("wt"));
+#endif
+	if (File == NULL)
+	{
+		return GetLastError();
+	}
+
+	// Records are written in large blocks
+	setvbuf(File, NULL, _IOFBF, 256 * 1024);
+	WriteError = 0;
+	return 0;
+}
+
+void ActionPlan::Add(PlanOperation Operation, DWORD Tag, LPCTSTR Src, LPCTSTR Dest, LPCTSTR OldTarget,
+	LPCTSTR NewTarget)
+{
+	// Format the record before taking the lock
+	String record;
+	AppendJsonMember(record, TEXT("op"), OperationNames[Operation]);
+	if (Tag == IO_REPARSE_TAG_MOUNT_POINT)
+	{
+		AppendJsonMember(record, TEXT("type"), TEXT("junction"));
+	}
+	else if (Tag != 0)
+	{
+		AppendJsonMember(record, TEXT("type"), TEXT("symlink"));
+	}
+	AppendJsonMember(record, TEXT("src"), Src);
+	AppendJsonMember(record, TEXT("dest"), Dest);
+	AppendJsonMember(record, TEXT("old"), OldTarget);
+	AppendJsonMember(record, TEXT("new"), NewTarget);
+	record.append(TEXT("}\n"));
+
+	std::lock_guard<std::mutex> lock(Lock);
+	if (File != NULL && _fputts(record.c_str(), File) < 0 && WriteError == 0)
+	{
+		WriteError = GetLastError();
+	}
+}
+
+DWORD ActionPlan::Close()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	if (File == NULL)
+	{
+		return 0;
+	}
+
+	if (fclose(File) != 0 && WriteError == 0)
+	{
+		WriteError = GetLastError();
+	}
+	File = NULL;
+
+	return WriteError;
+}
+
+DWORD ActionPlan::Load(LPCTSTR PlanPath, std::vector<PlanAction>& Actions)
+{
+#ifdef UNICODE
+	FILE* file = _tfopen(PlanPath, TEXT("rt, ccs=UTF-8"));
+#else
+	FILE* file = _tfopen(PlanPath, TEXT("rt"));
+#endif
+	if (file == NULL)
+	{
+		return GetLastError();
+	}
+
+	DWORD result = 0;
+	// Room for four escaped paths of the longest length plus the member names
+	std::vector<TCHAR> Line(MAX_LONG_PATH * 8 + 256);
+	while (result == 0 && _fgetts(&Line[0], (int)Line.size(), file) != NULL)
+	{
+		LPCTSTR record = &Line[0];
+		SkipJsonSpace(record);
+		if (*record == 0)
+		{
+			continue;
+		}
+
+		PlanAction action;
+		if (!ParseRecord(record, action))
+		{
+			result = ERROR_BAD_FORMAT;
+			break;
+		}
+
+		Actions.push_back(action);
+	}
+
+	fclose(file);
+
+	return result;
+}
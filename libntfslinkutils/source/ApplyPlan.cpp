@@ -0,0 +1,367 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ApplyPlan.h"
+
+#include "FileSystem.h"
+#include "Log.h"
+#include "NtfsLinks.h"
+#include "ReparsePoint.h"
+#include "TreeWalker.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace libntfslinks;
+
+namespace
+{
+
+/** The number of operations each worker takes at a time. */
+enum { BatchSize = 64 };
+
+/**
+ * Orders operations by the depth of their destination, keeping the plan order within each depth.
+ */
+struct DepthOrder
+{
+	bool operator()(const std::pair<size_t, size_t>& A, const std::pair<size_t, size_t>& B) const
+	{
+		return A.first < B.first || (A.first == B.first && A.second < B.second);
+	}
+};
+
+/**
+ * Returns the number of separators in a path, which orders a directory after every directory above it.
+ */
+size_t GetPathDepth(const PlanAction::String& Path)
+{
+	return std::count(Path.begin(), Path.end(), PATH_SEPARATOR);
+}
+
+/**
+ * Applies the operations of a plan with a pool of workers, one step at a time.
+ */
+class PlanApplier
+{
+public:
+	PlanApplier(const std::vector<PlanAction>& Actions, const applyplanOptions& Options, applyplanStats& Stats)
+		: Actions(Actions)
+		, Options(Options)
+		, Stats(Stats)
+		, Created(Actions.size(), 0)
+		, NextIdx(0)
+	{
+	}
+
+	void Run()
+	{
+		// Directories are created a level at a time so that every parent exists before its children
+		std::vector<std::pair<size_t, size_t> > directories;
+		std::vector<size_t> links;
+		for (size_t i = 0; i < Actions.size(); i++)
+		{
+			if (Actions[i].Operation == PlanCreateDirectory)
+			{
+				directories.push_back(std::make_pair(GetPathDepth(Actions[i].Dest), i));
+			}
+			else
+			{
+				links.push_back(i);
+			}
+		}
+
+		std::sort(directories.begin(), directories.end(), DepthOrder());
+		std::vector<size_t> level;
+		for (size_t i = 0; i < directories.size(); i++)
+		{
+			level.push_back(directories[i].second);
+			if (i + 1 == directories.size() || directories[i + 1].first != directories[i].first)
+			{
+				RunStep(&PlanApplier::CreateDestDirectory, level);
+				level.clear();
+			}
+		}
+
+		RunStep(&PlanApplier::ApplyLink, links);
+
+		// Moved links are only deleted once every destination exists
+		std::vector<size_t> moved;
+		for (size_t i = 0; i < Actions.size(); i++)
+		{
+			if (Actions[i].Operation == PlanMove && Created[i] != 0)
+			{
+				moved.push_back(i);
+			}
+		}
+
+		RunStep(&PlanApplier::DeleteSource, moved);
+	}
+
+private:
+	typedef void (PlanApplier::*Step)(size_t ActionIdx);
+
+	/**
+	 * Applies a step to each of the given operations using every worker, returning once all of them are done.
+	 */
+	void RunStep(Step ApplyStep, const std::vector<size_t>& Indices)
+	{
+		if (Indices.empty())
+		{
+			return;
+		}
+
+		NextIdx = 0;
+
+		std::vector<std::thread*> threads;
+		size_t numWorkers = std::min((size_t)TreeWalker::GetNumWorkers(Options.NumThreads),
+			(Indices.size() + BatchSize - 1) / BatchSize);
+		for (size_t i = 1; i < numWorkers; i++)
+		{
+			threads.push_back(new std::thread(&PlanApplier::WorkerMain, this, ApplyStep, &Indices));
+		}
+
+		// The calling thread acts as the first worker
+		WorkerMain(ApplyStep, &Indices);
+
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+	}
+
+	void WorkerMain(Step ApplyStep, const std::vector<size_t>* Indices)
+	{
+		for (;;)
+		{
+			size_t begin = NextIdx.fetch_add(BatchSize);
+			if (begin >= Indices->size())
+			{
+				break;
+			}
+
+			size_t end = std::min(begin + BatchSize, Indices->size());
+			for (size_t i = begin; i < end; i++)
+			{
+				(this->*ApplyStep)((*Indices)[i]);
+			}
+		}
+	}
+
+	void CreateDestDirectory(size_t ActionIdx)
+	{
+		const PlanAction& action = Actions[ActionIdx];
+
+		// The directory may have been created since the plan was made
+		DWORD attributes = 0;
+		if (GetPathAttributes(action.Dest.c_str(), attributes) == 0)
+		{
+			return;
+		}
+
+		DWORD result = CreateDirectoryFrom(action.Src.c_str(), action.Dest.c_str());
+		if (result != 0)
+		{
+			// Every link beneath the directory will fail and be reported as well
+			Stats.NumFailed++;
+			PrintErrorMessage(result, action.Dest.c_str());
+		}
+	}
+
+	void ApplyLink(size_t ActionIdx)
+	{
+		const PlanAction& action = Actions[ActionIdx];
+		DWORD result = 0;
+
+		if (action.Operation == PlanCopy || action.Operation == PlanMove)
+		{
+			result = CreateLink(action);
+			if (result == 0 && action.Operation == PlanMove)
+			{
+				// Counted once the source is deleted
+				Created[ActionIdx] = 1;
+			}
+			else if (result == 0)
+			{
+				Stats.NumApplied++;
+			}
+		}
+		else if (action.Operation == PlanFix)
+		{
+			// Leave the link alone if something else changed it after the plan was made
+			ReparsePointInfo Info;
+			result = GetReparsePointInfo(action.Src.c_str(), Info);
+			if (result == 0 && action.OldTarget != Info.Target.Get())
+			{
+				LogMessage(TEXT("Target of %s changed since the plan was made: %s\n"), action.Src.c_str(),
+					Info.Target.Get());
+				Stats.NumSkipped++;
+				return;
+			}
+
+			if (result == 0)
+			{
+				result = SetLinkTarget(action);
+			}
+
+			if (result == 0)
+			{
+				Stats.NumApplied++;
+			}
+		}
+		else if (action.Operation == PlanRemove)
+		{
+			result = DeleteReparseLink(action.Tag, action.Src.c_str());
+			if (result == 0)
+			{
+				Stats.NumApplied++;
+			}
+		}
+
+		// Was the operation successful?
+		if (result != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, action.Src.c_str());
+		}
+	}
+
+	void DeleteSource(size_t ActionIdx)
+	{
+		const PlanAction& action = Actions[ActionIdx];
+
+		DWORD result = DeleteReparseLink(action.Tag, action.Src.c_str());
+		if (result == 0)
+		{
+			Stats.NumApplied++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, action.Src.c_str());
+		}
+	}
+
+	/**
+	 * Creates the destination link of a copy or move, replacing any link already there.
+	 */
+	DWORD CreateLink(const PlanAction& Action)
+	{
+		DWORD result = 0;
+		LPCTSTR DestPath = Action.Dest.c_str();
+		LPCTSTR Target = Action.NewTarget.c_str();
+
+		// Delete the existing reparse point destination
+		ReparsePointInfo DestInfo;
+		if (GetReparsePointInfo(DestPath, DestInfo) == 0 && IsLinkTag(DestInfo.Tag))
+		{
+			result = DeleteReparseLink(DestInfo.Tag, DestPath);
+		}
+
+		// Create the junction or symlink at the destination
+		if (result == 0)
+		{
+			result = CreateReparseLink(Action.Tag, DestPath, Target);
+			if (result == 0 && Options.bVerbose)
+			{
+				LogMessage(TEXT("%s created for %s <<===>> %s\n"), GetLinkTypeName(Action.Tag), DestPath, Target);
+			}
+		}
+
+		return result;
+	}
+
+	/**
+	 * Replaces the target of a link in place.
+	 */
+	DWORD SetLinkTarget(const PlanAction& Action)
+	{
+		LPCTSTR Path = Action.Src.c_str();
+
+		DWORD result = Action.Tag == IO_REPARSE_TAG_MOUNT_POINT ? SetJunctionTarget(Path, Action.NewTarget.c_str()) :
+			SetSymlinkTarget(Path, Action.NewTarget.c_str());
+		if (result == 0 && Options.bVerbose)
+		{
+			LogMessage(TEXT("%s %s target modified. old=%s, new=%s\n"), GetLinkTypeName(Action.Tag), Path,
+				Action.OldTarget.c_str(), Action.NewTarget.c_str());
+		}
+
+		return result;
+	}
+
+	const std::vector<PlanAction>& Actions;
+	const applyplanOptions& Options;
+	applyplanStats& Stats;
+	/** Set for each move whose destination link was created, so that its source is deleted. */
+	std::vector<char> Created;
+	/** The position within the current step of the next batch for a worker to take. */
+	std::atomic<size_t> NextIdx;
+
+	// Not copyable
+	PlanApplier(const PlanApplier&);
+	PlanApplier& operator=(const PlanApplier&);
+};
+
+} // namespace
+
+DWORD applyplan(LPCTSTR PlanPath, PlanOperation Operation, const applyplanOptions& Options, applyplanStats& Stats)
+{
+	std::vector<PlanAction> actions;
+	DWORD result = ActionPlan::Load(PlanPath, actions);
+	if (result == ERROR_BAD_FORMAT)
+	{
+		Stats.NumFailed++;
+		LogMessage(TEXT("The plan %s is not valid.\n"), PlanPath);
+		return result;
+	}
+	else if (result != 0)
+	{
+		Stats.NumFailed++;
+		PrintErrorMessage(result, PlanPath);
+		return result;
+	}
+
+	// Refuse a plan made by another tool rather than perform operations the user didn't ask for
+	for (size_t i = 0; i < actions.size(); i++)
+	{
+		if (actions[i].Operation != Operation && actions[i].Operation != PlanCreateDirectory)
+		{
+			Stats.NumFailed++;
+			LogMessage(TEXT("The plan %s was made by a different tool.\n"), PlanPath);
+			return ERROR_BAD_FORMAT;
+		}
+	}
+
+	PlanApplier applier(actions, Options, Stats);
+	applier.Run();
+
+	return 0;
+}
@@ -0,0 +1,548 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CopyLink.h"
+
+#include "BoundedQueue.h"
+#include "FileSystem.h"
+#include "Log.h"
+#include "NtfsLinks.h"
+#include "ReparsePoint.h"
+#include "TargetRewriter.h"
+#include "TreeWalker.h"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace libntfslinks;
+
+namespace
+{
+
+/**
+ * A link making its way through the copy pipeline.
+ */
+struct CopyTask
+{
+	/** The path of the source link. */
+	PathBuffer SrcPath;
+	/** The path of the link to create. */
+	PathBuffer DestPath;
+	/** The length of the path of the link relative to the roots, which both SrcPath and DestPath end with. */
+	size_t RelativeLength;
+	/** The reparse tag of the source link, or zero until it is known. */
+	DWORD Tag;
+	/** The target to give the new link. */
+	PathBuffer Target;
+};
+
+/** The number of links each queue of the pipeline holds before the stage feeding it waits. */
+enum { QueueCapacity = 4096 };
+
+/**
+ * The destination directories known to exist, or planned, shared by every stage of the pipeline. The paths are split
+ * across shards with a lock each, so that workers creating links in different directories rarely wait on each other.
+ */
+class DirectoryCache
+{
+public:
+	typedef std::basic_string<TCHAR> String;
+
+	/** Returns true if the directory is known to exist. */
+	bool Contains(const String& Path)
+	{
+		Shard& shard = GetShard(Path);
+		std::lock_guard<std::mutex> lock(shard.Lock);
+		return shard.Paths.find(Path) != shard.Paths.end();
+	}
+
+	/**
+	 * Remembers that the directory exists.
+	 *
+	 * @return Returns true if the directory was not known before.
+	 */
+	bool Add(const String& Path)
+	{
+		Shard& shard = GetShard(Path);
+		std::lock_guard<std::mutex> lock(shard.Lock);
+		return shard.Paths.insert(Path).second;
+	}
+
+private:
+	/** A prime number of shards keeps the choice of shard independent of the bits that each set buckets on. */
+	enum { NumShards = 31 };
+
+	struct Shard
+	{
+		std::mutex Lock;
+		std::unordered_set<String> Paths;
+	};
+
+	Shard& GetShard(const String& Path)
+	{
+		return Shards[std::hash<String>()(Path) % NumShards];
+	}
+
+	Shard Shards[NumShards];
+};
+
+/**
+ * Copies each reparse point found in the source tree to the same relative location in the destination tree.
+ *
+ * The tree walker only enumerates the source and queues each link it finds. The readers take links from that queue,
+ * read and rewrite their targets and queue them again for the creators, which replace any existing link at the
+ * destination.
+ */
+class CopyLinkPipeline : public TreeVisitor
+{
+public:
+	CopyLinkPipeline(LPCTSTR SrcRoot, LPCTSTR DestRoot, const cplinkOptions& Options, cplinkStats& Stats)
+		: SrcRoot(SrcRoot)
+		, DestRoot(DestRoot)
+		, Options(Options)
+		, Stats(Stats)
+		, Rewriter(Options.Rules, Options.Roots, Options.OldTargetBase, Options.NewTargetBase, RewriteRebase)
+		, ReadQueue(QueueCapacity)
+		, CreateQueue(QueueCapacity)
+	{
+	}
+
+	/**
+	 * Walks the source tree, and any changes to it while watching, and waits for every link found to pass through the
+	 * remaining stages.
+	 */
+	DWORD Run(LPCTSTR Src)
+	{
+		std::vector<std::thread*> readers;
+		for (int i = TreeWalker::GetNumWorkers(Options.NumReadThreads); i > 0; i--)
+		{
+			readers.push_back(new std::thread(&CopyLinkPipeline::ReadMain, this));
+		}
+
+		std::vector<std::thread*> creators;
+		for (int i = TreeWalker::GetNumWorkers(Options.NumCreateThreads); i > 0; i--)
+		{
+			creators.push_back(new std::thread(&CopyLinkPipeline::CreateMain, this));
+		}
+
+		TreeWalker walker(*this, Options.NumThreads, Options.MaxDepth, NULL, Options.Order);
+		walker.SetProgress(Options.Progress);
+		walker.SetFilter(Options.Filter);
+		walker.SetWatcher(Options.Watcher);
+		DWORD result = walker.Walk(Src);
+
+		// Keep copying the links and directories that are created or changed until the watch is stopped
+		if (Options.Watcher != NULL)
+		{
+			LogMessage(TEXT("Watching for changes...\n"));
+
+			std::vector<std::basic_string<TCHAR> > changes;
+			while (Options.Watcher->WaitForChanges(changes) == 0)
+			{
+				walker.WalkChanges(changes);
+			}
+		}
+
+		// Each stage finishes once the stage before it has and its queue is drained
+		ReadQueue.Close();
+		for (size_t i = 0; i < readers.size(); i++)
+		{
+			readers[i]->join();
+			delete readers[i];
+		}
+
+		CreateQueue.Close();
+		for (size_t i = 0; i < creators.size(); i++)
+		{
+			creators[i]->join();
+			delete creators[i];
+		}
+
+		return result;
+	}
+
+	virtual bool VisitDirectory(const WalkEntry& Entry)
+	{
+		// Lazy directories are only made by the later stages, above the links that are actually copied
+		if (Options.bLazyDirectories)
+		{
+			return true;
+		}
+
+		PathBuffer DestPath;
+		DWORD result = GetDestPath(Entry, DestPath);
+		if (result != 0)
+		{
+			VisitError(Entry, result);
+			return false;
+		}
+
+		// Make sure the the destination directory exists. If not create it, or plan to.
+		DWORD destAttributes = 0;
+		if (GetPathAttributes(DestPath.Get(), destAttributes) != 0)
+		{
+			if (Options.Plan != NULL)
+			{
+				Options.Plan->Add(PlanCreateDirectory, 0, Entry.Path, DestPath.Get(), NULL, NULL);
+			}
+			else if (CreateDirectoryFrom(Entry.Path, DestPath.Get()) != 0)
+			{
+				// Failed to create the destination directory. Every link beneath it will fail and be reported.
+			}
+		}
+
+		return true;
+	}
+
+	virtual void VisitLink(const WalkEntry& Entry)
+	{
+		CopyTask* task = new CopyTask();
+		task->RelativeLength = _tcslen(Entry.RelativePath);
+		task->Tag = Entry.ReparseTag;
+
+		DWORD result = task->SrcPath.Assign(Entry.Path);
+		if (result == 0)
+		{
+			result = GetDestPath(Entry, task->DestPath);
+		}
+
+		if (result != 0)
+		{
+			delete task;
+			VisitError(Entry, result);
+			return;
+		}
+
+		ReadQueue.Push(task);
+	}
+
+	virtual void VisitError(const WalkEntry& Entry, DWORD ErrorCode)
+	{
+		// If we failed to be able to read the directory listing due to a access violation count it as a skip
+		// instead of a complete failure.
+		if (ErrorCode == ERROR_ACCESS_DENIED && (Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			PrintErrorMessage(ErrorCode, Entry.Path);
+			Stats.NumSkipped++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(ErrorCode, Entry.Path);
+		}
+	}
+
+private:
+	/**
+	 * Runs a worker of the read stage until the read queue is closed and drained.
+	 */
+	void ReadMain()
+	{
+		CopyTask* task = NULL;
+		while (ReadQueue.Pop(task))
+		{
+			if (ReadLink(*task))
+			{
+				CreateQueue.Push(task);
+			}
+			else
+			{
+				delete task;
+			}
+		}
+	}
+
+	/**
+	 * Runs a worker of the create stage until the create queue is closed and drained.
+	 */
+	void CreateMain()
+	{
+		CopyTask* task = NULL;
+		while (CreateQueue.Pop(task))
+		{
+			CreateLink(*task);
+			delete task;
+		}
+	}
+
+	/**
+	 * Reads the target of the source link and rewrites it.
+	 *
+	 * @return Returns true if the link should be created, otherwise false if it was skipped, failed or only recorded
+	 *		in the plan.
+	 */
+	bool ReadLink(CopyTask& Task)
+	{
+		DWORD result = 0;
+
+		// Read the target of the source with a single open. Reparse points that the enumeration already reported as
+		// something other than a link are skipped without being opened.
+		ReparsePointInfo SrcInfo;
+		SrcInfo.Tag = Task.Tag;
+		if (SrcInfo.Tag == 0 || IsLinkTag(SrcInfo.Tag))
+		{
+			result = GetReparsePointInfo(Task.SrcPath.Get(), SrcInfo);
+		}
+
+		if (result == 0 && !IsLinkTag(SrcInfo.Tag))
+		{
+			LogMessage(TEXT("Unrecognized reparse point: %s\n"), Task.SrcPath.Get());
+			Stats.NumSkipped++;
+			return false;
+		}
+
+		// Links whose target is filtered out are not copied
+		if (result == 0 && Options.Filter != NULL && !Options.Filter->MatchesLinkTarget(SrcInfo.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return false;
+		}
+
+		// If specified, rewrite the target with the rules or rebase it to the new root
+		if (result == 0)
+		{
+			Task.Tag = SrcInfo.Tag;
+			result = Rewriter.Rewrite(SrcInfo.Target.Get(), Task.Target);
+		}
+
+		// Was there a failure reading the source or was the rewritten target too long?
+		if (result != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, Task.SrcPath.Get());
+			return false;
+		}
+
+		// A dry run only records what would be done
+		if (Options.Plan != NULL)
+		{
+			if (Options.bLazyDirectories)
+			{
+				CreateDestDirectories(Task);
+			}
+			Options.Plan->Add(PlanCopy, Task.Tag, Task.SrcPath.Get(), Task.DestPath.Get(), SrcInfo.Target.Get(),
+				Task.Target.Get());
+			Stats.NumCopied++;
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Replaces any existing link at the destination with a link to the rewritten target.
+	 */
+	void CreateLink(const CopyTask& Task)
+	{
+		DWORD result = 0;
+		LPCTSTR DestPath = Task.DestPath.Get();
+		LPCTSTR Target = Task.Target.Get();
+
+		// Make the directories above the link first if they were left to the creators
+		if (Options.bLazyDirectories)
+		{
+			result = CreateDestDirectories(Task);
+		}
+
+		// Check if the destination already exists
+		ReparsePointInfo DestInfo;
+		if (result == 0 && GetReparsePointInfo(DestPath, DestInfo) == 0)
+		{
+			// An existing link at the destination is always replaced, without asking
+			if (IsLinkTag(DestInfo.Tag))
+			{
+				result = DeleteReparseLink(DestInfo.Tag, DestPath);
+			}
+		}
+
+		// Was there a failure deleting the existing destination?
+		if (result == 0)
+		{
+			// Create the junction or symlink at the destination
+			result = CreateReparseLink(Task.Tag, DestPath, Target);
+			if (result == 0 && Options.bVerbose)
+			{
+				LogMessage(TEXT("%s created for %s <<===>> %s\n"), GetLinkTypeName(Task.Tag), DestPath, Target);
+			}
+		}
+
+		// Was the operation successful?
+		if (result == 0)
+		{
+			Stats.NumCopied++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, Task.SrcPath.Get());
+		}
+	}
+
+	/**
+	 * Creates the destination directories above a link that don't exist yet, shallowest first, or plans to during a
+	 * dry run. Each takes its attributes from the matching source directory. Directories are looked up in the cache
+	 * from the parent of the link upwards, so the file system is only queried for directories not seen before.
+	 *
+	 * @return Returns zero if every directory above the link exists, otherwise the error of the first one that could
+	 *		not be created.
+	 */
+	DWORD CreateDestDirectories(const CopyTask& Task)
+	{
+		typedef DirectoryCache::String String;
+
+		// The link is the root itself, which has nothing above it to create
+		size_t relativeLength = Task.RelativeLength;
+		if (relativeLength == 0)
+		{
+			return 0;
+		}
+
+		// Each directory above the link is named by the length of its relative path, zero being the root
+		LPCTSTR destPath = Task.DestPath.Get();
+		LPCTSTR srcPath = Task.SrcPath.Get();
+		size_t destBase = Task.DestPath.Length() - relativeLength;
+		size_t srcBase = Task.SrcPath.Length() - relativeLength;
+		LPCTSTR relativePath = destPath + destBase;
+
+		std::vector<size_t> missing;
+		size_t level = relativeLength;
+		do
+		{
+			// Step up to the parent, dropping the separator in front of the last name
+			while (level > 0 && relativePath[level - 1] != PATH_SEPARATOR)
+			{
+				level--;
+			}
+			if (level > 0)
+			{
+				level--;
+			}
+
+			String dir = level == 0 ? String(DestRoot) : String(destPath, destBase + level);
+			if (CreatedDirectories.Contains(dir))
+			{
+				break;
+			}
+
+			DWORD attributes = 0;
+			if (GetPathAttributes(dir.c_str(), attributes) == 0)
+			{
+				CreatedDirectories.Add(dir);
+				break;
+			}
+
+			missing.push_back(level);
+		} while (level > 0);
+
+		for (size_t i = missing.size(); i > 0; i--)
+		{
+			level = missing[i - 1];
+			String dir = level == 0 ? String(DestRoot) : String(destPath, destBase + level);
+			String src = level == 0 ? String(SrcRoot) : String(srcPath, srcBase + level);
+
+			// A dry run plans each directory once, however many readers find it missing
+			if (Options.Plan != NULL)
+			{
+				if (CreatedDirectories.Add(dir))
+				{
+					Options.Plan->Add(PlanCreateDirectory, 0, src.c_str(), dir.c_str(), NULL, NULL);
+				}
+				continue;
+			}
+
+			// Another creator may have made the same directory in the meantime
+			DWORD result = CreateDirectoryFrom(src.c_str(), dir.c_str());
+			if (result != 0 && result != ERROR_ALREADY_EXISTS)
+			{
+				return result;
+			}
+
+			CreatedDirectories.Add(dir);
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Builds the destination path that mirrors the given source entry.
+	 */
+	DWORD GetDestPath(const WalkEntry& Entry, PathBuffer& DestPath) const
+	{
+		if (Entry.RelativePath[0] == 0)
+		{
+			return DestPath.Assign(DestRoot);
+		}
+
+		return CombinePath(DestPath, DestRoot, Entry.RelativePath);
+	}
+
+	LPCTSTR SrcRoot;
+	LPCTSTR DestRoot;
+	const cplinkOptions& Options;
+	cplinkStats& Stats;
+	TargetRewriter Rewriter;
+	/** Links found by the walker, waiting for their targets to be read. */
+	BoundedQueue<CopyTask*> ReadQueue;
+	/** Links with rewritten targets, waiting to be created. */
+	BoundedQueue<CopyTask*> CreateQueue;
+	/** The destination directories known to exist, when they are created lazily. */
+	DirectoryCache CreatedDirectories;
+
+	// Not copyable
+	CopyLinkPipeline(const CopyLinkPipeline&);
+	CopyLinkPipeline& operator=(const CopyLinkPipeline&);
+};
+
+} // namespace
+
+DWORD cplink(LPCTSTR Src, LPCTSTR Dest, const cplinkOptions& Options, cplinkStats& Stats)
+{
+	// Expand the destination to a full path
+	PathBuffer DestPath;
+	if (GetFullPath(Dest, DestPath) != 0)
+	{
+		Stats.NumFailed++;
+		LogMessage(TEXT("Invalid destination path specified.\n"));
+		return 1;
+	}
+
+	// Lazily created directories copy the attributes of the matching source directory, the root included. A source
+	// that can't be expanded is left for the walker to report.
+	PathBuffer SrcPath;
+	if (Options.bLazyDirectories && GetFullPath(Src, SrcPath) != 0)
+	{
+		SrcPath.Assign(Src);
+	}
+
+	CopyLinkPipeline pipeline(SrcPath.Get(), DestPath.Get(), Options, Stats);
+	return pipeline.Run(Src);
+}
@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileSystem.h"
+
+#include "FileSystemBackend.h"
+#include "Metrics.h"
+#include "NtfsFileSystem.h"
+#include "PosixFileSystem.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+/** The prefix that lifts the MAX_PATH limit from a full Win32 path. */
+static const TCHAR LongPathPrefix[] = TEXT("\\\\?\\");
+/** The prefix that lifts the MAX_PATH limit from a UNC path, replacing its leading '\\'. */
+static const TCHAR LongUncPathPrefix[] = TEXT("\\\\?\\UNC\\");
+#endif
+
+/** The backend of the platform the library was built for. */
+#ifdef _WIN32
+static NtfsFileSystem NativeBackend;
+#else
+static PosixFileSystem NativeBackend;
+#endif
+
+/** The backend that every file system operation goes through. Changed only by SetFileSystemBackend. */
+static FileSystemBackend* Backend = &NativeBackend;
+
+/**
+ * Determines if the given path ends with the path component that names a root (e.g. 'C:\' or '/').
+ */
+static bool IsRootPath(LPCTSTR Path, size_t Length)
+{
+#ifdef _WIN32
+	// Look past the long path prefix, if there is one
+	const size_t prefixLength = ARRAYSIZE(LongPathPrefix) - 1;
+	if (Length >= prefixLength && _tcsncmp(Path, LongPathPrefix, prefixLength) == 0)
+	{
+		Path += prefixLength;
+		Length -= prefixLength;
+	}
+
+	return Length <= 1 || (Length == 3 && Path[1] == ':');
+#else
+	(void)Path;
+	return Length <= 1;
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * Collapses repeated separators and '.' and '..' components of a full path in place, the way GetFullPathName does on
+ * Windows. A '..' above the root stays at the root.
+ */
+static void CollapsePath(PathBuffer& Path)
+{
+	LPTSTR path = Path.Reserve(Path.Length());
+	size_t length = Path.Length();
+	size_t out = 1;
+	size_t i = 1;
+	while (i <= length)
+	{
+		// Find the next component
+		size_t start = i;
+		while (i < length && path[i] != PATH_SEPARATOR)
+		{
+			i++;
+		}
+		size_t componentLength = i - start;
+		i++;
+
+		if (componentLength == 0 || (componentLength == 1 && path[start] == '.'))
+		{
+			continue;
+		}
+		else if (componentLength == 2 && path[start] == '.' && path[start + 1] == '.')
+		{
+			// Drop the last component written, if any
+			while (out > 1 && path[out - 1] != PATH_SEPARATOR)
+			{
+				out--;
+			}
+			if (out > 1)
+			{
+				out--;
+			}
+			continue;
+		}
+
+		if (out > 1)
+		{
+			path[out++] = PATH_SEPARATOR;
+		}
+		memmove(&path[out], &path[start], componentLength * sizeof(TCHAR));
+		out += componentLength;
+	}
+
+	Path.SetLength(out);
+}
+#endif
+
+DWORD GetFullPath(LPCTSTR Path, PathBuffer& FullPath)
+{
+#ifdef _WIN32
+	// Ask for the length first, then expand the path straight into the buffer
+	DWORD length = GetFullPathName(Path, 0, NULL, NULL);
+	if (length == 0)
+	{
+		return GetLastError();
+	}
+
+	LPTSTR buffer = FullPath.Reserve(length);
+	if (buffer == NULL)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	length = GetFullPathName(Path, length, buffer, NULL);
+	if (length == 0)
+	{
+		return GetLastError();
+	}
+	FullPath.SetLength(length);
+
+	// Add the long path prefix unless the path already has it or is a device path
+	if (buffer[0] == '\\' && buffer[1] == '\\' && (buffer[2] == '?' || buffer[2] == '.') && buffer[3] == '\\')
+	{
+		// Already in long or device form
+	}
+	else
+	{
+		PathBuffer expanded(FullPath);
+		bool bUnc = buffer[0] == '\\' && buffer[1] == '\\';
+		if (FullPath.Assign(bUnc ? LongUncPathPrefix : LongPathPrefix) != 0 ||
+			FullPath.Append(expanded.Get() + (bUnc ? 2 : 0)) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+#else
+	if (Path[0] == PATH_SEPARATOR)
+	{
+		if (FullPath.Assign(Path) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+	else
+	{
+		TCHAR CurrentDir[PATH_MAX];
+		NumSystemCalls++;
+		if (getcwd(CurrentDir, ARRAYSIZE(CurrentDir)) == NULL)
+		{
+			return GetLastError();
+		}
+
+		DWORD result = CombinePath(FullPath, CurrentDir, Path);
+		if (result != 0)
+		{
+			return result;
+		}
+	}
+
+	// Roots given as 'dir' and './dir/' must compare equal
+	CollapsePath(FullPath);
+#endif
+
+	// Strip any trailing separators so that child paths can be appended uniformly
+	size_t length = FullPath.Length();
+	while (!IsRootPath(FullPath.Get(), length) && FullPath.Get()[length-1] == PATH_SEPARATOR)
+	{
+		length--;
+	}
+	FullPath.Truncate(length);
+
+	return 0;
+}
+
+DWORD CombinePath(PathBuffer& Dest, LPCTSTR Directory, LPCTSTR Name)
+{
+	if (Dest.Assign(Directory) != 0 || Dest.AppendName(Name) != 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	return 0;
+}
+
+DWORD GetPathAttributes(LPCTSTR Path, DWORD& Attributes)
+{
+	MetricTimer timer(MetricQuery);
+
+	return Backend->GetAttributes(Path, Attributes);
+}
+
+DWORD GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time)
+{
+	MetricTimer timer(MetricQuery);
+
+	return Backend->GetLastWriteTime(Path, Time);
+}
+
+DWORD ReplacePath(LPCTSTR OldPath, LPCTSTR NewPath)
+{
+	// Only ever used for files written through the C runtime, which always live on the native file system
+	return NativeBackend.Rename(OldPath, NewPath);
+}
+
+DWORD CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path)
+{
+	MetricTimer timer(MetricCreateDirectory);
+
+	return Backend->CreateDirectoryFrom(TemplatePath, Path);
+}
+
+/** Context passed through the backend to TimedEnumerateEntries. */
+struct TimedEnumerateContext
+{
+	MetricTimer* Timer;
+	EnumerateCallback Callback;
+	void* Context;
+};
+
+/**
+ * Passes a batch of entries on to the caller of EnumerateDirectory with the enumeration timer paused.
+ */
+static void TimedEnumerateEntries(void* Context, const DirectoryHandle& Directory, const DirectoryEntry* Entries,
+	size_t NumEntries)
+{
+	TimedEnumerateContext* context = (TimedEnumerateContext*)Context;
+	context->Timer->Pause();
+	context->Callback(context->Context, Directory, Entries, NumEntries);
+	context->Timer->Resume();
+}
+
+DWORD EnumerateDirectory(LPCTSTR Path, EnumerateCallback Callback, void* Context)
+{
+	// Only the time spent reading the directory counts, not the time spent handling each entry
+	MetricTimer timer(MetricEnumerate);
+
+	if (!bMetricsEnabled)
+	{
+		return Backend->Enumerate(Path, Callback, Context);
+	}
+
+	TimedEnumerateContext context = { &timer, Callback, Context };
+	return Backend->Enumerate(Path, &TimedEnumerateEntries, &context);
+}
+
+void SetEnumerateBufferSize(size_t Bytes)
+{
+#ifndef _WIN32
+	NativeBackend.SetEnumerateBufferSize(Bytes);
+#endif
+}
+
+ChangeWatcher* CreateChangeWatcher()
+{
+	return Backend->CreateWatcher();
+}
+
+void SetFileSystemBackend(FileSystemBackend* NewBackend)
+{
+	Backend = NewBackend != NULL ? NewBackend : &NativeBackend;
+}
+
+FileSystemBackend& GetFileSystemBackend()
+{
+	return *Backend;
+}
@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FixLink.h"
+
+#include "LinkIndex.h"
+#include "Log.h"
+#include "NtfsLinks.h"
+#include "ReparsePoint.h"
+#include "TargetRewriter.h"
+#include "TreeWalker.h"
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+using namespace libntfslinks;
+
+namespace
+{
+
+/**
+ * Rewrites the target of each reparse point found in the tree.
+ */
+class FixLinkVisitor : public TreeVisitor
+{
+public:
+	FixLinkVisitor(const fixlinkOptions& Options, fixlinkStats& Stats, LinkIndex* Index)
+		: Options(Options)
+		, Stats(Stats)
+		, Index(Index)
+		, Rewriter(Options.Rules, NULL, Options.OldTargetBase, Options.NewTargetBase, RewriteReplaceLast)
+	{
+	}
+
+	virtual bool VisitDirectory(const WalkEntry& /*Entry*/)
+	{
+		return true;
+	}
+
+	virtual void VisitLink(const WalkEntry& Entry)
+	{
+		DWORD result = 0;
+		LPCTSTR Path = Entry.Path;
+
+		// Read the target with a single open relative to the enumerated directory. Reparse points that the enumeration
+		// already reported as something other than a link are skipped without being opened.
+		ReparsePointInfo Info;
+		Info.Tag = Entry.ReparseTag;
+		if (Info.Tag == 0 || IsLinkTag(Info.Tag))
+		{
+			result = GetReparsePointInfoAt(Entry.Directory, Entry.Name, Info);
+		}
+
+		if (result == 0 && !IsLinkTag(Info.Tag))
+		{
+			LogMessage(TEXT("Unrecognized reparse point: %s\n"), Path);
+			Stats.NumSkipped++;
+			return;
+		}
+
+		// Links whose target is filtered out or not selected are left alone
+		if (result == 0 && Options.Filter != NULL && !Options.Filter->MatchesLinkTarget(Info.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return;
+		}
+		if (result == 0 && Options.Selector != NULL && !Options.Selector->IsSelected(Path, Info.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return;
+		}
+
+		// While watching, each link this visitor wrote is reported back as a change. It is left alone unless its
+		// target has changed again since.
+		if (result == 0 && Options.Watcher != NULL && WasWritten(Path, Info.Target.Get()))
+		{
+			return;
+		}
+
+		if (result == 0)
+		{
+			// Apply the rewrite rules, or perform a string replace, on the target path
+			PathBuffer NewTarget;
+			result = Rewriter.Rewrite(Info.Target.Get(), NewTarget);
+
+			// A link that the rewrite leaves as it is isn't written, nor recorded in a plan. While watching, writing it
+			// would also report it again.
+			if (result == 0 && _tcscmp(NewTarget.Get(), Info.Target.Get()) == 0)
+			{
+				if (Index != NULL)
+				{
+					Index->SetLinkTarget(Path, Info.Target.Get());
+				}
+				Stats.NumSkipped++;
+				return;
+			}
+
+			// A dry run only records what would be done
+			if (result == 0 && Options.Plan != NULL)
+			{
+				Options.Plan->Add(PlanFix, Info.Tag, Path, NULL, Info.Target.Get(), NewTarget.Get());
+				Stats.NumModified++;
+				return;
+			}
+
+			// Junctions and symlinks alike have their target replaced in place
+			if (result == 0)
+			{
+				result = SetReparseTargetAt(Info.Tag, Entry.Directory, Entry.Name, NewTarget.Get());
+				if (result == 0 && Options.bVerbose)
+				{
+					LogMessage(TEXT("%s %s target modified. old=%s, new=%s\n"), GetLinkTypeName(Info.Tag), Path,
+						Info.Target.Get(), NewTarget.Get());
+				}
+			}
+
+			// Was the link modified successfully?
+			if (result == 0)
+			{
+				Stats.NumModified++;
+				if (Options.Watcher != NULL)
+				{
+					AddWritten(Path, NewTarget.Get());
+				}
+			}
+
+			// Keep the index up to date with whichever target the link now has
+			if (Index != NULL)
+			{
+				Index->SetLinkTarget(Path, result == 0 ? NewTarget.Get() : Info.Target.Get());
+			}
+		}
+
+		// Was the operation successful?
+		if (result != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, Path);
+		}
+	}
+
+	virtual void VisitError(const WalkEntry& Entry, DWORD ErrorCode)
+	{
+		// If we failed to be able to read the directory listing due to a access violation count it as a skip
+		// instead of a complete failure.
+		if (ErrorCode == ERROR_ACCESS_DENIED && (Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			PrintErrorMessage(ErrorCode, Entry.Path);
+			Stats.NumSkipped++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(ErrorCode, Entry.Path);
+		}
+	}
+
+private:
+	typedef std::basic_string<TCHAR> String;
+
+	/**
+	 * Remembers that the given target was written to a link.
+	 */
+	void AddWritten(LPCTSTR Path, LPCTSTR Target)
+	{
+		std::lock_guard<std::mutex> lock(WrittenLock);
+		Written[Path] = Target;
+	}
+
+	/**
+	 * Returns true if the link still has the target this visitor wrote to it.
+	 */
+	bool WasWritten(LPCTSTR Path, LPCTSTR Target)
+	{
+		std::lock_guard<std::mutex> lock(WrittenLock);
+		std::unordered_map<String, String>::const_iterator it = Written.find(Path);
+		return it != Written.end() && it->second == Target;
+	}
+
+	const fixlinkOptions& Options;
+	fixlinkStats& Stats;
+	LinkIndex* Index;
+	TargetRewriter Rewriter;
+	/** The links written while watching, mapped to the target each was last given. */
+	std::unordered_map<String, String> Written;
+	std::mutex WrittenLock;
+
+	// Not copyable
+	FixLinkVisitor& operator=(const FixLinkVisitor&);
+};
+
+} // namespace
+
+DWORD fixlink(LPCTSTR Path, const fixlinkOptions& Options, fixlinkStats& Stats)
+{
+	return fixlink(std::vector<LPCTSTR>(1, Path), Options, Stats);
+}
+
+DWORD fixlink(const std::vector<LPCTSTR>& Paths, const fixlinkOptions& Options, fixlinkStats& Stats)
+{
+	// Only the directories that changed since the index was written are enumerated
+	LinkIndex index;
+	LinkIndex* pIndex = NULL;
+	if (!Options.IndexPath.IsEmpty())
+	{
+		pIndex = &index;
+		DWORD indexResult = index.Load(Options.IndexPath.Get());
+		if (indexResult != 0 && indexResult != ERROR_FILE_NOT_FOUND)
+		{
+			LogMessage(TEXT("Unable to read index %s, the entire tree will be scanned.\n"), Options.IndexPath.Get());
+		}
+	}
+
+	FixLinkVisitor visitor(Options, Stats, pIndex);
+	TreeWalker walker(visitor, Options.NumThreads, Options.MaxDepth, pIndex, Options.Order);
+	walker.SetProgress(Options.Progress);
+	walker.SetFilter(Options.Filter);
+	walker.SetWatcher(Options.Watcher);
+	DWORD result = walker.Walk(Paths);
+
+	// Keep fixing the links that are created or changed until the watch is stopped
+	if (Options.Watcher != NULL)
+	{
+		LogMessage(TEXT("Watching for changes...\n"));
+
+		std::vector<std::basic_string<TCHAR> > changes;
+		while (Options.Watcher->WaitForChanges(changes) == 0)
+		{
+			walker.WalkChanges(changes);
+		}
+	}
+
+	// Save the index for the next run. A dry run leaves it as it was.
+	if (pIndex != NULL && Options.Plan == NULL)
+	{
+		DWORD indexResult = index.Save(Options.IndexPath.Get());
+		if (indexResult != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(indexResult, Options.IndexPath.Get());
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,216 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InotifyWatcher.h"
+
+#ifdef __linux__
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * The events that mean an entry of a directory was created or changed. Links are never modified in place, their
+ * targets are changed by creating a new link or renaming one over the old, so these are the only events needed.
+ */
+static const uint32_t WatchMask = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+InotifyWatcher::InotifyWatcher()
+	: Fd(-1)
+{
+	StopPipe[0] = -1;
+	StopPipe[1] = -1;
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+	if (Fd >= 0)
+	{
+		close(Fd);
+	}
+	if (StopPipe[0] >= 0)
+	{
+		close(StopPipe[0]);
+		close(StopPipe[1]);
+	}
+}
+
+DWORD InotifyWatcher::Open()
+{
+	Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Fd < 0)
+	{
+		return errno;
+	}
+
+	if (pipe(StopPipe) != 0)
+	{
+		return errno;
+	}
+	fcntl(StopPipe[1], F_SETFL, O_NONBLOCK);
+
+	return 0;
+}
+
+DWORD InotifyWatcher::WatchDirectory(LPCTSTR Path)
+{
+	int wd = inotify_add_watch(Fd, Path, WatchMask);
+	if (wd < 0)
+	{
+		return errno;
+	}
+
+	// A directory that was renamed keeps its descriptor, so the path is always replaced
+	std::lock_guard<std::mutex> lock(Lock);
+	Directories[wd] = Path;
+	return 0;
+}
+
+DWORD InotifyWatcher::WaitForChanges(std::vector<String>& Paths)
+{
+	Paths.clear();
+
+	pollfd fds[2];
+	fds[0].fd = Fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = StopPipe[0];
+	fds[1].events = POLLIN;
+
+	// Block until the first change, then gather more until they settle
+	std::chrono::steady_clock::time_point first;
+	int timeout = -1;
+	for (;;)
+	{
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		int count = poll(fds, 2, timeout);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return errno;
+		}
+		else if (fds[1].revents != 0)
+		{
+			return ERROR_OPERATION_ABORTED;
+		}
+		else if (count == 0)
+		{
+			return 0;
+		}
+
+		ReadEvents(Paths);
+		if (Paths.empty())
+		{
+			continue;
+		}
+		else if (timeout < 0)
+		{
+			first = std::chrono::steady_clock::now();
+		}
+
+		long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - first).count();
+		if (elapsed >= MaxBatchTime)
+		{
+			return 0;
+		}
+		timeout = (int)(MaxBatchTime - elapsed < SettleTime ? MaxBatchTime - elapsed : SettleTime);
+	}
+}
+
+void InotifyWatcher::Stop()
+{
+	// Only async signal safe calls here
+	char signal = 0;
+	ssize_t written = write(StopPipe[1], &signal, 1);
+	(void)written;
+}
+
+/**
+ * Reads every event waiting on the inotify instance and adds the paths they name.
+ */
+void InotifyWatcher::ReadEvents(std::vector<String>& Paths)
+{
+	char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+	for (;;)
+	{
+		ssize_t length = read(Fd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(Lock);
+		for (char* next = buffer; next < buffer + length; )
+		{
+			const inotify_event* event = (const inotify_event*)next;
+			next += sizeof(inotify_event) + event->len;
+
+			if ((event->mask & IN_Q_OVERFLOW) != 0)
+			{
+				// Changes were dropped, so every directory must be walked again
+				for (std::map<int, String>::const_iterator i = Directories.begin(); i != Directories.end(); ++i)
+				{
+					Paths.push_back(i->second);
+				}
+				continue;
+			}
+			else if ((event->mask & IN_IGNORED) != 0)
+			{
+				// The directory was deleted or is no longer watched
+				Directories.erase(event->wd);
+				continue;
+			}
+
+			std::map<int, String>::const_iterator dir = Directories.find(event->wd);
+			if (dir == Directories.end() || event->len == 0)
+			{
+				continue;
+			}
+
+			String path(dir->second);
+			if (path.empty() || path[path.size() - 1] != PATH_SEPARATOR)
+			{
+				path.push_back(PATH_SEPARATOR);
+			}
+			path.append(event->name);
+			Paths.push_back(path);
+		}
+	}
+}
+
+#endif //__linux__
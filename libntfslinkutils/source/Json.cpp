@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Json.h"
+
+void AppendJsonString(std::basic_string<TCHAR>& Record, LPCTSTR Value)
+{
+	Record.push_back('"');
+	for (LPCTSTR c = Value; *c != 0; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			Record.push_back('\\');
+			Record.push_back(*c);
+		}
+		else if ((unsigned)*c < 0x20)
+		{
+			TCHAR escape[8];
+			StringCchPrintf(escape, ARRAYSIZE(escape), TEXT("\\u%04x"), (unsigned)*c);
+			Record.append(escape);
+		}
+		else
+		{
+			Record.push_back(*c);
+		}
+	}
+	Record.push_back('"');
+}
+
+void AppendJsonMember(std::basic_string<TCHAR>& Record, LPCTSTR Name, LPCTSTR Value)
+{
+	if (Value == NULL || Value[0] == 0)
+	{
+		return;
+	}
+
+	Record.push_back(Record.size() > 1 ? ',' : '{');
+	AppendJsonString(Record, Name);
+	Record.push_back(':');
+	AppendJsonString(Record, Value);
+}
+
+void AppendJsonMember(std::basic_string<TCHAR>& Record, LPCTSTR Name, ULONGLONG Value)
+{
+	TCHAR number[32];
+	StringCchPrintf(number, ARRAYSIZE(number), TEXT("%llu"), Value);
+
+	Record.push_back(Record.size() > 1 ? ',' : '{');
+	AppendJsonString(Record, Name);
+	Record.push_back(':');
+	Record.append(number);
+}
+
+void SkipJsonSpace(LPCTSTR& Text)
+{
+	while (*Text == ' ' || *Text == '\t' || *Text == '\r' || *Text == '\n')
+	{
+		Text++;
+	}
+}
+
+bool ReadJsonString(LPCTSTR& Text, std::basic_string<TCHAR>& Value)
+{
+	Value.clear();
+	if (*Text != '"')
+	{
+		return false;
+	}
+
+	for (Text++; *Text != '"'; Text++)
+	{
+		if (*Text == 0)
+		{
+			return false;
+		}
+		else if (*Text != '\\')
+		{
+			Value.push_back(*Text);
+			continue;
+		}
+
+		switch (*++Text)
+		{
+		case 'b':
+			Value.push_back('\b');
+			break;
+		case 'f':
+			Value.push_back('\f');
+			break;
+		case 'n':
+			Value.push_back('\n');
+			break;
+		case 'r':
+			Value.push_back('\r');
+			break;
+		case 't':
+			Value.push_back('\t');
+			break;
+		case 'u':
+			{
+				TCHAR digits[5] = { 0 };
+				for (int i = 0; i < 4; i++)
+				{
+					if (Text[i + 1] == 0)
+					{
+						return false;
+					}
+					digits[i] = Text[i + 1];
+				}
+				Value.push_back((TCHAR)_tcstoul(digits, NULL, 16));
+				Text += 4;
+			}
+			break;
+		case 0:
+			return false;
+		default:
+			// Quotes, backslashes and slashes stand for themselves
+			Value.push_back(*Text);
+			break;
+		}
+	}
+
+	Text++;
+	return true;
+}
@@ -0,0 +1,970 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LinkCommand.h"
+
+#include "ApplyPlan.h"
+#include "CopyLink.h"
+#include "FileSystem.h"
+#include "FixLink.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "MoveLink.h"
+#include "RemoveLink.h"
+
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <thread>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+/**
+ * The options that the tools accept.
+ */
+enum CommandOption
+{
+	OptionApply,
+	OptionBatch,
+	OptionDangling,
+	OptionExclude,
+	OptionExcludeTarget,
+	OptionInclude,
+	OptionIncludeTarget,
+	OptionIndex,
+	OptionJournal,
+	OptionJson,
+	OptionLazy,
+	OptionLevel,
+	OptionThreads,
+	OptionOrder,
+	OptionPipe,
+	OptionPlan,
+	OptionRules,
+	OptionRoot,
+	OptionStats,
+	OptionTarget,
+	OptionVerbose,
+	OptionVersion,
+	OptionWatch,
+	OptionHelp
+};
+
+/** The bit of each command in OptionInfo::Commands. */
+enum
+{
+	CopyOnly = 1 << CommandCopy,
+	FixOnly = 1 << CommandFix,
+	MoveOnly = 1 << CommandMove,
+	RemoveOnly = 1 << CommandRemove,
+	AllCommands = CopyOnly | FixOnly | MoveOnly | RemoveOnly
+};
+
+struct OptionInfo
+{
+	CommandOption Option;
+	/** The name of the option, up to any ':' that introduces its value. */
+	LPCTSTR Name;
+	/** The option as shown in the list of options. */
+	LPCTSTR Syntax;
+	/** The commands that accept the option. */
+	unsigned Commands;
+	/** The description shown in the list of options, or NULL for the one given by the command. */
+	LPCTSTR Help;
+};
+
+/** Every option, in the order they are listed by /?. */
+const OptionInfo OptionTable[] =
+{
+	{ OptionApply, TEXT("/APPLY"), TEXT("/APPLY:file"), AllCommands,
+		TEXT("Perform the operations in a plan written by /PLAN, without walking the tree.") },
+	{ OptionBatch, TEXT("/BATCH"), TEXT("/BATCH"), MoveOnly,
+		TEXT("Create every link at the destination before deleting the sources in parallel batches.") },
+	{ OptionDangling, TEXT("/DANGLING"), TEXT("/DANGLING"), FixOnly | RemoveOnly,
+		TEXT("Only process links whose target does not exist.") },
+	{ OptionExclude, TEXT("/EXCLUDE"), TEXT("/EXCLUDE:pattern"), AllCommands,
+		TEXT("Skip links and directories whose path matches pattern. Excluded directories are not walked.") },
+	{ OptionExcludeTarget, TEXT("/EXCLUDETARGET"), TEXT("/EXCLUDETARGET:pattern"), AllCommands,
+		TEXT("Skip links whose target matches pattern.") },
+	{ OptionInclude, TEXT("/INCLUDE"), TEXT("/INCLUDE:pattern"), AllCommands,
+		TEXT("Only process links whose path matches pattern.") },
+	{ OptionIncludeTarget, TEXT("/INCLUDETARGET"), TEXT("/INCLUDETARGET:pattern"), AllCommands,
+		TEXT("Only process links whose target matches pattern.") },
+	{ OptionIndex, TEXT("/INDEX"), TEXT("/INDEX:file"), FixOnly | RemoveOnly,
+		TEXT("Reuse and update the link index in file, only scanning directories that changed.") },
+	{ OptionJournal, TEXT("/JOURNAL"), TEXT("/JOURNAL:file"), MoveOnly,
+		TEXT("Implies /BATCH. Record the progress of the move in file so that an interrupted move resumes.") },
+	{ OptionJson, TEXT("/JSON"), TEXT("/JSON[:n]"), AllCommands,
+		TEXT("Write JSON records instead of text, with a progress record every n seconds (default is 1).") },
+	{ OptionLazy, TEXT("/LAZY"), TEXT("/LAZY"), CopyOnly,
+		TEXT("Only create the destination directories on the path to a copied link, not one per source directory.") },
+	{ OptionLevel, TEXT("/LEV"), TEXT("/LEV:n"), AllCommands, NULL },
+	{ OptionThreads, TEXT("/MT"), TEXT("/MT[:n]"), AllCommands,
+		TEXT("Use n threads to traverse the directory tree (default is one per processor).") },
+	{ OptionOrder, TEXT("/ORDER"), TEXT("/ORDER:DFS|BFS"), AllCommands,
+		TEXT("Traverse the directory tree depth first (default) or breadth first.") },
+	{ OptionPipe, TEXT("/PIPE"), TEXT("/PIPE:r[,c]"), CopyOnly,
+		TEXT("Use r threads to read link targets and c threads to create links (default is one per processor).") },
+	{ OptionPlan, TEXT("/PLAN"), TEXT("/PLAN:file"), AllCommands,
+		TEXT("Write the operations that would be performed to file without performing them.") },
+	{ OptionRules, TEXT("/RULES"), TEXT("/RULES:file"), CopyOnly | FixOnly | MoveOnly,
+		TEXT("Modifies the target path of all links using the <find>|<replace> rules in file, one per line.") },
+	{ OptionRoot, TEXT("/R"), TEXT("/R <old> <new>"), CopyOnly | MoveOnly,
+		TEXT("Modifies the target path of all links, rebasing those beneath <old> onto <new>. May be repeated.") },
+	{ OptionStats, TEXT("/STATS"), TEXT("/STATS"), AllCommands,
+		TEXT("Print the latency of each kind of file system operation when finished.") },
+	{ OptionTarget, TEXT("/TARGET"), TEXT("/TARGET:prefix"), FixOnly | RemoveOnly,
+		TEXT("Only process links whose target is beneath prefix. May be repeated.") },
+	{ OptionVerbose, TEXT("/V"), TEXT("/V"), AllCommands,
+		TEXT("Enable verbose output and display more information.") },
+	{ OptionVersion, TEXT("/VER"), TEXT("/VER"), AllCommands,
+		TEXT("Display the version and copyright information.") },
+	{ OptionWatch, TEXT("/WATCH"), TEXT("/WATCH"), CopyOnly | FixOnly,
+		TEXT("Keep processing links and directories as they are created or changed until Ctrl+C is pressed.") },
+	{ OptionHelp, TEXT("/?"), TEXT("/?"), AllCommands,
+		TEXT("View this list of options.") }
+};
+
+struct CommandInfo
+{
+	/** The name of the tool. */
+	LPCTSTR Name;
+	/** The name of the command when run through ntfslink. */
+	LPCTSTR ShortName;
+	/** What the tool does, shown at the top of its usage. */
+	LPCTSTR Description;
+	/** The options and paths the tool accepts, shown after its name in its usage. */
+	LPCTSTR Usage;
+	/** The description of /LEV. */
+	LPCTSTR LevelHelp;
+	/** The name of the count of successful operations in the summary. */
+	LPCTSTR Label;
+	/** The operation that /APPLY performs. */
+	PlanOperation ApplyOperation;
+};
+
+const CommandInfo CommandTable[NumLinkCommands] =
+{
+	{ TEXT("cplink"), TEXT("cp"), TEXT("Copies all symbolic links and junctions from one path to another."),
+		TEXT("[/V] [/PLAN:file | /APPLY:file | /WATCH] [/JSON[:n]] [/LAZY] [/LEV:n] [/MT[:n]] [/ORDER:DFS|BFS] ")
+		TEXT("[/PIPE:r[,c]] [/STATS] [/INCLUDE[TARGET]:pattern] [/EXCLUDE[TARGET]:pattern] ")
+		TEXT("[/RULES:file | /R <find> <replace>] <source> <destination>"),
+		TEXT("Only copy the top n levels of the source directory tree."), TEXT("Copied"), PlanCopy },
+	{ TEXT("fixlink"), TEXT("fix"),
+		TEXT("Modifies the target path of all symbolic links and junctions in a given set of paths."),
+		TEXT("[/V] [/PLAN:file | /APPLY:file | /INDEX:file | /WATCH] [/JSON[:n]] [/LEV:n] [/MT[:n]] [/ORDER:DFS|BFS] ")
+		TEXT("[/STATS] [/INCLUDE[TARGET]:pattern] [/EXCLUDE[TARGET]:pattern] [/TARGET:prefix] [/DANGLING] ")
+		TEXT("[/RULES:file | <find> <replace>] <path>..."),
+		TEXT("Only modify links in the top n levels of each path."), TEXT("Modified"), PlanFix },
+	{ TEXT("mvlink"), TEXT("mv"), TEXT("Moves all symbolic links and junctions from one path to another."),
+		TEXT("[/V] [/PLAN:file | /APPLY:file] [/BATCH] [/JOURNAL:file] [/JSON[:n]] [/LEV:n] [/MT[:n]] ")
+		TEXT("[/ORDER:DFS|BFS] [/STATS] [/INCLUDE[TARGET]:pattern] [/EXCLUDE[TARGET]:pattern] ")
+		TEXT("[/RULES:file | /R <find> <replace>] <source> <destination>"),
+		TEXT("Only move the top n levels of the source directory tree."), TEXT("Moved"), PlanMove },
+	{ TEXT("rmlink"), TEXT("rm"), TEXT("Deletes all symbolic links and junctions from the specified list of paths."),
+		TEXT("[/V] [/PLAN:file | /APPLY:file] [/INDEX:file] [/JSON[:n]] [/LEV:n] [/MT[:n]] [/ORDER:DFS|BFS] [/STATS] ")
+		TEXT("[/INCLUDE[TARGET]:pattern] [/EXCLUDE[TARGET]:pattern] [/TARGET:prefix] [/DANGLING] <path>..."),
+		TEXT("Only remove links in the top n levels of the path."), TEXT("Deleted"), PlanRemove }
+};
+
+/**
+ * Everything given on the command line of a tool.
+ */
+struct CommandLine
+{
+	bool bVerbose;
+	int MaxDepth;
+	int NumThreads;
+	WalkOrder Order;
+	int NumReadThreads;
+	int NumCreateThreads;
+	bool bTwoPhase;
+	bool bJsonOutput;
+	int ProgressInterval;
+	bool bStats;
+	bool bWatch;
+	bool bLazyDirectories;
+	PathBuffer ApplyPath;
+	PathBuffer IndexPath;
+	PathBuffer JournalPath;
+	PathBuffer PlanPath;
+	/** The plan of a dry run, used when bPlan is set. */
+	ActionPlan Plan;
+	bool bPlan;
+	/** The rewrite rules, used when bRules is set. */
+	RewriteRules Rules;
+	bool bRules;
+	RootMap Roots;
+	PathFilter Filter;
+	LinkSelector Selector;
+	/** The arguments that are not options, in the order given. */
+	std::vector<LPCTSTR> Paths;
+
+	CommandLine()
+		: bVerbose(false)
+		, MaxDepth(-1)
+		, NumThreads(0)
+		, Order(WalkDepthFirst)
+		, NumReadThreads(0)
+		, NumCreateThreads(0)
+		, bTwoPhase(false)
+		, bJsonOutput(false)
+		, ProgressInterval(0)
+		, bStats(false)
+		, bWatch(false)
+		, bLazyDirectories(false)
+		, bPlan(false)
+		, bRules(false)
+	{
+	}
+
+	ActionPlan* GetPlan() { return bPlan ? &Plan : NULL; }
+	const RewriteRules* GetRules() const { return bRules ? &Rules : NULL; }
+	const RootMap* GetRoots() const { return Roots.IsEmpty() ? NULL : &Roots; }
+	const PathFilter* GetFilter() const { return Filter.IsEmpty() ? NULL : &Filter; }
+	const LinkSelector* GetSelector() const { return Selector.IsEmpty() ? NULL : &Selector; }
+
+private:
+	// Not copyable
+	CommandLine(const CommandLine&);
+	CommandLine& operator=(const CommandLine&);
+};
+
+/** The counters of the running command, read by the progress thread while JSON output is enabled. */
+WalkProgress Progress;
+const std::atomic<size_t>* NumSucceeded;
+const std::atomic<size_t>* NumSkipped;
+const std::atomic<size_t>* NumFailed;
+
+/**
+ * Reports the progress of the running command to the JSON output.
+ */
+void ReportProgress(LogProgress& Report)
+{
+	Report.NumScanned = Progress.NumScanned;
+	Report.NumProcessed = *NumSucceeded + *NumSkipped + *NumFailed;
+	Report.NumFailed = *NumFailed;
+	Report.Depth = Progress.Depth;
+}
+
+/**
+ * Folds an ASCII character to upper case. Option and command names are compared without regard to case.
+ */
+TCHAR ToUpper(TCHAR c)
+{
+	return c >= 'a' && c <= 'z' ? (TCHAR)(c - 'a' + 'A') : c;
+}
+
+/**
+ * Returns true if the first Length characters of A and B are the same, ignoring case.
+ */
+bool EqualsNoCase(LPCTSTR A, LPCTSTR B, size_t Length)
+{
+	for (size_t i = 0; i < Length; i++)
+	{
+		if (ToUpper(A[i]) != ToUpper(B[i]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Finds the option given by an argument. An option matches only as a whole, optionally followed by ':' and its
+ * value, so an argument that merely starts with '/', such as a POSIX path, is not taken for an option.
+ *
+ * @param Arg The argument to look up.
+ * @param Value The value following the ':', or an empty string if there is none. [OUT]
+ * @return Returns the option, or NULL if the argument is not an option.
+ */
+const OptionInfo* FindOption(LPCTSTR Arg, LPCTSTR& Value)
+{
+	for (size_t i = 0; i < ARRAYSIZE(OptionTable); i++)
+	{
+		size_t length = _tcslen(OptionTable[i].Name);
+		if (!EqualsNoCase(Arg, OptionTable[i].Name, length))
+		{
+			continue;
+		}
+
+		if (Arg[length] == 0)
+		{
+			Value = &Arg[length];
+			return &OptionTable[i];
+		}
+		else if (Arg[length] == ':')
+		{
+			Value = &Arg[length + 1];
+			return &OptionTable[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Stores the file path given as the value of an option, reporting an error if it is too long.
+ *
+ * @return Returns true if the path was stored, otherwise false.
+ */
+bool SetOptionPath(PathBuffer& Path, LPCTSTR Value)
+{
+	if (Path.Assign(Value) != 0)
+	{
+		_tprintf(TEXT("Error: The path %s is too long.\n"), Value);
+		return false;
+	}
+
+	return true;
+}
+
+void PrintUsage(LinkCommand Command)
+{
+	const CommandInfo& Info = CommandTable[Command];
+	_tprintf(TEXT("%s\n\n"), Info.Description);
+	_tprintf(TEXT("Usage: %s %s\n\n"), Info.Name, Info.Usage);
+	_tprintf(TEXT("Options:\n"));
+	for (size_t i = 0; i < ARRAYSIZE(OptionTable); i++)
+	{
+		const OptionInfo& option = OptionTable[i];
+		if ((option.Commands & (1 << Command)) != 0)
+		{
+			_tprintf(TEXT("\t\t%s%s%s\n"), option.Syntax, _tcslen(option.Syntax) < 8 ? TEXT("\t\t") : TEXT("\t"),
+				option.Help != NULL ? option.Help : Info.LevelHelp);
+		}
+	}
+}
+
+/**
+ * Parses the arguments of a command.
+ *
+ * @param Command The command being run.
+ * @param argc The number of arguments, including the name of the command.
+ * @param argv The name of the command followed by its arguments.
+ * @param Line The options and paths given. [OUT]
+ * @param ExitCode The code to exit with if the command should not run. [OUT]
+ * @return Returns true if the command should run, otherwise false.
+ */
+bool ParseCommandLine(LinkCommand Command, int argc, TCHAR* argv[], CommandLine& Line, int& ExitCode)
+{
+	ExitCode = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		LPCTSTR value = NULL;
+		const OptionInfo* option = FindOption(argv[i], value);
+		if (option == NULL)
+		{
+			Line.Paths.push_back(argv[i]);
+			continue;
+		}
+		else if ((option->Commands & (1 << Command)) == 0)
+		{
+			_tprintf(TEXT("Error: Invalid argument %s.\n"), argv[i]);
+			PrintUsage(Command);
+			return false;
+		}
+
+		switch (option->Option)
+		{
+		case OptionVersion:
+			PrintLinkVersion();
+			ExitCode = 0;
+			return false;
+		case OptionHelp:
+			PrintUsage(Command);
+			ExitCode = 0;
+			return false;
+		case OptionApply:
+			if (!SetOptionPath(Line.ApplyPath, value))
+			{
+				return false;
+			}
+			break;
+		case OptionPlan:
+			if (!SetOptionPath(Line.PlanPath, value))
+			{
+				return false;
+			}
+			Line.bPlan = true;
+			break;
+		case OptionBatch:
+			Line.bTwoPhase = true;
+			break;
+		case OptionDangling:
+			Line.Selector.SelectDangling();
+			break;
+		case OptionExclude:
+		case OptionExcludeTarget:
+		case OptionInclude:
+		case OptionIncludeTarget:
+			{
+				bool bExclude = option->Option == OptionExclude || option->Option == OptionExcludeTarget;
+				bool bTarget = option->Option == OptionExcludeTarget || option->Option == OptionIncludeTarget;
+				if (Line.Filter.AddPattern(bTarget ? FilterTarget : FilterPath, bExclude, value) != 0)
+				{
+					_tprintf(TEXT("Error: Invalid pattern %s.\n"), value);
+					return false;
+				}
+			}
+			break;
+		case OptionIndex:
+			if (!SetOptionPath(Line.IndexPath, value))
+			{
+				return false;
+			}
+			break;
+		case OptionJournal:
+			if (!SetOptionPath(Line.JournalPath, value))
+			{
+				return false;
+			}
+			Line.bTwoPhase = true;
+			break;
+		case OptionJson:
+			Line.bJsonOutput = true;
+			Line.ProgressInterval = _ttoi(value);
+			break;
+		case OptionLazy:
+			Line.bLazyDirectories = true;
+			break;
+		case OptionLevel:
+			Line.MaxDepth = _ttoi(value);
+			break;
+		case OptionThreads:
+			Line.NumThreads = _ttoi(value);
+			break;
+		case OptionOrder:
+			if (EqualsNoCase(value, TEXT("BFS"), 4))
+			{
+				Line.Order = WalkBreadthFirst;
+			}
+			else if (EqualsNoCase(value, TEXT("DFS"), 4))
+			{
+				Line.Order = WalkDepthFirst;
+			}
+			else
+			{
+				_tprintf(TEXT("Error: Invalid traversal order %s.\n"), value);
+				PrintUsage(Command);
+				return false;
+			}
+			break;
+		case OptionPipe:
+			{
+				Line.NumReadThreads = _ttoi(value);
+				Line.NumCreateThreads = Line.NumReadThreads;
+
+				LPCTSTR separator = _tcschr(value, ',');
+				if (separator != NULL)
+				{
+					Line.NumCreateThreads = _ttoi(separator + 1);
+				}
+			}
+			break;
+		case OptionRules:
+			if (Line.Rules.Load(value) != 0)
+			{
+				_tprintf(TEXT("Error: Unable to read rules file %s.\n"), value);
+				return false;
+			}
+			Line.bRules = true;
+			break;
+		case OptionRoot:
+			if (i + 2 >= argc || FindOption(argv[i+1], value) != NULL || FindOption(argv[i+2], value) != NULL)
+			{
+				_tprintf(TEXT("Error: Invalid argument(s).\n"));
+				PrintUsage(Command);
+				return false;
+			}
+			Line.Roots.AddRoot(argv[i+1], argv[i+2]);
+			i += 2;
+			break;
+		case OptionStats:
+			Line.bStats = true;
+			EnableMetrics(true);
+			break;
+		case OptionTarget:
+			{
+				// Targets are compared as full paths
+				PathBuffer prefix;
+				if (GetFullPath(value, prefix) != 0)
+				{
+					_tprintf(TEXT("Error: Invalid target prefix %s.\n"), value);
+					return false;
+				}
+				Line.Selector.AddTargetRoot(prefix.Get());
+			}
+			break;
+		case OptionVerbose:
+			Line.bVerbose = true;
+			break;
+		case OptionWatch:
+			Line.bWatch = true;
+			break;
+		}
+	}
+
+	// A plan is either written or applied, not both
+	if (Line.bPlan && !Line.ApplyPath.IsEmpty())
+	{
+		_tprintf(TEXT("Error: /PLAN cannot be combined with /APPLY.\n"));
+		return false;
+	}
+
+	// Targets are rewritten either by the rules or by the roots, not both
+	if (Line.bRules && !Line.Roots.IsEmpty())
+	{
+		_tprintf(TEXT("Error: /RULES cannot be combined with /R.\n"));
+		PrintUsage(Command);
+		return false;
+	}
+
+	// A watch never finishes, so there is no end to write a plan or an index at
+	if (Line.bWatch && (Line.bPlan || !Line.ApplyPath.IsEmpty() || !Line.IndexPath.IsEmpty()))
+	{
+		_tprintf(TEXT("Error: /WATCH cannot be combined with /PLAN, /APPLY or /INDEX.\n"));
+		return false;
+	}
+
+	// The selector remembers which targets exist, so it would miss targets deleted while watching
+	if (Line.bWatch && Line.Selector.IsDanglingSelected())
+	{
+		_tprintf(TEXT("Error: /WATCH cannot be combined with /DANGLING.\n"));
+		return false;
+	}
+
+	// Applying a plan needs no paths
+	if (!Line.ApplyPath.IsEmpty())
+	{
+		return true;
+	}
+
+	// Check the minimum required arguments
+	size_t requiredPaths = 1;
+	if (Command == CommandCopy || Command == CommandMove)
+	{
+		requiredPaths = 2;
+	}
+	else if (Command == CommandFix && !Line.bRules)
+	{
+		requiredPaths = 3;
+	}
+
+	if (Line.Paths.size() < requiredPaths)
+	{
+		_tprintf(TEXT("Error: Missing argument(s).\n"));
+		PrintUsage(Command);
+		return false;
+	}
+
+	// The plan file is only created once the whole command line is known to be valid, so that no empty plan is left
+	// behind by a mistyped command
+	if (Line.bPlan && Line.Plan.Create(Line.PlanPath.Get()) != 0)
+	{
+		_tprintf(TEXT("Error: Unable to create plan file %s.\n"), Line.PlanPath.Get());
+		return false;
+	}
+
+	return true;
+}
+
+/** The watcher of a /WATCH command, stopped by Ctrl+C. */
+ChangeWatcher* ActiveWatcher = NULL;
+
+#ifdef _WIN32
+/**
+ * Stops the watch on Ctrl+C. Console control handlers run on a thread of their own, so the watcher is stopped directly.
+ */
+BOOL WINAPI StopWatching(DWORD /*CtrlType*/)
+{
+	ActiveWatcher->Stop();
+	return TRUE;
+}
+#else
+/** Written to by StopWatching and read by StopThread. */
+int StopPipe[2] = { -1, -1 };
+/** Stops the watcher once StopWatching has been called, since a signal handler can't. */
+std::thread StopThread;
+
+/**
+ * Stops the watch on SIGINT or SIGTERM. Only async signal safe calls may be made here, so the watcher is left to
+ * StopThread to stop.
+ */
+void StopWatching(int /*Signal*/)
+{
+	char byte = 0;
+	ssize_t written = write(StopPipe[1], &byte, 1);
+	(void)written;
+}
+
+/**
+ * Waits on StopThread until StopWatching has been called, then stops the watcher.
+ */
+void WaitToStopWatching()
+{
+	char byte = 0;
+	while (read(StopPipe[0], &byte, 1) < 0 && errno == EINTR)
+	{
+	}
+
+	ActiveWatcher->Stop();
+}
+#endif
+
+/**
+ * Creates the watcher of a /WATCH command. Ctrl+C then stops the watch instead of the process, so that the command
+ * still finishes and prints its summary.
+ *
+ * @return Returns the watcher, or NULL if the file system cannot watch for changes.
+ */
+ChangeWatcher* StartWatching()
+{
+	ActiveWatcher = CreateChangeWatcher();
+	if (ActiveWatcher == NULL)
+	{
+		_tprintf(TEXT("Error: /WATCH is not supported on this system.\n"));
+		return NULL;
+	}
+
+#ifdef _WIN32
+	SetConsoleCtrlHandler(&StopWatching, TRUE);
+#else
+	if (pipe(StopPipe) != 0)
+	{
+		_tprintf(TEXT("Error: Unable to watch for Ctrl+C.\n"));
+		delete ActiveWatcher;
+		ActiveWatcher = NULL;
+		return NULL;
+	}
+	fcntl(StopPipe[1], F_SETFL, O_NONBLOCK);
+	StopThread = std::thread(&WaitToStopWatching);
+
+	signal(SIGINT, &StopWatching);
+	signal(SIGTERM, &StopWatching);
+#endif
+	return ActiveWatcher;
+}
+
+/**
+ * Restores the default handling of Ctrl+C and deletes the watcher of a /WATCH command, if there is one.
+ */
+void FinishWatching()
+{
+	if (ActiveWatcher == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	SetConsoleCtrlHandler(&StopWatching, FALSE);
+#else
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	// Wake StopThread if no signal did
+	StopWatching(0);
+	StopThread.join();
+	close(StopPipe[0]);
+	close(StopPipe[1]);
+	StopPipe[0] = -1;
+	StopPipe[1] = -1;
+#endif
+	delete ActiveWatcher;
+	ActiveWatcher = NULL;
+}
+
+/**
+ * Sets the options that every engine shares.
+ */
+template<typename T>
+void SetWalkOptions(CommandLine& Line, T& Options)
+{
+	Options.bVerbose = Line.bVerbose;
+	Options.MaxDepth = Line.MaxDepth;
+	Options.NumThreads = Line.NumThreads;
+	Options.Order = Line.Order;
+	Options.Plan = Line.GetPlan();
+	Options.Progress = Line.bJsonOutput ? &Progress : NULL;
+	Options.Filter = Line.GetFilter();
+}
+
+/**
+ * Starts the JSON output, if enabled, reporting the progress of a command through the given counters.
+ */
+void StartCommand(CommandLine& Line, const std::atomic<size_t>& Succeeded, const std::atomic<size_t>& Skipped,
+	const std::atomic<size_t>& Failed)
+{
+	NumSucceeded = &Succeeded;
+	NumSkipped = &Skipped;
+	NumFailed = &Failed;
+
+	if (Line.bJsonOutput)
+	{
+		StartJsonOutput(&ReportProgress, Line.ProgressInterval * 1000);
+	}
+}
+
+/**
+ * Finishes writing the plan of a dry run, prints the execution statistics and closes the log.
+ *
+ * @return Returns the code to exit the process with.
+ */
+int FinishCommand(LinkCommand Command, CommandLine& Line, DWORD Result, size_t Succeeded, size_t Skipped,
+	size_t Failed)
+{
+	// Finish writing the plan of a dry run
+	if (Line.bPlan && Line.Plan.Close() != 0)
+	{
+		LogMessage(TEXT("Error: Unable to write plan file.\n"));
+		Failed++;
+	}
+
+	// Print the execution statistics. A dry run only planned what it counted.
+	LogSummary(Line.bPlan ? TEXT("Planned") : CommandTable[Command].Label, Succeeded, Skipped, Failed);
+	if (Line.bStats)
+	{
+		LogStats();
+	}
+	CloseLog();
+
+	// Make sure that if there were errors it is reflected in the result
+	if (Result == 0 && Failed > 0)
+	{
+		Result = 1;
+	}
+
+	return (int)Result;
+}
+
+int ApplyPlan(LinkCommand Command, CommandLine& Line)
+{
+	applyplanOptions options;
+	options.bVerbose = Line.bVerbose;
+	options.NumThreads = Line.NumThreads;
+
+	applyplanStats stats;
+	StartCommand(Line, stats.NumApplied, stats.NumSkipped, stats.NumFailed);
+	DWORD result = applyplan(Line.ApplyPath.Get(), CommandTable[Command].ApplyOperation, options, stats);
+	return FinishCommand(Command, Line, result, stats.NumApplied, stats.NumSkipped, stats.NumFailed);
+}
+
+int CopyLinks(CommandLine& Line)
+{
+	cplinkOptions options;
+	SetWalkOptions(Line, options);
+	options.NumReadThreads = Line.NumReadThreads;
+	options.NumCreateThreads = Line.NumCreateThreads;
+	options.bLazyDirectories = Line.bLazyDirectories;
+	options.Rules = Line.GetRules();
+	options.Roots = Line.GetRoots();
+	if (Line.bWatch)
+	{
+		options.Watcher = StartWatching();
+		if (options.Watcher == NULL)
+		{
+			return 1;
+		}
+	}
+
+	cplinkStats stats;
+	StartCommand(Line, stats.NumCopied, stats.NumSkipped, stats.NumFailed);
+	DWORD result = cplink(Line.Paths[Line.Paths.size()-2], Line.Paths.back(), options, stats);
+	FinishWatching();
+	return FinishCommand(CommandCopy, Line, result, stats.NumCopied, stats.NumSkipped, stats.NumFailed);
+}
+
+int FixLinks(CommandLine& Line)
+{
+	fixlinkOptions options;
+	SetWalkOptions(Line, options);
+	options.Rules = Line.GetRules();
+	options.Selector = Line.GetSelector();
+	options.IndexPath = Line.IndexPath;
+
+	// Without rules the first two paths are the string to find and the string to replace it with
+	size_t firstPath = 0;
+	if (!Line.bRules)
+	{
+		if (FAILED(StringCchCopy(options.OldTargetBase, ARRAYSIZE(options.OldTargetBase), Line.Paths[0])) ||
+			FAILED(StringCchCopy(options.NewTargetBase, ARRAYSIZE(options.NewTargetBase), Line.Paths[1])))
+		{
+			_tprintf(TEXT("Error: The path to find or replace is too long.\n"));
+			return 1;
+		}
+		firstPath = 2;
+	}
+
+	if (Line.bWatch)
+	{
+		options.Watcher = StartWatching();
+		if (options.Watcher == NULL)
+		{
+			return 1;
+		}
+	}
+
+	fixlinkStats stats;
+	StartCommand(Line, stats.NumModified, stats.NumSkipped, stats.NumFailed);
+	std::vector<LPCTSTR> paths(Line.Paths.begin() + firstPath, Line.Paths.end());
+	DWORD result = fixlink(paths, options, stats);
+	FinishWatching();
+	return FinishCommand(CommandFix, Line, result, stats.NumModified, stats.NumSkipped, stats.NumFailed);
+}
+
+int MoveLinks(CommandLine& Line)
+{
+	mvlinkOptions options;
+	SetWalkOptions(Line, options);
+	options.bTwoPhase = Line.bTwoPhase;
+	options.Rules = Line.GetRules();
+	options.Roots = Line.GetRoots();
+	options.JournalPath = Line.JournalPath;
+
+	mvlinkStats stats;
+	StartCommand(Line, stats.NumMoved, stats.NumSkipped, stats.NumFailed);
+	DWORD result = mvlink(Line.Paths[Line.Paths.size()-2], Line.Paths.back(), options, stats);
+	return FinishCommand(CommandMove, Line, result, stats.NumMoved, stats.NumSkipped, stats.NumFailed);
+}
+
+int RemoveLinks(CommandLine& Line)
+{
+	rmlinkOptions options;
+	SetWalkOptions(Line, options);
+	options.Selector = Line.GetSelector();
+	options.IndexPath = Line.IndexPath;
+
+	rmlinkStats stats;
+	StartCommand(Line, stats.NumDeleted, stats.NumSkipped, stats.NumFailed);
+	DWORD result = rmlink(Line.Paths, options, stats);
+	return FinishCommand(CommandRemove, Line, result, stats.NumDeleted, stats.NumSkipped, stats.NumFailed);
+}
+
+} // namespace
+
+bool FindLinkCommand(LPCTSTR Name, LinkCommand& Command)
+{
+	// Skip the directory
+	for (LPCTSTR c = Name; *c != 0; c++)
+	{
+		if (*c == '\\' || *c == '/')
+		{
+			Name = c + 1;
+		}
+	}
+
+	// Drop the extension of a Windows executable
+	size_t length = _tcslen(Name);
+	if (length > 4 && EqualsNoCase(&Name[length - 4], TEXT(".exe"), 4))
+	{
+		length -= 4;
+	}
+
+	for (int i = 0; i < NumLinkCommands; i++)
+	{
+		if ((_tcslen(CommandTable[i].Name) == length && EqualsNoCase(Name, CommandTable[i].Name, length)) ||
+			(_tcslen(CommandTable[i].ShortName) == length && EqualsNoCase(Name, CommandTable[i].ShortName, length)))
+		{
+			Command = (LinkCommand)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void PrintLinkCommands()
+{
+	for (int i = 0; i < NumLinkCommands; i++)
+	{
+		const CommandInfo& info = CommandTable[i];
+		_tprintf(TEXT("\t\t%s, %s\t%s\n"), info.ShortName, info.Name, info.Description);
+	}
+}
+
+void PrintLinkVersion()
+{
+	_tprintf(TEXT("Copyright (C) 2014, Jean-Philippe Steinmetz. All rights reserved.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("Redistribution and use in source and binary forms, with or without\n"));
+	_tprintf(TEXT("modification, are permitted provided that the following conditions are met:\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("* Redistributions of source code must retain the above copyright notice, this\n"));
+	_tprintf(TEXT("  list of conditions and the following disclaimer.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("* Redistributions in binary form must reproduce the above copyright notice,\n"));
+	_tprintf(TEXT("  this list of conditions and the following disclaimer in the documentation\n"));
+	_tprintf(TEXT("  and/or other materials provided with the distribution.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS \"AS IS\"\n"));
+	_tprintf(TEXT("AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE\n"));
+	_tprintf(TEXT("IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE\n"));
+	_tprintf(TEXT("DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE\n"));
+	_tprintf(TEXT("FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL\n"));
+	_tprintf(TEXT("DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR\n"));
+	_tprintf(TEXT("SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER\n"));
+	_tprintf(TEXT("CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,\n"));
+	_tprintf(TEXT("OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE\n"));
+	_tprintf(TEXT("OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.\n"));
+}
+
+int RunLinkCommand(LinkCommand Command, int argc, TCHAR* argv[])
+{
+	CommandLine line;
+	int exitCode = 0;
+	if (!ParseCommandLine(Command, argc, argv, line, exitCode))
+	{
+		return exitCode;
+	}
+
+	// Apply the plan of an earlier dry run instead of walking the tree
+	if (!line.ApplyPath.IsEmpty())
+	{
+		return ApplyPlan(Command, line);
+	}
+
+	switch (Command)
+	{
+	case CommandCopy:
+		return CopyLinks(line);
+	case CommandFix:
+		return FixLinks(line);
+	case CommandMove:
+		return MoveLinks(line);
+	default:
+		return RemoveLinks(line);
+	}
+}
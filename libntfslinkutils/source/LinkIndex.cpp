@@ -0,0 +1,536 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LinkIndex.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** Identifies an index file. */
+static const char IndexMagic[8] = { 'N', 'T', 'L', 'N', 'K', 'I', 'D', 'X' };
+/** The version of the index file layout. Bump this whenever the layout changes. */
+static const DWORD IndexVersion = 1;
+
+struct LinkIndex::IndexHeader
+{
+	char Magic[8];
+	DWORD Version;
+	/** The size of a character in the string pool. Indexes written by ANSI and UNICODE builds are not compatible. */
+	DWORD CharSize;
+	DWORD NumDirectories;
+	DWORD NumEntries;
+	DWORD NumStrings;
+	DWORD Reserved;
+};
+
+struct LinkIndex::IndexDirectory
+{
+	ULONGLONG LastWriteTime;
+	/** The offset of the full path of the directory in the string pool. */
+	DWORD PathOffset;
+	/** The index of the first entry of the directory. */
+	DWORD FirstEntry;
+	DWORD NumEntries;
+	DWORD Reserved;
+};
+
+struct LinkIndex::IndexEntry
+{
+	/** The offset of the name of the entry in the string pool. */
+	DWORD NameOffset;
+	DWORD Attributes;
+	DWORD ReparseTag;
+	/** The offset of the target of the entry in the string pool. Offset zero is always the empty string. */
+	DWORD TargetOffset;
+};
+
+namespace
+{
+
+/**
+ * Orders paths the same way that FindDirectory searches them.
+ */
+struct PathLess
+{
+	bool operator()(const LinkIndex::String& A, const LinkIndex::String& B) const
+	{
+		return _tcscmp(A.c_str(), B.c_str()) < 0;
+	}
+};
+
+/**
+ * Appends a null terminated string to the string pool, returning its offset.
+ */
+DWORD AddString(std::vector<TCHAR>& Strings, const LinkIndex::String& Str)
+{
+	if (Str.empty())
+	{
+		return 0;
+	}
+
+	DWORD offset = (DWORD)Strings.size();
+	Strings.insert(Strings.end(), Str.begin(), Str.end());
+	Strings.push_back(0);
+	return offset;
+}
+
+/**
+ * Joins a directory path and the name of one of its entries.
+ */
+LinkIndex::String JoinPath(const LinkIndex::String& Directory, const LinkIndex::String& Name)
+{
+	LinkIndex::String path = Directory;
+	if (!path.empty() && path[path.size() - 1] != PATH_SEPARATOR)
+	{
+		path += PATH_SEPARATOR;
+	}
+
+	return path + Name;
+}
+
+} // namespace
+
+LinkIndex::LinkIndex()
+	: Header(NULL)
+	, Directories(NULL)
+	, Entries(NULL)
+	, Strings(NULL)
+	, MappedSize(0)
+#ifdef _WIN32
+	, hFile(INVALID_HANDLE_VALUE)
+	, hMapping(NULL)
+#else
+	, hFile(-1)
+#endif
+{
+}
+
+LinkIndex::~LinkIndex()
+{
+	Unmap();
+
+	for (size_t i = 0; i < NewDirectories.size(); i++)
+	{
+		delete NewDirectories[i];
+	}
+}
+
+DWORD LinkIndex::Load(LPCTSTR IndexPath)
+{
+	Unmap();
+
+	// Map the entire file read only
+	const void* view = NULL;
+#ifdef _WIN32
+	hFile = CreateFile(IndexPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return GetLastError();
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize))
+	{
+		DWORD result = GetLastError();
+		Unmap();
+		return result;
+	}
+
+	MappedSize = (size_t)fileSize.QuadPart;
+	if (MappedSize >= sizeof(IndexHeader))
+	{
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+		view = hMapping != NULL ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (view == NULL)
+		{
+			DWORD result = GetLastError();
+			MappedSize = 0;
+			Unmap();
+			return result;
+		}
+	}
+#else
+	hFile = open(IndexPath, O_RDONLY);
+	if (hFile < 0)
+	{
+		return GetLastError();
+	}
+
+	struct stat st;
+	if (fstat(hFile, &st) != 0)
+	{
+		DWORD result = GetLastError();
+		Unmap();
+		return result;
+	}
+
+	MappedSize = (size_t)st.st_size;
+	if (MappedSize >= sizeof(IndexHeader))
+	{
+		view = mmap(NULL, MappedSize, PROT_READ, MAP_PRIVATE, hFile, 0);
+		if (view == MAP_FAILED)
+		{
+			DWORD result = GetLastError();
+			MappedSize = 0;
+			Unmap();
+			return result;
+		}
+	}
+#endif
+
+	if (view == NULL)
+	{
+		MappedSize = 0;
+		Unmap();
+		return ERROR_BAD_FORMAT;
+	}
+
+	// Make sure the tables described by the header actually fit in the file
+	Header = (const IndexHeader*)view;
+	ULONGLONG expectedSize = sizeof(IndexHeader) +
+		(ULONGLONG)Header->NumDirectories * sizeof(IndexDirectory) +
+		(ULONGLONG)Header->NumEntries * sizeof(IndexEntry) +
+		(ULONGLONG)Header->NumStrings * sizeof(TCHAR);
+	if (memcmp(Header->Magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+		Header->Version != IndexVersion ||
+		Header->CharSize != sizeof(TCHAR) ||
+		expectedSize > MappedSize ||
+		Header->NumStrings == 0)
+	{
+		Unmap();
+		return ERROR_BAD_FORMAT;
+	}
+
+	Directories = (const IndexDirectory*)(Header + 1);
+	Entries = (const IndexEntry*)(Directories + Header->NumDirectories);
+	Strings = (const TCHAR*)(Entries + Header->NumEntries);
+
+	// Every string in the pool is terminated, including the last one
+	if (Strings[0] != 0 || Strings[Header->NumStrings - 1] != 0)
+	{
+		Unmap();
+		return ERROR_BAD_FORMAT;
+	}
+
+	return 0;
+}
+
+DWORD LinkIndex::Save(LPCTSTR IndexPath)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	// Start with the loaded directories that the walk did not cover, then add everything the walk recorded
+	std::vector<Directory*> carried;
+	std::map<String, const Directory*, PathLess> sorted;
+	if (Header != NULL)
+	{
+		for (DWORD i = 0; i < Header->NumDirectories; i++)
+		{
+			const IndexDirectory& record = Directories[i];
+			if (record.PathOffset >= Header->NumStrings || IsUnderRoot(&Strings[record.PathOffset]))
+			{
+				continue;
+			}
+
+			Directory* directory = new Directory();
+			directory->Path = &Strings[record.PathOffset];
+			directory->LastWriteTime = record.LastWriteTime;
+			for (DWORD j = 0; j < record.NumEntries && record.FirstEntry + j < Header->NumEntries; j++)
+			{
+				Entry entry;
+				ReadEntry(Entries[record.FirstEntry + j], entry);
+				directory->Entries.push_back(entry);
+			}
+
+			carried.push_back(directory);
+			sorted[directory->Path] = directory;
+		}
+	}
+
+	for (size_t i = 0; i < NewDirectories.size(); i++)
+	{
+		sorted[NewDirectories[i]->Path] = NewDirectories[i];
+	}
+
+	// Flatten the directories into the file tables
+	IndexHeader header;
+	memcpy(header.Magic, IndexMagic, sizeof(IndexMagic));
+	header.Version = IndexVersion;
+	header.CharSize = sizeof(TCHAR);
+	header.Reserved = 0;
+
+	std::vector<IndexDirectory> directories;
+	std::vector<IndexEntry> entries;
+	std::vector<TCHAR> strings(1, 0);
+	for (std::map<String, const Directory*, PathLess>::const_iterator it = sorted.begin(); it != sorted.end(); ++it)
+	{
+		const Directory* directory = it->second;
+
+		IndexDirectory record;
+		record.LastWriteTime = directory->LastWriteTime;
+		record.PathOffset = AddString(strings, directory->Path);
+		record.FirstEntry = (DWORD)entries.size();
+		record.NumEntries = (DWORD)directory->Entries.size();
+		record.Reserved = 0;
+		directories.push_back(record);
+
+		for (size_t i = 0; i < directory->Entries.size(); i++)
+		{
+			const Entry& entry = directory->Entries[i];
+
+			// Prefer a target reported during the walk over the one that was recorded
+			const String* target = &entry.Target;
+			if ((entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 && !LinkTargets.empty())
+			{
+				std::map<String, String>::const_iterator found = LinkTargets.find(JoinPath(directory->Path, entry.Name));
+				if (found != LinkTargets.end())
+				{
+					target = &found->second;
+				}
+			}
+
+			IndexEntry entryRecord;
+			entryRecord.NameOffset = AddString(strings, entry.Name);
+			entryRecord.Attributes = entry.Attributes;
+			entryRecord.ReparseTag = entry.ReparseTag;
+			entryRecord.TargetOffset = AddString(strings, *target);
+			entries.push_back(entryRecord);
+		}
+	}
+
+	header.NumDirectories = (DWORD)directories.size();
+	header.NumEntries = (DWORD)entries.size();
+	header.NumStrings = (DWORD)strings.size();
+
+	for (size_t i = 0; i < carried.size(); i++)
+	{
+		delete carried[i];
+	}
+
+	// The loaded file can't be replaced while it is still mapped
+	Unmap();
+
+	// Write the new index beside the old one and swap it in, so a failed write never leaves a truncated index behind
+	String tempPath = String(IndexPath) + TEXT(".tmp");
+	FILE* file = _tfopen(tempPath.c_str(), TEXT("wb"));
+	if (file == NULL)
+	{
+		return GetLastError();
+	}
+
+	bool bWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (bWritten && !directories.empty())
+	{
+		bWritten = fwrite(&directories[0], sizeof(IndexDirectory), directories.size(), file) == directories.size();
+	}
+	if (bWritten && !entries.empty())
+	{
+		bWritten = fwrite(&entries[0], sizeof(IndexEntry), entries.size(), file) == entries.size();
+	}
+	if (bWritten)
+	{
+		bWritten = fwrite(&strings[0], sizeof(TCHAR), strings.size(), file) == strings.size();
+	}
+
+	DWORD result = bWritten ? 0 : GetLastError();
+	if (fclose(file) != 0 && result == 0)
+	{
+		result = GetLastError();
+	}
+
+	if (result == 0)
+	{
+		result = ReplacePath(tempPath.c_str(), IndexPath);
+	}
+
+	return result;
+}
+
+void LinkIndex::AddRoot(LPCTSTR Root)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Roots.push_back(Root);
+}
+
+bool LinkIndex::ReplayDirectory(LPCTSTR Path, ULONGLONG LastWriteTime, EnumerateCallback Callback, void* Context)
+{
+	const IndexDirectory* record = FindDirectory(Path);
+	if (record == NULL || record->LastWriteTime != LastWriteTime ||
+		(ULONGLONG)record->FirstEntry + record->NumEntries > Header->NumEntries)
+	{
+		return false;
+	}
+
+	Directory* directory = new Directory();
+	directory->Path = Path;
+	directory->LastWriteTime = LastWriteTime;
+	directory->Entries.resize(record->NumEntries);
+	for (DWORD i = 0; i < record->NumEntries; i++)
+	{
+		ReadEntry(Entries[record->FirstEntry + i], directory->Entries[i]);
+	}
+
+	// The recorded entries are replayed as a single batch
+	std::vector<DirectoryEntry> dirEntries(directory->Entries.size());
+	for (size_t i = 0; i < directory->Entries.size(); i++)
+	{
+		const Entry& entry = directory->Entries[i];
+		dirEntries[i].Name = entry.Name.c_str();
+		dirEntries[i].Attributes = entry.Attributes;
+		dirEntries[i].ReparseTag = entry.ReparseTag;
+	}
+
+	// Nothing is held open for a replayed directory, so the entries are used by their full paths
+	if (!dirEntries.empty())
+	{
+		DirectoryHandle handle = { Path, INVALID_DIRECTORY_HANDLE };
+		Callback(Context, handle, &dirEntries[0], dirEntries.size());
+	}
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NewDirectories.push_back(directory);
+	return true;
+}
+
+void LinkIndex::AddDirectory(LPCTSTR Path, ULONGLONG LastWriteTime, const std::vector<Entry>& Entries)
+{
+	Directory* directory = new Directory();
+	directory->Path = Path;
+	directory->LastWriteTime = LastWriteTime;
+	directory->Entries = Entries;
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NewDirectories.push_back(directory);
+}
+
+void LinkIndex::SetLinkTarget(LPCTSTR Path, LPCTSTR Target)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	LinkTargets[Path] = Target;
+}
+
+const LinkIndex::IndexDirectory* LinkIndex::FindDirectory(LPCTSTR Path) const
+{
+	if (Header == NULL)
+	{
+		return NULL;
+	}
+
+	// The directories are sorted by path
+	DWORD low = 0;
+	DWORD high = Header->NumDirectories;
+	while (low < high)
+	{
+		DWORD mid = low + (high - low) / 2;
+		const IndexDirectory& record = Directories[mid];
+		if (record.PathOffset >= Header->NumStrings)
+		{
+			return NULL;
+		}
+
+		int cmp = _tcscmp(Path, &Strings[record.PathOffset]);
+		if (cmp == 0)
+		{
+			return &record;
+		}
+		else if (cmp < 0)
+		{
+			high = mid;
+		}
+		else
+		{
+			low = mid + 1;
+		}
+	}
+
+	return NULL;
+}
+
+void LinkIndex::ReadEntry(const IndexEntry& Record, Entry& Result) const
+{
+	Result.Name = Record.NameOffset < Header->NumStrings ? &Strings[Record.NameOffset] : TEXT("");
+	Result.Attributes = Record.Attributes;
+	Result.ReparseTag = Record.ReparseTag;
+	Result.Target = Record.TargetOffset < Header->NumStrings ? &Strings[Record.TargetOffset] : TEXT("");
+}
+
+bool LinkIndex::IsUnderRoot(LPCTSTR Path) const
+{
+	for (size_t i = 0; i < Roots.size(); i++)
+	{
+		const String& root = Roots[i];
+		if (_tcsncmp(Path, root.c_str(), root.size()) == 0 &&
+			(Path[root.size()] == 0 || Path[root.size()] == PATH_SEPARATOR || root[root.size() - 1] == PATH_SEPARATOR))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LinkIndex::Unmap()
+{
+#ifdef _WIN32
+	if (Header != NULL)
+	{
+		UnmapViewOfFile(Header);
+	}
+	if (hMapping != NULL)
+	{
+		CloseHandle(hMapping);
+		hMapping = NULL;
+	}
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(hFile);
+		hFile = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (Header != NULL)
+	{
+		munmap((void*)Header, MappedSize);
+	}
+	if (hFile >= 0)
+	{
+		close(hFile);
+		hFile = -1;
+	}
+#endif
+
+	Header = NULL;
+	Directories = NULL;
+	Entries = NULL;
+	Strings = NULL;
+	MappedSize = 0;
+}
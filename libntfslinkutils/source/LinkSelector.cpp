@@ -0,0 +1,296 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LinkSelector.h"
+
+#include "FileSystem.h"
+
+#include <vector>
+
+namespace
+{
+
+typedef std::basic_string<TCHAR> String;
+
+/**
+ * Returns true if the given character separates path components.
+ */
+bool IsSeparator(TCHAR c)
+{
+#ifdef _WIN32
+	return c == '\\' || c == '/';
+#else
+	return c == '/';
+#endif
+}
+
+/**
+ * Folds a character for comparison. NTFS names are compared without regard to case, POSIX names are not.
+ */
+TCHAR FoldCase(TCHAR c)
+{
+#ifdef _WIN32
+	return (TCHAR)_totlower(c);
+#else
+	return c;
+#endif
+}
+
+/**
+ * Returns a folded copy of the given string.
+ */
+String Fold(const String& Text)
+{
+	String folded(Text);
+	for (size_t i = 0; i < folded.size(); i++)
+	{
+		folded[i] = FoldCase(folded[i]);
+	}
+
+	return folded;
+}
+
+/**
+ * Returns true if the given target is a full path rather than one relative to the directory of its link.
+ */
+bool IsFullPath(LPCTSTR Target)
+{
+#ifdef _WIN32
+	return IsSeparator(Target[0]) || (Target[0] != 0 && Target[1] == ':');
+#else
+	return Target[0] == '/';
+#endif
+}
+
+/**
+ * Resolves a target to a full path that can be queried, without touching the file system. A relative target is
+ * joined to the directory of its link, '.' and '..' components are collapsed and trailing separators are removed. On
+ * Windows the native "\??\" prefix of junction targets is swapped for the "\\?\" prefix that the Win32 API accepts.
+ *
+ * @param LinkPath The full path of the link.
+ * @param Target The target of the link.
+ * @param Result The resolved target. [OUT]
+ */
+void ResolveTarget(LPCTSTR LinkPath, LPCTSTR Target, String& Result)
+{
+	String joined;
+	if (IsFullPath(Target))
+	{
+		joined = Target;
+	}
+	else
+	{
+		joined = LinkPath;
+		size_t end = joined.size();
+		while (end > 0 && !IsSeparator(joined[end - 1]))
+		{
+			end--;
+		}
+		joined.resize(end);
+		joined.append(Target);
+	}
+
+	// Keep everything up to and including the first separator of a full path, such as "/", "C:\" or "\\?\C:\"
+	size_t rootLength = 0;
+#ifdef _WIN32
+	if (joined.compare(0, 4, TEXT("\\??\\")) == 0)
+	{
+		joined[1] = '\\';
+	}
+	if (joined.compare(0, 4, TEXT("\\\\?\\")) == 0)
+	{
+		rootLength = 4;
+	}
+	size_t colon = joined.find(':', rootLength);
+	if (colon != String::npos && colon == rootLength + 1)
+	{
+		rootLength = colon + 1;
+	}
+#endif
+	if (rootLength < joined.size() && IsSeparator(joined[rootLength]))
+	{
+		rootLength++;
+	}
+
+	// Collapse the remaining components
+	std::vector<String> components;
+	size_t start = rootLength;
+	while (start < joined.size())
+	{
+		size_t end = start;
+		while (end < joined.size() && !IsSeparator(joined[end]))
+		{
+			end++;
+		}
+
+		String component = joined.substr(start, end - start);
+		if (component == TEXT(".."))
+		{
+			if (!components.empty())
+			{
+				components.pop_back();
+			}
+		}
+		else if (!component.empty() && component != TEXT("."))
+		{
+			components.push_back(component);
+		}
+
+		start = end + 1;
+	}
+
+	Result.assign(joined, 0, rootLength);
+	for (size_t i = 0; i < components.size(); i++)
+	{
+		if (i > 0)
+		{
+			Result.push_back(PATH_SEPARATOR);
+		}
+		Result.append(components[i]);
+	}
+}
+
+/**
+ * EnumerateDirectory callback that collects the folded names of the entries.
+ */
+void AddNames(void* Context, const DirectoryHandle& /*Directory*/, const DirectoryEntry* Entries, size_t NumEntries)
+{
+	std::set<String>* names = (std::set<String>*)Context;
+	for (size_t i = 0; i < NumEntries; i++)
+	{
+		names->insert(Fold(Entries[i].Name));
+	}
+}
+
+} // namespace
+
+LinkSelector::LinkSelector()
+	: bDangling(false)
+{
+}
+
+void LinkSelector::AddTargetRoot(LPCTSTR Root)
+{
+	Roots.AddRoot(Root, Root);
+}
+
+bool LinkSelector::IsSelected(LPCTSTR Path, LPCTSTR Target) const
+{
+	String target;
+	ResolveTarget(Path, Target, target);
+
+	if (!Roots.IsEmpty() && !Roots.Contains(target.c_str()))
+	{
+		return false;
+	}
+
+	return !bDangling || !TargetExists(target.c_str());
+}
+
+/**
+ * Determines if a resolved target exists by looking its name up among the entries of its directory, enumerating the
+ * directory the first time any of its entries is asked about.
+ */
+bool LinkSelector::TargetExists(LPCTSTR Target) const
+{
+	LPCTSTR name = Target;
+	for (LPCTSTR c = Target; *c != 0; c++)
+	{
+		if (IsSeparator(*c))
+		{
+			name = c + 1;
+		}
+	}
+
+	// A root has no directory to look in
+	DWORD attributes = 0;
+	if (*name == 0 || name == Target)
+	{
+		return GetPathAttributes(Target, attributes) == 0;
+	}
+
+	// Keep the separator when the directory is itself a root
+	String directory(Target, name - Target - 1);
+	if (directory.empty() || IsSeparator(directory[directory.size() - 1]) || directory[directory.size() - 1] == ':')
+	{
+		directory.assign(Target, name - Target);
+	}
+
+	String key = Fold(directory);
+	DirectoryNames* names = NULL;
+	bool bLoad = false;
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		std::map<String, DirectoryNames>::iterator it = Directories.find(key);
+		if (it != Directories.end())
+		{
+			// Another thread may still be enumerating the directory
+			names = &it->second;
+			while (!names->bLoaded)
+			{
+				Loaded.wait(lock);
+			}
+		}
+		else
+		{
+			names = &Directories[key];
+			names->bLoaded = false;
+			names->bReadable = false;
+			names->bMissing = false;
+			bLoad = true;
+		}
+	}
+
+	if (bLoad)
+	{
+		// Enumerate outside the lock. Entries of a map never move, so the pointer stays valid.
+		std::set<String> found;
+		DWORD result = EnumerateDirectory(directory.c_str(), AddNames, &found);
+
+		std::lock_guard<std::mutex> lock(Lock);
+		names->Names.swap(found);
+		names->bReadable = result == 0;
+		names->bMissing = result == ERROR_FILE_NOT_FOUND || result == ERROR_PATH_NOT_FOUND;
+		names->bLoaded = true;
+		Loaded.notify_all();
+	}
+
+	if (names->bMissing)
+	{
+		return false;
+	}
+	else if (!names->bReadable)
+	{
+		// Never take a target for missing just because its directory couldn't be read
+		DWORD result = GetPathAttributes(Target, attributes);
+		return result != ERROR_FILE_NOT_FOUND && result != ERROR_PATH_NOT_FOUND;
+	}
+
+	return names->Names.count(Fold(name)) != 0;
+}
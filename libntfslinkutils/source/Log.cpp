@@ -0,0 +1,687 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Log.h"
+
+#include "Json.h"
+#include "Metrics.h"
+#include "PathBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdarg.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+typedef std::basic_string<TCHAR> String;
+
+/**
+ * Collects the output of every thread and writes it to the standard output from a background thread.
+ *
+ * Each thread that logs is given its own ring buffer, so logging a message that fits in it never takes a lock. The
+ * owning thread is the only one that appends to a buffer and publishes each message once it is complete, and only the
+ * holder of OutputLock removes from it, so messages are never split or interleaved. The writer drains every buffer at
+ * a fixed interval, or sooner once a buffer is half full. A thread that finds its buffer full waits for the writer to
+ * catch up, or drains the buffers itself if the writer has been stopped. A message longer than a buffer is written
+ * straight to the standard output while holding OutputLock, once everything logged before it has been written.
+ *
+ * The writer is started by the first write after the sink was created or stopped.
+ *
+ * Buffers are handed back when their thread exits and reused by the next new thread once they have been drained.
+ * Stopping the sink frees the buffers that were handed back along with the buffer of the thread that stopped it.
+ */
+class LogSink
+{
+public:
+	LogSink()
+		: BufferKey(FlsAlloc(&LogSink::ReleaseBuffer))
+		, WriterThread(NULL)
+		, bWriterRunning(false)
+		, bStopping(false)
+	{
+	}
+
+	~LogSink()
+	{
+		// The buffers are deliberately not freed, the exit of a thread may still hand one back after this
+		Stop();
+	}
+
+	/**
+	 * Adds text to the calling thread's buffer.
+	 */
+	void Write(LPCTSTR Text, size_t Length)
+	{
+		Buffer* buffer = GetBuffer();
+		if (buffer == NULL || Length > BufferSize)
+		{
+			// Wait for the thread's earlier messages to be written first so that they stay in order
+			if (buffer != NULL)
+			{
+				WaitForSpace(buffer, BufferSize);
+			}
+
+			std::lock_guard<std::mutex> lock(OutputLock);
+			Drain();
+			_fputts(Text, stdout);
+			fflush(stdout);
+			return;
+		}
+
+		size_t head = WaitForSpace(buffer, Length);
+		size_t start = head % BufferSize;
+		size_t first = Length < BufferSize - start ? Length : BufferSize - start;
+		memcpy(&buffer->Text[start], Text, first * sizeof(TCHAR));
+		memcpy(&buffer->Text[0], Text + first, (Length - first) * sizeof(TCHAR));
+		buffer->Head.store(head + Length, std::memory_order_release);
+
+		if (!bWriterRunning.load(std::memory_order_acquire))
+		{
+			StartWriter();
+		}
+		else if (head + Length - buffer->Tail.load(std::memory_order_relaxed) > BufferSize / 2)
+		{
+			WakeSignal.notify_one();
+		}
+	}
+
+	/**
+	 * Writes out everything that has been logged so far.
+	 */
+	void Flush()
+	{
+		std::lock_guard<std::mutex> lock(OutputLock);
+		Drain();
+	}
+
+	/**
+	 * Writes out everything that has been logged and stops the writer. The writer is started again by the next write.
+	 * The buffer of the calling thread is freed, and a new one is taken if it logs again.
+	 */
+	void Stop()
+	{
+		// Only one thread stops the writer at a time. The writer stays registered until it has exited, so that a write
+		// in the meantime doesn't start another one that would see bStopping.
+		std::lock_guard<std::mutex> stopLock(StopLock);
+		std::thread* writerThread = NULL;
+		{
+			std::lock_guard<std::mutex> lock(BuffersLock);
+			writerThread = WriterThread;
+		}
+
+		if (writerThread != NULL)
+		{
+			{
+				std::lock_guard<std::mutex> lock(WakeLock);
+				bStopping = true;
+			}
+			WakeSignal.notify_all();
+			writerThread->join();
+			delete writerThread;
+			{
+				std::lock_guard<std::mutex> lock(WakeLock);
+				bStopping = false;
+			}
+
+			std::lock_guard<std::mutex> lock(BuffersLock);
+			WriterThread = NULL;
+			bWriterRunning.store(false, std::memory_order_release);
+		}
+
+		Flush();
+		DeleteIdleBuffers();
+	}
+
+private:
+	/** The number of characters held by each buffer. */
+	enum { BufferSize = 16 * 1024 };
+
+	/** The number of milliseconds between each time the writer drains the buffers. */
+	enum { WriteInterval = 50 };
+
+	struct Buffer
+	{
+		/** The total number of characters ever appended. Only changed by the owning thread. */
+		std::atomic<size_t> Head;
+		/** The total number of characters ever written out. Only changed while holding OutputLock. */
+		std::atomic<size_t> Tail;
+		/** Set once the owning thread has exited. */
+		std::atomic<bool> bReleased;
+		TCHAR Text[BufferSize];
+	};
+
+	/**
+	 * Returns the buffer of the calling thread, taking one the first time the thread logs. Returns NULL if there is
+	 * no thread local storage to remember it in.
+	 */
+	Buffer* GetBuffer()
+	{
+		if (BufferKey == FLS_OUT_OF_INDEXES)
+		{
+			return NULL;
+		}
+
+		Buffer* buffer = (Buffer*)FlsGetValue(BufferKey);
+		if (buffer != NULL)
+		{
+			return buffer;
+		}
+
+		std::lock_guard<std::mutex> lock(BuffersLock);
+		if (!FreeBuffers.empty())
+		{
+			buffer = FreeBuffers.back();
+			FreeBuffers.pop_back();
+		}
+		else
+		{
+			buffer = new Buffer();
+			buffer->Head = 0;
+			buffer->Tail = 0;
+		}
+		buffer->bReleased = false;
+		Buffers.push_back(buffer);
+
+		FlsSetValue(BufferKey, buffer);
+		return buffer;
+	}
+
+	/**
+	 * Starts the writer if it isn't already running.
+	 */
+	void StartWriter()
+	{
+		std::lock_guard<std::mutex> lock(BuffersLock);
+		if (WriterThread == NULL)
+		{
+			WriterThread = new std::thread(&LogSink::WriterMain, this);
+			bWriterRunning.store(true, std::memory_order_release);
+		}
+	}
+
+	/**
+	 * Waits until the buffer has room for the given number of characters. The buffers are drained by the calling
+	 * thread if there is no writer to do so.
+	 *
+	 * @return Returns the head of the buffer.
+	 */
+	size_t WaitForSpace(Buffer* Buffer, size_t Length)
+	{
+		size_t head = Buffer->Head.load(std::memory_order_relaxed);
+		while (head + Length - Buffer->Tail.load(std::memory_order_acquire) > BufferSize)
+		{
+			if (!bWriterRunning.load(std::memory_order_acquire))
+			{
+				Flush();
+			}
+			else
+			{
+				WakeSignal.notify_one();
+				std::this_thread::yield();
+			}
+		}
+
+		return head;
+	}
+
+	/**
+	 * Writes out the contents of every buffer. Must be called while holding OutputLock.
+	 */
+	void Drain()
+	{
+		{
+			std::lock_guard<std::mutex> lock(BuffersLock);
+			Draining = Buffers;
+		}
+
+		bool bWritten = false;
+		for (size_t i = 0; i < Draining.size(); i++)
+		{
+			Buffer* buffer = Draining[i];
+
+			// Check for release first, anything the thread wrote before exiting is then sure to be seen
+			bool bReleased = buffer->bReleased.load(std::memory_order_acquire);
+			size_t tail = buffer->Tail.load(std::memory_order_relaxed);
+			size_t head = buffer->Head.load(std::memory_order_acquire);
+			if (head != tail)
+			{
+				size_t start = tail % BufferSize;
+				size_t length = head - tail;
+				size_t first = length < BufferSize - start ? length : BufferSize - start;
+				Text.assign(&buffer->Text[start], first);
+				Text.append(&buffer->Text[0], length - first);
+				_fputts(Text.c_str(), stdout);
+				buffer->Tail.store(head, std::memory_order_release);
+				bWritten = true;
+			}
+
+			if (bReleased)
+			{
+				Recycle(buffer);
+			}
+		}
+
+		if (bWritten)
+		{
+			fflush(stdout);
+		}
+	}
+
+	/**
+	 * Frees the buffer of the calling thread and every buffer on the free list. The buffers must have been drained.
+	 */
+	void DeleteIdleBuffers()
+	{
+		Buffer* ownBuffer = NULL;
+		if (BufferKey != FLS_OUT_OF_INDEXES)
+		{
+			ownBuffer = (Buffer*)FlsGetValue(BufferKey);
+			FlsSetValue(BufferKey, NULL);
+		}
+
+		// No drain may be looking at the buffers while they are freed
+		std::lock_guard<std::mutex> outputLock(OutputLock);
+		std::lock_guard<std::mutex> lock(BuffersLock);
+		if (ownBuffer != NULL)
+		{
+			std::vector<Buffer*>::iterator own = std::find(Buffers.begin(), Buffers.end(), ownBuffer);
+			if (own != Buffers.end())
+			{
+				Buffers.erase(own);
+			}
+			delete ownBuffer;
+		}
+
+		for (size_t i = 0; i < FreeBuffers.size(); i++)
+		{
+			delete FreeBuffers[i];
+		}
+		FreeBuffers.clear();
+	}
+
+	/**
+	 * Moves an empty buffer whose thread has exited to the free list.
+	 */
+	void Recycle(Buffer* Buffer)
+	{
+		std::lock_guard<std::mutex> lock(BuffersLock);
+		for (size_t i = 0; i < Buffers.size(); i++)
+		{
+			if (Buffers[i] == Buffer)
+			{
+				Buffers.erase(Buffers.begin() + i);
+				FreeBuffers.push_back(Buffer);
+				break;
+			}
+		}
+	}
+
+	void WriterMain()
+	{
+		std::unique_lock<std::mutex> lock(WakeLock);
+		while (!bStopping)
+		{
+			WakeSignal.wait_for(lock, std::chrono::milliseconds(WriteInterval));
+
+			lock.unlock();
+			Flush();
+			lock.lock();
+		}
+	}
+
+	/**
+	 * Called when a thread that took a buffer exits.
+	 */
+	static void WINAPI ReleaseBuffer(void* Data)
+	{
+		if (Data != NULL)
+		{
+			((Buffer*)Data)->bReleased.store(true, std::memory_order_release);
+		}
+	}
+
+	/** The thread local storage slot holding the buffer of each thread. */
+	DWORD BufferKey;
+
+	std::mutex BuffersLock;
+	/** The buffers that belong to a thread or still hold text. */
+	std::vector<Buffer*> Buffers;
+	/** The buffers that are ready to be given to a new thread. */
+	std::vector<Buffer*> FreeBuffers;
+
+	/** Held while writing to the standard output. */
+	std::mutex OutputLock;
+	/** The buffers being drained and the text being written. Only used while holding OutputLock. */
+	std::vector<Buffer*> Draining;
+	String Text;
+
+	std::thread* WriterThread;
+	/** Set while WriterThread is running. Read without a lock by each write. */
+	std::atomic<bool> bWriterRunning;
+	/** Held while stopping the writer. */
+	std::mutex StopLock;
+	std::mutex WakeLock;
+	std::condition_variable WakeSignal;
+	bool bStopping;
+};
+
+/** Where all output is written. */
+LogSink Sink;
+
+/**
+ * Writes the periodic progress records of a tool while JSON output is enabled.
+ */
+class JsonOutput
+{
+public:
+	JsonOutput(ProgressCallback Callback, int IntervalMs)
+		: Callback(Callback)
+		, IntervalMs(IntervalMs > 0 ? IntervalMs : 1000)
+		, StartTime(std::chrono::steady_clock::now())
+		, LastTime(StartTime)
+		, LastProcessed(0)
+		, bStopping(false)
+	{
+		ProgressThread = new std::thread(&JsonOutput::ProgressMain, this);
+	}
+
+	~JsonOutput()
+	{
+		{
+			std::lock_guard<std::mutex> lock(StopLock);
+			bStopping = true;
+		}
+		StopSignal.notify_all();
+		ProgressThread->join();
+		delete ProgressThread;
+	}
+
+	/** Returns the number of milliseconds since the output was started. */
+	ULONGLONG GetElapsedMs() const
+	{
+		return (ULONGLONG)std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - StartTime).count();
+	}
+
+private:
+	void ProgressMain()
+	{
+		std::unique_lock<std::mutex> lock(StopLock);
+		while (!bStopping)
+		{
+			StopSignal.wait_for(lock, std::chrono::milliseconds(IntervalMs));
+			if (!bStopping)
+			{
+				WriteProgress();
+			}
+		}
+	}
+
+	void WriteProgress()
+	{
+		LogProgress progress = { 0, 0, 0, 0 };
+		Callback(progress);
+
+		// The rate covers the time since the previous record, so that a slowdown shows up straight away
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		ULONGLONG intervalMs = (ULONGLONG)std::chrono::duration_cast<std::chrono::milliseconds>(now - LastTime).count();
+		ULONGLONG rate = 0;
+		if (intervalMs > 0 && progress.NumProcessed > LastProcessed)
+		{
+			rate = (progress.NumProcessed - LastProcessed) * 1000 / intervalMs;
+		}
+		LastTime = now;
+		LastProcessed = progress.NumProcessed;
+
+		String record;
+		AppendJsonMember(record, TEXT("type"), TEXT("progress"));
+		AppendJsonMember(record, TEXT("elapsed_ms"), GetElapsedMs());
+		AppendJsonMember(record, TEXT("scanned"), progress.NumScanned);
+		AppendJsonMember(record, TEXT("processed"), progress.NumProcessed);
+		AppendJsonMember(record, TEXT("rate"), rate);
+		AppendJsonMember(record, TEXT("failed"), progress.NumFailed);
+		AppendJsonMember(record, TEXT("depth"), (ULONGLONG)progress.Depth);
+		record.append(TEXT("}\n"));
+
+		// Progress records are written straight away so that whoever is watching sees them on time
+		Sink.Write(record.c_str(), record.size());
+		Sink.Flush();
+	}
+
+	ProgressCallback Callback;
+	int IntervalMs;
+	std::chrono::steady_clock::time_point StartTime;
+	std::chrono::steady_clock::time_point LastTime;
+	ULONGLONG LastProcessed;
+
+	std::thread* ProgressThread;
+	std::mutex StopLock;
+	std::condition_variable StopSignal;
+	bool bStopping;
+};
+
+/** The JSON output, or NULL when printing text. Only changed while no other thread is logging. */
+JsonOutput* Output = NULL;
+
+/**
+ * Returns a short description of the given error code, or NULL if there is none.
+ */
+LPCTSTR GetErrorMessage(DWORD ErrorCode)
+{
+	switch (ErrorCode)
+	{
+	case ERROR_FILE_NOT_FOUND: return TEXT("File not found");
+	case ERROR_PATH_NOT_FOUND: return TEXT("Path not found");
+	case ERROR_ACCESS_DENIED: return TEXT("Access denied");
+	case ERROR_FILENAME_EXCED_RANGE: return TEXT("Path too long");
+	}
+
+	return NULL;
+}
+
+/**
+ * Writes a message as is, or as a message record when JSON output is enabled.
+ */
+void WriteMessage(LPTSTR Text)
+{
+	if (Output == NULL)
+	{
+		Sink.Write(Text, _tcslen(Text));
+		return;
+	}
+
+	size_t length = _tcslen(Text);
+	while (length > 0 && (Text[length - 1] == '\n' || Text[length - 1] == '\r'))
+	{
+		Text[--length] = 0;
+	}
+
+	String record;
+	AppendJsonMember(record, TEXT("type"), TEXT("message"));
+	AppendJsonMember(record, TEXT("text"), Text);
+	record.append(TEXT("}\n"));
+	Sink.Write(record.c_str(), record.size());
+}
+
+} // namespace
+
+void PrintErrorMessage(DWORD ErrorCode, LPCTSTR Path)
+{
+	LPCTSTR message = GetErrorMessage(ErrorCode);
+	if (Output == NULL)
+	{
+		if (message != NULL)
+		{
+			LogMessage(TEXT("%s: %s.\n"), message, Path);
+		}
+		return;
+	}
+
+	String record;
+	AppendJsonMember(record, TEXT("type"), TEXT("error"));
+	AppendJsonMember(record, TEXT("code"), (ULONGLONG)ErrorCode);
+	AppendJsonMember(record, TEXT("message"), message);
+	AppendJsonMember(record, TEXT("path"), Path);
+	record.append(TEXT("}\n"));
+	Sink.Write(record.c_str(), record.size());
+}
+
+void LogMessage(LPCTSTR Format, ...)
+{
+	// Most messages fit on the stack. Those that don't are formatted again into room for a few of the longest paths.
+	TCHAR text[1024];
+	va_list args;
+	va_start(args, Format);
+	HRESULT result = StringCchVPrintf(text, ARRAYSIZE(text), Format, args);
+	va_end(args);
+
+	if (result != STRSAFE_E_INSUFFICIENT_BUFFER)
+	{
+		WriteMessage(text);
+		return;
+	}
+
+	std::vector<TCHAR> large(MAX_LONG_PATH * 3 + 256);
+	va_start(args, Format);
+	StringCchVPrintf(&large[0], large.size(), Format, args);
+	va_end(args);
+	WriteMessage(&large[0]);
+}
+
+void LogSummary(LPCTSTR Label, size_t NumSucceeded, size_t NumSkipped, size_t NumFailed)
+{
+	// Everything the workers logged comes before the summary
+	Sink.Flush();
+
+	if (Output == NULL)
+	{
+		LogMessage(TEXT("%s: %d\n"), Label, (int)NumSucceeded);
+		LogMessage(TEXT("Skipped: %d\n"), (int)NumSkipped);
+		LogMessage(TEXT("Failed: %d\n"), (int)NumFailed);
+		Sink.Flush();
+		return;
+	}
+
+	// Member names are lower case
+	String name(Label);
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		if (name[i] >= 'A' && name[i] <= 'Z')
+		{
+			name[i] = (TCHAR)(name[i] - 'A' + 'a');
+		}
+	}
+
+	String record;
+	AppendJsonMember(record, TEXT("type"), TEXT("summary"));
+	AppendJsonMember(record, name.c_str(), (ULONGLONG)NumSucceeded);
+	AppendJsonMember(record, TEXT("skipped"), (ULONGLONG)NumSkipped);
+	AppendJsonMember(record, TEXT("failed"), (ULONGLONG)NumFailed);
+	AppendJsonMember(record, TEXT("elapsed_ms"), Output->GetElapsedMs());
+	record.append(TEXT("}\n"));
+	Sink.Write(record.c_str(), record.size());
+	Sink.Flush();
+}
+
+void LogStats()
+{
+	Sink.Flush();
+
+	// The first column is as wide as the longest operation name
+	int nameWidth = (int)_tcslen(TEXT("Stats"));
+	for (int i = 0; i < NumMetricOperations; i++)
+	{
+		int length = (int)_tcslen(GetMetricName((MetricOperation)i));
+		nameWidth = length > nameWidth ? length : nameWidth;
+	}
+
+	if (Output == NULL)
+	{
+		LogMessage(TEXT("%-*s %10s %12s %10s %10s %10s %10s %10s\n"), nameWidth, TEXT("Stats"), TEXT("Count"),
+			TEXT("Total ms"), TEXT("Mean us"), TEXT("p50 us"), TEXT("p90 us"), TEXT("p99 us"), TEXT("Max us"));
+	}
+
+	for (int i = 0; i < NumMetricOperations; i++)
+	{
+		MetricSummary summary;
+		GetMetricSummary((MetricOperation)i, summary);
+		if (summary.Count == 0)
+		{
+			continue;
+		}
+
+		LPCTSTR name = GetMetricName((MetricOperation)i);
+		ULONGLONG meanNs = summary.TotalNs / summary.Count;
+		if (Output == NULL)
+		{
+			LogMessage(TEXT("%-*s %10llu %12.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n"), nameWidth, name,
+				summary.Count, summary.TotalNs / 1e6, meanNs / 1e3, summary.P50Ns / 1e3, summary.P90Ns / 1e3, summary.P99Ns / 1e3,
+				summary.MaxNs / 1e3);
+			continue;
+		}
+
+		String record;
+		AppendJsonMember(record, TEXT("type"), TEXT("stats"));
+		AppendJsonMember(record, TEXT("operation"), name);
+		AppendJsonMember(record, TEXT("count"), summary.Count);
+		AppendJsonMember(record, TEXT("total_ns"), summary.TotalNs);
+		AppendJsonMember(record, TEXT("mean_ns"), meanNs);
+		AppendJsonMember(record, TEXT("p50_ns"), summary.P50Ns);
+		AppendJsonMember(record, TEXT("p90_ns"), summary.P90Ns);
+		AppendJsonMember(record, TEXT("p99_ns"), summary.P99Ns);
+		AppendJsonMember(record, TEXT("max_ns"), summary.MaxNs);
+		record.append(TEXT("}\n"));
+		Sink.Write(record.c_str(), record.size());
+	}
+
+	Sink.Flush();
+}
+
+void StartJsonOutput(ProgressCallback Callback, int IntervalMs)
+{
+	if (Output == NULL)
+	{
+		Output = new JsonOutput(Callback, IntervalMs);
+	}
+}
+
+void CloseLog()
+{
+	delete Output;
+	Output = NULL;
+
+	Sink.Stop();
+}
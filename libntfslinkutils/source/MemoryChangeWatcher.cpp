@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryChangeWatcher.h"
+
+#include "MemoryFileSystem.h"
+
+MemoryChangeWatcher::MemoryChangeWatcher(MemoryFileSystem& FileSystem)
+	: FileSystem(FileSystem)
+	, bStopped(false)
+{
+	FileSystem.AddWatcher(this);
+}
+
+MemoryChangeWatcher::~MemoryChangeWatcher()
+{
+	FileSystem.RemoveWatcher(this);
+}
+
+DWORD MemoryChangeWatcher::WatchDirectory(LPCTSTR Path)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Directories.insert(Path);
+	return 0;
+}
+
+DWORD MemoryChangeWatcher::WaitForChanges(std::vector<String>& Paths)
+{
+	Paths.clear();
+
+	std::unique_lock<std::mutex> lock(Lock);
+	while (Pending.empty() && !bStopped)
+	{
+		Changed.wait(lock);
+	}
+
+	if (bStopped)
+	{
+		return ERROR_OPERATION_ABORTED;
+	}
+
+	Paths.swap(Pending);
+	return 0;
+}
+
+void MemoryChangeWatcher::Stop()
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	bStopped = true;
+	Changed.notify_all();
+}
+
+void MemoryChangeWatcher::AddChange(const String& Path)
+{
+	size_t separator = Path.rfind(PATH_SEPARATOR);
+	if (separator == String::npos)
+	{
+		return;
+	}
+
+	// The parent is either named without a trailing separator or is a root that keeps one, like 'C:\' or '/'
+	std::lock_guard<std::mutex> lock(Lock);
+	if (Directories.count(Path.substr(0, separator)) != 0 || Directories.count(Path.substr(0, separator + 1)) != 0)
+	{
+		Pending.push_back(Path);
+		Changed.notify_all();
+	}
+}
@@ -0,0 +1,526 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MemoryFileSystem.h"
+
+#include "MemoryChangeWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace libntfslinks;
+
+MemoryFileSystem::MemoryFileSystem()
+	: Clock(0)
+	, NumOperations(0)
+{
+	SetLatency(0);
+}
+
+DWORD MemoryFileSystem::AddDirectory(LPCTSTR Path)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	if (Nodes.find(Path) != Nodes.end())
+	{
+		return ERROR_ALREADY_EXISTS;
+	}
+
+	Node& node = Nodes[Path];
+	node.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+	node.Tag = 0;
+	node.WriteTime = ++Clock;
+
+	return 0;
+}
+
+void MemoryFileSystem::SetLatency(MetricOperation Operation, DWORD Microseconds)
+{
+	Latency[Operation] = Microseconds;
+}
+
+void MemoryFileSystem::SetLatency(DWORD Microseconds)
+{
+	for (int i = 0; i < NumMetricOperations; i++)
+	{
+		Latency[i] = Microseconds;
+	}
+}
+
+void MemoryFileSystem::AddWatcher(MemoryChangeWatcher* Watcher)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Watchers.push_back(Watcher);
+}
+
+void MemoryFileSystem::RemoveWatcher(MemoryChangeWatcher* Watcher)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Watchers.erase(std::remove(Watchers.begin(), Watchers.end(), Watcher), Watchers.end());
+}
+
+DWORD MemoryFileSystem::GetAttributes(LPCTSTR Path, DWORD& Attributes)
+{
+	Delay(MetricQuery);
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NodeMap::const_iterator node = Nodes.find(Path);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	Attributes = node->second.Attributes;
+	return 0;
+}
+
+DWORD MemoryFileSystem::GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time)
+{
+	Delay(MetricQuery);
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NodeMap::const_iterator node = Nodes.find(Path);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	Time = node->second.WriteTime;
+	return 0;
+}
+
+DWORD MemoryFileSystem::Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context)
+{
+	Delay(MetricEnumerate);
+
+	// Take a copy of the entries so that the callback is free to change the tree
+	std::vector<String> names;
+	std::vector<DirectoryEntry> entries;
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		NodeMap::const_iterator dir = Nodes.find(Path);
+		if (dir == Nodes.end())
+		{
+			return ERROR_PATH_NOT_FOUND;
+		}
+		else if ((dir->second.Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 ||
+			(dir->second.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+		{
+			return ERROR_DIRECTORY;
+		}
+
+		String childPath(Path);
+		if (childPath.empty() || childPath[childPath.size() - 1] != PATH_SEPARATOR)
+		{
+			childPath.push_back(PATH_SEPARATOR);
+		}
+		size_t length = childPath.size();
+
+		names.assign(dir->second.Children.begin(), dir->second.Children.end());
+		entries.resize(names.size());
+		for (size_t i = 0; i < names.size(); i++)
+		{
+			childPath.resize(length);
+			childPath.append(names[i]);
+			const Node& child = Nodes.find(childPath)->second;
+			entries[i].Attributes = child.Attributes;
+			entries[i].ReparseTag = child.Tag;
+		}
+	}
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i].Name = names[i].c_str();
+	}
+
+	// The whole directory is handed on as a single batch. There is nothing to hold open, but the directory is reported
+	// as open so that the engines name its entries relative to it and go through the *At methods, as they do on disk.
+	if (!entries.empty())
+	{
+		DirectoryHandle directory = { Path, 0 };
+		Callback(Context, directory, &entries[0], entries.size());
+	}
+
+	return 0;
+}
+
+DWORD MemoryFileSystem::ReadLink(LPCTSTR Path, ReparsePointInfo& Info)
+{
+	Delay(MetricRead);
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NodeMap::const_iterator node = Nodes.find(Path);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+	else if (node->second.Tag == 0)
+	{
+		return ERROR_NOT_A_REPARSE_POINT;
+	}
+
+	Info.Tag = node->second.Tag;
+	DWORD result = Info.Target.Assign(node->second.Target.c_str(), node->second.Target.size());
+	if (result == 0)
+	{
+		Info.PrintName = Info.Target;
+	}
+
+	return result;
+}
+
+DWORD MemoryFileSystem::ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, ReparsePointInfo& Info)
+{
+	PathBuffer path;
+	DWORD result = CombinePath(path, Directory.Path, Name);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return ReadLink(path.Get(), Info);
+}
+
+DWORD MemoryFileSystem::CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	Delay(MetricCreate);
+
+	// NTFS reports a junction as a directory as well as a reparse point
+	Node link;
+	link.Attributes = Tag == IO_REPARSE_TAG_MOUNT_POINT ? FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT :
+		FILE_ATTRIBUTE_REPARSE_POINT;
+	link.Tag = Tag == IO_REPARSE_TAG_MOUNT_POINT ? IO_REPARSE_TAG_MOUNT_POINT : IO_REPARSE_TAG_SYMLINK;
+	link.Target = Target;
+
+	return AddNode(Path, link);
+}
+
+DWORD MemoryFileSystem::SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	Delay(MetricModify);
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NodeMap::iterator node = Nodes.find(Path);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+	else if (node->second.Tag != Tag)
+	{
+		return ERROR_NOT_A_REPARSE_POINT;
+	}
+
+	node->second.Target = Target;
+	node->second.WriteTime = ++Clock;
+	NotifyChange(node->first);
+	return 0;
+}
+
+DWORD MemoryFileSystem::SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target)
+{
+	PathBuffer path;
+	DWORD result = CombinePath(path, Directory.Path, Name);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return SetLinkTarget(Tag, path.Get(), Target);
+}
+
+DWORD MemoryFileSystem::DeleteLink(DWORD /*Tag*/, LPCTSTR Path)
+{
+	Delay(MetricDelete);
+
+	return RemoveNode(Path, FILE_ATTRIBUTE_REPARSE_POINT);
+}
+
+DWORD MemoryFileSystem::DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name)
+{
+	PathBuffer path;
+	DWORD result = CombinePath(path, Directory.Path, Name);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return DeleteLink(Tag, path.Get());
+}
+
+DWORD MemoryFileSystem::Rename(LPCTSTR OldPath, LPCTSTR NewPath)
+{
+	Delay(MetricModify);
+
+	String oldName;
+	String newName;
+	String oldPath(OldPath);
+	String newPath(NewPath);
+	String oldPrefix = oldPath + PATH_SEPARATOR;
+
+	std::lock_guard<std::mutex> lock(Lock);
+	NodeMap::iterator node = Nodes.find(oldPath);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+	else if (newPath == oldPath)
+	{
+		return 0;
+	}
+	else if (newPath.compare(0, oldPrefix.size(), oldPrefix) == 0)
+	{
+		// A directory can't be moved beneath itself
+		return ERROR_ACCESS_DENIED;
+	}
+
+	Node* oldParent = FindParent(oldPath, oldName);
+	Node* newParent = FindParent(newPath, newName);
+	if (newParent == NULL)
+	{
+		return ERROR_PATH_NOT_FOUND;
+	}
+
+	// Like MoveFileEx, only a plain file or link may be replaced
+	NodeMap::iterator existing = Nodes.find(newPath);
+	if (existing != Nodes.end())
+	{
+		if ((existing->second.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0 ||
+			(node->second.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			return ERROR_ALREADY_EXISTS;
+		}
+		Nodes.erase(existing);
+	}
+
+	// A directory takes everything beneath it along
+	std::vector<String> moved(1, oldPath);
+	for (NodeMap::iterator i = Nodes.lower_bound(oldPrefix);
+		i != Nodes.end() && i->first.compare(0, oldPrefix.size(), oldPrefix) == 0; ++i)
+	{
+		moved.push_back(i->first);
+	}
+
+	for (size_t i = 0; i < moved.size(); i++)
+	{
+		Nodes[newPath + moved[i].substr(oldPath.size())] = Nodes[moved[i]];
+		Nodes.erase(moved[i]);
+	}
+
+	if (oldParent != NULL)
+	{
+		oldParent->Children.erase(oldName);
+		oldParent->WriteTime = ++Clock;
+	}
+
+	newParent->Children.insert(newName);
+	newParent->WriteTime = ++Clock;
+	NotifyChange(newPath);
+
+	return 0;
+}
+
+DWORD MemoryFileSystem::CreateDirectoryFrom(LPCTSTR /*TemplatePath*/, LPCTSTR Path)
+{
+	Delay(MetricCreateDirectory);
+
+	Node dir;
+	dir.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+	dir.Tag = 0;
+
+	return AddNode(Path, dir);
+}
+
+DWORD MemoryFileSystem::CreateEmptyFile(LPCTSTR Path)
+{
+	Delay(MetricCreate);
+
+	Node file;
+	file.Attributes = FILE_ATTRIBUTE_NORMAL;
+	file.Tag = 0;
+
+	return AddNode(Path, file);
+}
+
+DWORD MemoryFileSystem::RemoveFile(LPCTSTR Path)
+{
+	Delay(MetricDelete);
+
+	return RemoveNode(Path, FILE_ATTRIBUTE_NORMAL);
+}
+
+DWORD MemoryFileSystem::RemoveEmptyDirectory(LPCTSTR Path)
+{
+	Delay(MetricDelete);
+
+	return RemoveNode(Path, FILE_ATTRIBUTE_DIRECTORY);
+}
+
+ChangeWatcher* MemoryFileSystem::CreateWatcher()
+{
+	return new MemoryChangeWatcher(*this);
+}
+
+/**
+ * Counts an operation and waits out the delay set for it. Called before the lock is taken.
+ */
+void MemoryFileSystem::Delay(MetricOperation Operation)
+{
+	NumOperations++;
+
+	if (Latency[Operation] > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(Latency[Operation]));
+	}
+}
+
+/**
+ * Finds the directory containing the given path. Must be called with the lock held.
+ *
+ * @param Path The full path of an entry.
+ * @param Name The name of the entry within its parent. [OUT]
+ * @return Returns the parent directory, or NULL if it does not exist.
+ */
+MemoryFileSystem::Node* MemoryFileSystem::FindParent(const String& Path, String& Name)
+{
+	size_t separator = Path.rfind(PATH_SEPARATOR);
+	if (separator == String::npos || separator + 1 == Path.size())
+	{
+		return NULL;
+	}
+
+	Name = Path.substr(separator + 1);
+
+	// The parent is either named without a trailing separator or is a root that keeps one, like 'C:\' or '/'
+	NodeMap::iterator parent = Nodes.find(Path.substr(0, separator));
+	if (parent == Nodes.end())
+	{
+		parent = Nodes.find(Path.substr(0, separator + 1));
+	}
+	if (parent == Nodes.end() || (parent->second.Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 ||
+		(parent->second.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+	{
+		return NULL;
+	}
+
+	return &parent->second;
+}
+
+/**
+ * Adds a new entry to an existing directory.
+ */
+DWORD MemoryFileSystem::AddNode(LPCTSTR Path, const Node& NewNode)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	String name;
+	Node* parent = FindParent(Path, name);
+	if (parent == NULL)
+	{
+		return ERROR_PATH_NOT_FOUND;
+	}
+	else if (Nodes.find(Path) != Nodes.end())
+	{
+		return ERROR_ALREADY_EXISTS;
+	}
+
+	Node& node = Nodes[Path];
+	node = NewNode;
+	node.WriteTime = ++Clock;
+	parent->Children.insert(name);
+	parent->WriteTime = node.WriteTime;
+	NotifyChange(Path);
+
+	return 0;
+}
+
+/**
+ * Removes an entry of the given kind from its directory. A directory must be empty to be removed.
+ *
+ * @param Path The full path of the entry to remove.
+ * @param Attributes FILE_ATTRIBUTE_REPARSE_POINT to remove a link, FILE_ATTRIBUTE_DIRECTORY to remove a directory,
+ *		otherwise FILE_ATTRIBUTE_NORMAL to remove a plain file.
+ */
+DWORD MemoryFileSystem::RemoveNode(LPCTSTR Path, DWORD Attributes)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	NodeMap::iterator node = Nodes.find(Path);
+	if (node == Nodes.end())
+	{
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	DWORD attributes = node->second.Attributes;
+	if (Attributes == FILE_ATTRIBUTE_REPARSE_POINT)
+	{
+		if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+		{
+			return ERROR_NOT_A_REPARSE_POINT;
+		}
+	}
+	else if (Attributes == FILE_ATTRIBUTE_DIRECTORY)
+	{
+		if ((attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 || (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+		{
+			return ERROR_DIRECTORY;
+		}
+		else if (!node->second.Children.empty())
+		{
+			return ERROR_DIR_NOT_EMPTY;
+		}
+	}
+	else if ((attributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)) != 0)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	String name;
+	Node* parent = FindParent(Path, name);
+	if (parent != NULL)
+	{
+		parent->Children.erase(name);
+		parent->WriteTime = ++Clock;
+	}
+	Nodes.erase(node);
+
+	return 0;
+}
+
+/**
+ * Tells every watcher that an entry was created or changed. Must be called with the lock held.
+ */
+void MemoryFileSystem::NotifyChange(const String& Path)
+{
+	for (size_t i = 0; i < Watchers.size(); i++)
+	{
+		Watchers[i]->AddChange(Path);
+	}
+}
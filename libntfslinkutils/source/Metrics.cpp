@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Metrics.h"
+
+#include <atomic>
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+bool bMetricsEnabled = false;
+
+namespace
+{
+
+/** The number of histogram buckets. Bucket i counts latencies of at least 2^i and less than 2^(i+1) nanoseconds. */
+enum { NumBuckets = 48 };
+
+struct Histogram
+{
+	std::atomic<ULONGLONG> TotalNs;
+	std::atomic<ULONGLONG> MaxNs;
+	std::atomic<ULONGLONG> Buckets[NumBuckets];
+};
+
+Histogram Histograms[NumMetricOperations];
+
+/** The name of each operation, indexed by MetricOperation. */
+LPCTSTR OperationNames[] = { TEXT("enumerate"), TEXT("query"), TEXT("read"), TEXT("create"), TEXT("modify"),
+	TEXT("delete"), TEXT("mkdir"), TEXT("rewrite") };
+
+/** The number of clock ticks per second. */
+ULONGLONG TicksPerSecond = 1;
+
+/**
+ * Returns the latency below which the given fraction of the recorded latencies fall.
+ */
+ULONGLONG GetPercentile(const Histogram& Data, ULONGLONG Count, double Fraction)
+{
+	ULONGLONG maxNs = Data.MaxNs;
+	ULONGLONG rank = (ULONGLONG)(Count * Fraction);
+	ULONGLONG seen = 0;
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		seen += Data.Buckets[i];
+		if (seen > rank)
+		{
+			ULONGLONG bound = (ULONGLONG)1 << (i + 1);
+			return bound < maxNs ? bound : maxNs;
+		}
+	}
+
+	return maxNs;
+}
+
+} // namespace
+
+void EnableMetrics(bool bEnable)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	TicksPerSecond = (ULONGLONG)frequency.QuadPart;
+#else
+	TicksPerSecond = 1000000000;
+#endif
+
+	for (int i = 0; i < NumMetricOperations; i++)
+	{
+		Histograms[i].TotalNs = 0;
+		Histograms[i].MaxNs = 0;
+		for (int j = 0; j < NumBuckets; j++)
+		{
+			Histograms[i].Buckets[j] = 0;
+		}
+	}
+
+	bMetricsEnabled = bEnable;
+}
+
+ULONGLONG ReadMetricClock()
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (ULONGLONG)counter.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (ULONGLONG)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void RecordMetric(MetricOperation Operation, ULONGLONG Ticks)
+{
+	ULONGLONG ns = TicksPerSecond == 1000000000 ? Ticks : Ticks * 1000000000 / TicksPerSecond;
+
+	int bucket = 0;
+	while (bucket < NumBuckets - 1 && (ns >> (bucket + 1)) != 0)
+	{
+		bucket++;
+	}
+
+	Histogram& histogram = Histograms[Operation];
+	histogram.TotalNs += ns;
+	histogram.Buckets[bucket]++;
+
+	ULONGLONG maxNs = histogram.MaxNs;
+	while (ns > maxNs && !histogram.MaxNs.compare_exchange_weak(maxNs, ns))
+	{
+	}
+}
+
+void GetMetricSummary(MetricOperation Operation, MetricSummary& Summary)
+{
+	const Histogram& histogram = Histograms[Operation];
+
+	// Other threads may still be recording, so take the count from the buckets that are about to be read
+	Summary.Count = 0;
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		Summary.Count += histogram.Buckets[i];
+	}
+
+	Summary.TotalNs = histogram.TotalNs;
+	Summary.MaxNs = histogram.MaxNs;
+	Summary.P50Ns = GetPercentile(histogram, Summary.Count, 0.50);
+	Summary.P90Ns = GetPercentile(histogram, Summary.Count, 0.90);
+	Summary.P99Ns = GetPercentile(histogram, Summary.Count, 0.99);
+}
+
+LPCTSTR GetMetricName(MetricOperation Operation)
+{
+	return OperationNames[Operation];
+}
@@ -0,0 +1,284 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MoveJournal.h"
+
+#include "FileSystem.h"
+#include "PathBuffer.h"
+
+MoveJournal::MoveJournal()
+	: File(NULL)
+	, NumUnflushed(0)
+	, bEnumerated(false)
+{
+}
+
+MoveJournal::~MoveJournal()
+{
+	if (File != NULL)
+	{
+		fclose(File);
+	}
+}
+
+DWORD MoveJournal::Open(LPCTSTR JournalPath, LPCTSTR Src, LPCTSTR Dest)
+{
+	this->JournalPath = JournalPath;
+
+	// Pick up where a previous run stopped, as long as it was moving the same tree
+	DWORD result = Read(JournalPath);
+	if (result == ERROR_FILE_NOT_FOUND)
+	{
+		result = 0;
+	}
+
+	// A journal cut short before its first records were written is started over
+	if (result == 0 && !this->Src.empty() && (this->Src != Src || this->Dest != Dest))
+	{
+		result = ERROR_BAD_FORMAT;
+	}
+
+	if (result != 0)
+	{
+		return result;
+	}
+
+	this->Src = Src;
+	this->Dest = Dest;
+
+	// Start the journal over with only the records that are still needed. This drops a partial record left at the end
+	// by an interruption and keeps a journal that is resumed many times from growing.
+	String tempPath = this->JournalPath + TEXT(".tmp");
+#ifdef UNICODE
+	File = _tfopen(tempPath.c_str(), TEXT("wt, ccs=UTF-8"));
+#else
+	File = _tfopen(tempPath.c_str(), TEXT("wt"));
+#endif
+	if (File == NULL)
+	{
+		return GetLastError();
+	}
+
+	Write((String(TEXT("R ")) + Src + TEXT("\n")).c_str(), false);
+	Write((String(TEXT("T ")) + Dest + TEXT("\n")).c_str(), false);
+	for (std::map<String, DWORD>::const_iterator it = Created.begin(); it != Created.end(); ++it)
+	{
+		AddCreated(it->first.c_str(), it->second);
+	}
+	if (bEnumerated)
+	{
+		AddEnumerated();
+	}
+
+	result = fclose(File) == 0 ? 0 : GetLastError();
+	File = NULL;
+	if (result == 0)
+	{
+		result = ReplacePath(tempPath.c_str(), JournalPath);
+	}
+	if (result != 0)
+	{
+		return result;
+	}
+
+	// New records are appended from here on
+#ifdef UNICODE
+	File = _tfopen(JournalPath, TEXT("at, ccs=UTF-8"));
+#else
+	File = _tfopen(JournalPath, TEXT("at"));
+#endif
+	if (File == NULL)
+	{
+		return GetLastError();
+	}
+
+	return 0;
+}
+
+DWORD MoveJournal::Close(bool bCompleted)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	DWORD result = 0;
+	if (File != NULL)
+	{
+		if (fclose(File) != 0)
+		{
+			result = GetLastError();
+		}
+		File = NULL;
+	}
+
+	if (result == 0 && bCompleted && _tremove(JournalPath.c_str()) != 0)
+	{
+		result = GetLastError();
+	}
+
+	return result;
+}
+
+bool MoveJournal::FindCreated(LPCTSTR Path, DWORD& Tag) const
+{
+	std::map<String, DWORD>::const_iterator it = Created.find(Path);
+	if (it == Created.end())
+	{
+		return false;
+	}
+
+	Tag = it->second;
+	return true;
+}
+
+void MoveJournal::GetCreated(std::vector<Entry>& Entries) const
+{
+	for (std::map<String, DWORD>::const_iterator it = Created.begin(); it != Created.end(); ++it)
+	{
+		Entry entry;
+		entry.Path = it->first;
+		entry.Tag = it->second;
+		Entries.push_back(entry);
+	}
+}
+
+void MoveJournal::AddCreated(LPCTSTR Path, DWORD Tag)
+{
+	TCHAR tag[16];
+	StringCchPrintf(tag, ARRAYSIZE(tag), TEXT("C %08X "), (unsigned int)Tag);
+	Write((String(tag) + Path + TEXT("\n")).c_str(), false);
+}
+
+void MoveJournal::AddEnumerated()
+{
+	Write(TEXT("E\n"), true);
+}
+
+void MoveJournal::AddDeleted(const std::vector<const Entry*>& Entries)
+{
+	if (Entries.empty())
+	{
+		return;
+	}
+
+	// Append the whole batch with a single write
+	String records;
+	for (size_t i = 0; i < Entries.size(); i++)
+	{
+		records.append(TEXT("D "));
+		records.append(Entries[i]->Path);
+		records.append(TEXT("\n"));
+	}
+
+	Write(records.c_str(), true);
+}
+
+/**
+ * Reads the records of an existing journal file.
+ */
+DWORD MoveJournal::Read(LPCTSTR JournalPath)
+{
+#ifdef UNICODE
+	FILE* file = _tfopen(JournalPath, TEXT("rt, ccs=UTF-8"));
+#else
+	FILE* file = _tfopen(JournalPath, TEXT("rt"));
+#endif
+	if (file == NULL)
+	{
+		return GetLastError();
+	}
+
+	DWORD result = 0;
+	// Room for a path of the longest length plus the record type and tag
+	std::vector<TCHAR> Line(MAX_LONG_PATH + 32);
+	while (result == 0 && _fgetts(&Line[0], (int)Line.size(), file) != NULL)
+	{
+		// A record without a line ending was cut short by an interruption and is the last one in the file
+		LPTSTR record = &Line[0];
+		size_t length = _tcslen(record);
+		if (length == 0 || record[length - 1] != '\n')
+		{
+			break;
+		}
+		record[--length] = 0;
+
+		LPCTSTR value = length >= 2 ? &record[2] : TEXT("");
+		switch (record[0])
+		{
+		case 'R':
+			Src = value;
+			break;
+		case 'T':
+			Dest = value;
+			break;
+		case 'C':
+			{
+				LPTSTR path = NULL;
+				DWORD tag = (DWORD)_tcstoul(value, &path, 16);
+				if (path == NULL || *path != ' ')
+				{
+					result = ERROR_BAD_FORMAT;
+					break;
+				}
+				Created[path + 1] = tag;
+			}
+			break;
+		case 'E':
+			bEnumerated = true;
+			break;
+		case 'D':
+			Created.erase(value);
+			break;
+		default:
+			result = ERROR_BAD_FORMAT;
+			break;
+		}
+	}
+
+	fclose(file);
+
+	return result;
+}
+
+/**
+ * Appends one or more complete records to the journal, flushing them every FlushInterval records or when asked to.
+ */
+void MoveJournal::Write(LPCTSTR Record, bool bFlush)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	if (File == NULL)
+	{
+		return;
+	}
+
+	_fputts(Record, File);
+	if (bFlush || ++NumUnflushed >= FlushInterval)
+	{
+		fflush(File);
+		NumUnflushed = 0;
+	}
+}
@@ -0,0 +1,433 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MoveLink.h"
+
+#include "FileSystem.h"
+#include "Log.h"
+#include "MoveJournal.h"
+#include "NtfsLinks.h"
+#include "ReparsePoint.h"
+#include "TargetRewriter.h"
+#include "TreeWalker.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace libntfslinks;
+
+namespace
+{
+
+/** The number of source links each worker deletes at a time in the second phase of a two phase move. */
+enum { DeleteBatchSize = 256 };
+
+/**
+ * Orders links by path so that each batch of deletes stays within as few directories as possible.
+ */
+struct PathOrder
+{
+	bool operator()(const MoveJournal::Entry& A, const MoveJournal::Entry& B) const
+	{
+		return A.Path < B.Path;
+	}
+};
+
+/**
+ * Moves each reparse point found in the source tree to the same relative location in the destination tree.
+ *
+ * In a two phase move the source links are not deleted while walking. Each link created is remembered instead, along
+ * with the links that a journaled earlier run created, and DeleteSources removes them all afterwards.
+ */
+class MoveLinkVisitor : public TreeVisitor
+{
+public:
+	MoveLinkVisitor(LPCTSTR DestRoot, const mvlinkOptions& Options, mvlinkStats& Stats, MoveJournal* Journal)
+		: DestRoot(DestRoot)
+		, Options(Options)
+		, Stats(Stats)
+		, Rewriter(Options.Rules, Options.Roots, Options.OldTargetBase, Options.NewTargetBase, RewriteRebase)
+		, Journal(Journal)
+		, bTwoPhase(Options.bTwoPhase || Journal != NULL)
+		, NextBatch(0)
+	{
+		// Links created by an earlier run still need their sources deleted
+		if (Journal != NULL)
+		{
+			Journal->GetCreated(Created);
+		}
+	}
+
+	virtual bool VisitDirectory(const WalkEntry& Entry)
+	{
+		PathBuffer DestPath;
+		DWORD result = GetDestPath(Entry, DestPath);
+		if (result != 0)
+		{
+			VisitError(Entry, result);
+			return false;
+		}
+
+		// Make sure the the destination directory exists. If not create it, or plan to.
+		DWORD destAttributes = 0;
+		if (GetPathAttributes(DestPath.Get(), destAttributes) != 0)
+		{
+			if (Options.Plan != NULL)
+			{
+				Options.Plan->Add(PlanCreateDirectory, 0, Entry.Path, DestPath.Get(), NULL, NULL);
+			}
+			else if (CreateDirectoryFrom(Entry.Path, DestPath.Get()) != 0)
+			{
+				// Failed to create the destination directory. Every link beneath it will fail and be reported.
+			}
+		}
+
+		return true;
+	}
+
+	virtual void VisitLink(const WalkEntry& Entry)
+	{
+		DWORD result = 0;
+		LPCTSTR SrcPath = Entry.Path;
+
+		// Skip links that an earlier run of the move already created
+		DWORD createdTag = 0;
+		if (Journal != NULL && Journal->FindCreated(SrcPath, createdTag))
+		{
+			return;
+		}
+
+		PathBuffer DestPath;
+		result = GetDestPath(Entry, DestPath);
+		if (result != 0)
+		{
+			VisitError(Entry, result);
+			return;
+		}
+
+		// Read the target of the source with a single open relative to the enumerated directory. Reparse points that the
+		// enumeration already reported as something other than a link are skipped without being opened.
+		ReparsePointInfo SrcInfo;
+		SrcInfo.Tag = Entry.ReparseTag;
+		if (SrcInfo.Tag == 0 || IsLinkTag(SrcInfo.Tag))
+		{
+			result = GetReparsePointInfoAt(Entry.Directory, Entry.Name, SrcInfo);
+		}
+
+		if (result == 0 && !IsLinkTag(SrcInfo.Tag))
+		{
+			LogMessage(TEXT("Unrecognized reparse point: %s\n"), SrcPath);
+			Stats.NumSkipped++;
+			return;
+		}
+
+		// Links whose target is filtered out are left alone
+		if (result == 0 && Options.Filter != NULL && !Options.Filter->MatchesLinkTarget(SrcInfo.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return;
+		}
+
+		// If specified, rewrite the target with the rules or rebase it to the new root
+		PathBuffer NewTarget;
+		if (result == 0)
+		{
+			result = Rewriter.Rewrite(SrcInfo.Target.Get(), NewTarget);
+		}
+
+		// A dry run only records what would be done
+		if (result == 0 && Options.Plan != NULL)
+		{
+			Options.Plan->Add(PlanMove, SrcInfo.Tag, SrcPath, DestPath.Get(), SrcInfo.Target.Get(), NewTarget.Get());
+			Stats.NumMoved++;
+			return;
+		}
+
+		// Check if the destination already exists
+		ReparsePointInfo DestInfo;
+		if (result == 0 && GetReparsePointInfo(DestPath.Get(), DestInfo) == 0)
+		{
+			// An existing link at the destination is always replaced, without asking
+			if (IsLinkTag(DestInfo.Tag))
+			{
+				result = DeleteReparseLink(DestInfo.Tag, DestPath.Get());
+			}
+		}
+
+		// Was there a failure reading the source, rewriting its target or deleting the existing destination?
+		if (result == 0)
+		{
+			LPCTSTR Target = NewTarget.Get();
+
+			// Create the junction or symlink at the destination
+			result = CreateReparseLink(SrcInfo.Tag, DestPath.Get(), Target);
+			if (result == 0 && Options.bVerbose)
+			{
+				LogMessage(TEXT("%s created for %s <<===>> %s\n"), GetLinkTypeName(SrcInfo.Tag), DestPath.Get(),
+					Target);
+			}
+
+			// Was the link created successfully? In a two phase move the source is deleted later.
+			if (result == 0 && bTwoPhase)
+			{
+				AddCreated(SrcPath, SrcInfo.Tag);
+			}
+			else if (result == 0)
+			{
+				Stats.NumMoved++;
+
+				// Remove the original
+				result = DeleteReparseLinkAt(SrcInfo.Tag, Entry.Directory, Entry.Name);
+			}
+		}
+
+		// Was the operation successful?
+		if (result != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, SrcPath);
+		}
+	}
+
+	virtual void VisitError(const WalkEntry& Entry, DWORD ErrorCode)
+	{
+		// If we failed to be able to read the directory listing due to a access violation count it as a skip
+		// instead of a complete failure.
+		if (ErrorCode == ERROR_ACCESS_DENIED && (Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			PrintErrorMessage(ErrorCode, Entry.Path);
+			Stats.NumSkipped++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(ErrorCode, Entry.Path);
+		}
+	}
+
+	/**
+	 * Deletes the source of every link created by the first phase of a two phase move, using one worker per thread
+	 * of the walk. Each worker takes the next batch of DeleteBatchSize links and records the batch in the journal once
+	 * it is deleted.
+	 */
+	void DeleteSources()
+	{
+		std::sort(Created.begin(), Created.end(), PathOrder());
+
+		std::vector<std::thread*> threads;
+		for (int i = TreeWalker::GetNumWorkers(Options.NumThreads); i > 1; i--)
+		{
+			threads.push_back(new std::thread(&MoveLinkVisitor::DeleteMain, this));
+		}
+
+		// The calling thread acts as the first worker
+		DeleteMain();
+
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i]->join();
+			delete threads[i];
+		}
+	}
+
+private:
+	/**
+	 * Remembers a link whose destination was created so that its source is deleted in the second phase.
+	 */
+	void AddCreated(LPCTSTR SrcPath, DWORD Tag)
+	{
+		MoveJournal::Entry entry;
+		entry.Path = SrcPath;
+		entry.Tag = Tag;
+
+		{
+			std::lock_guard<std::mutex> lock(CreatedLock);
+			Created.push_back(entry);
+		}
+
+		if (Journal != NULL)
+		{
+			Journal->AddCreated(SrcPath, Tag);
+		}
+	}
+
+	/**
+	 * Runs a worker of the second phase until every batch has been taken.
+	 */
+	void DeleteMain()
+	{
+		std::vector<const MoveJournal::Entry*> deleted;
+		for (;;)
+		{
+			size_t begin = (NextBatch++) * DeleteBatchSize;
+			if (begin >= Created.size())
+			{
+				break;
+			}
+
+			size_t end = std::min(begin + DeleteBatchSize, Created.size());
+			deleted.clear();
+			for (size_t i = begin; i < end; i++)
+			{
+				const MoveJournal::Entry& entry = Created[i];
+
+				DWORD result = DeleteReparseLink(entry.Tag, entry.Path.c_str());
+
+				// A source that is already gone was deleted by an earlier run that didn't get to record it
+				if (result == 0 || result == ERROR_FILE_NOT_FOUND || result == ERROR_PATH_NOT_FOUND)
+				{
+					Stats.NumMoved++;
+					deleted.push_back(&entry);
+				}
+				else
+				{
+					Stats.NumFailed++;
+					PrintErrorMessage(result, entry.Path.c_str());
+				}
+			}
+
+			if (Journal != NULL)
+			{
+				Journal->AddDeleted(deleted);
+			}
+		}
+	}
+
+	/**
+	 * Builds the destination path that mirrors the given source entry.
+	 */
+	DWORD GetDestPath(const WalkEntry& Entry, PathBuffer& DestPath) const
+	{
+		if (Entry.RelativePath[0] == 0)
+		{
+			return DestPath.Assign(DestRoot);
+		}
+
+		return CombinePath(DestPath, DestRoot, Entry.RelativePath);
+	}
+
+	LPCTSTR DestRoot;
+	const mvlinkOptions& Options;
+	mvlinkStats& Stats;
+	TargetRewriter Rewriter;
+	MoveJournal* Journal;
+	bool bTwoPhase;
+	/** The links whose sources are deleted in the second phase. */
+	std::vector<MoveJournal::Entry> Created;
+	std::mutex CreatedLock;
+	/** The index of the next batch of Created for a worker of the second phase to delete. */
+	std::atomic<size_t> NextBatch;
+
+	// Not copyable
+	MoveLinkVisitor(const MoveLinkVisitor&);
+	MoveLinkVisitor& operator=(const MoveLinkVisitor&);
+};
+
+} // namespace
+
+DWORD mvlink(LPCTSTR Src, LPCTSTR Dest, const mvlinkOptions& Options, mvlinkStats& Stats)
+{
+	// Expand the destination to a full path
+	PathBuffer DestPath;
+	if (GetFullPath(Dest, DestPath) != 0)
+	{
+		Stats.NumFailed++;
+		LogMessage(TEXT("Invalid destination path specified.\n"));
+		return 1;
+	}
+
+	// Pick up the journal of an interrupted move
+	MoveJournal journal;
+	MoveJournal* pJournal = NULL;
+	if (!Options.JournalPath.IsEmpty() && Options.Plan == NULL)
+	{
+		PathBuffer SrcPath;
+		DWORD journalResult = GetFullPath(Src, SrcPath);
+		if (journalResult == 0)
+		{
+			journalResult = journal.Open(Options.JournalPath.Get(), SrcPath.Get(), DestPath.Get());
+		}
+
+		if (journalResult == ERROR_BAD_FORMAT)
+		{
+			Stats.NumFailed++;
+			LogMessage(TEXT("The journal %s does not belong to this move.\n"), Options.JournalPath.Get());
+			return journalResult;
+		}
+		else if (journalResult != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(journalResult, Options.JournalPath.Get());
+			return journalResult;
+		}
+
+		pJournal = &journal;
+	}
+
+	size_t numFailed = Stats.NumFailed;
+	MoveLinkVisitor visitor(DestPath.Get(), Options, Stats, pJournal);
+
+	// Create the destination links, unless a journaled earlier run already created all of them
+	DWORD result = 0;
+	if (pJournal == NULL || !pJournal->IsEnumerated())
+	{
+		TreeWalker walker(visitor, Options.NumThreads, Options.MaxDepth, NULL, Options.Order);
+		walker.SetProgress(Options.Progress);
+		walker.SetFilter(Options.Filter);
+		result = walker.Walk(Src);
+
+		// A link that failed must be found again when resuming, so the walk is only skipped if nothing failed
+		if (pJournal != NULL && result == 0 && Stats.NumFailed == numFailed)
+		{
+			pJournal->AddEnumerated();
+		}
+	}
+
+	if ((!Options.bTwoPhase && pJournal == NULL) || Options.Plan != NULL)
+	{
+		return result;
+	}
+
+	// Delete the sources of every link created
+	visitor.DeleteSources();
+
+	// The journal is no longer needed once every link has moved
+	if (pJournal != NULL)
+	{
+		DWORD journalResult = pJournal->Close(result == 0 && Stats.NumFailed == numFailed);
+		if (journalResult != 0)
+		{
+			PrintErrorMessage(journalResult, Options.JournalPath.Get());
+		}
+	}
+
+	return result;
+}
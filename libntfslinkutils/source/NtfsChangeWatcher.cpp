@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+
+#include "NtfsChangeWatcher.h"
+
+/** The changes that mean an entry of a subtree was created or changed. */
+static const DWORD NotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+	FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+NtfsChangeWatcher::NtfsChangeWatcher()
+	: hPort(NULL)
+{
+}
+
+NtfsChangeWatcher::~NtfsChangeWatcher()
+{
+	// Wait for each outstanding read to be cancelled before its buffer is freed
+	for (size_t i = 0; i < Watches.size(); i++)
+	{
+		Watch* dir = Watches[i];
+		DWORD length = 0;
+		CancelIoEx(dir->hDirectory, &dir->Overlapped);
+		GetOverlappedResult(dir->hDirectory, &dir->Overlapped, &length, TRUE);
+		CloseHandle(dir->hDirectory);
+		delete dir;
+	}
+
+	if (hPort != NULL)
+	{
+		CloseHandle(hPort);
+	}
+}
+
+DWORD NtfsChangeWatcher::Open()
+{
+	hPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	return hPort != NULL ? 0 : GetLastError();
+}
+
+DWORD NtfsChangeWatcher::WatchDirectory(LPCTSTR Path)
+{
+	std::lock_guard<std::mutex> lock(Lock);
+
+	// The subtree of a directory that is already watched is covered
+	if (Watched.Contains(Path))
+	{
+		return 0;
+	}
+
+	HANDLE hDirectory = CreateFile(Path, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (hDirectory == INVALID_HANDLE_VALUE)
+	{
+		return GetLastError();
+	}
+
+	// Reads that complete to a port are not cancelled when the walker thread that issued them exits
+	Watch* dir = new Watch();
+	dir->hDirectory = hDirectory;
+	dir->Path = Path;
+	if (CreateIoCompletionPort(hDirectory, hPort, (ULONG_PTR)dir, 0) == NULL)
+	{
+		DWORD result = GetLastError();
+		CloseHandle(hDirectory);
+		delete dir;
+		return result;
+	}
+
+	DWORD result = Read(dir);
+	if (result != 0)
+	{
+		CloseHandle(hDirectory);
+		delete dir;
+		return result;
+	}
+
+	Watches.push_back(dir);
+	Watched.AddRoot(Path, Path);
+	return 0;
+}
+
+DWORD NtfsChangeWatcher::WaitForChanges(std::vector<String>& Paths)
+{
+	Paths.clear();
+
+	// Block until the first change, then gather more until they settle
+	ULONGLONG first = 0;
+	DWORD timeout = INFINITE;
+	for (;;)
+	{
+		DWORD length = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* overlapped = NULL;
+		if (!GetQueuedCompletionStatus(hPort, &length, &key, &overlapped, timeout))
+		{
+			DWORD result = GetLastError();
+			if (overlapped == NULL)
+			{
+				// Timed out, the batch is complete
+				return result == WAIT_TIMEOUT ? 0 : result;
+			}
+
+			// A read failed, usually because the watched directory was deleted. It is not read again.
+			continue;
+		}
+		else if (key == 0)
+		{
+			// Posted by Stop. Post again so that every later call stops too.
+			PostQueuedCompletionStatus(hPort, 0, 0, NULL);
+			return ERROR_OPERATION_ABORTED;
+		}
+
+		Watch* dir = (Watch*)key;
+		AddChanges(dir, length, Paths);
+		Read(dir);
+
+		if (timeout == INFINITE)
+		{
+			first = GetTickCount64();
+		}
+
+		ULONGLONG elapsed = GetTickCount64() - first;
+		if (elapsed >= MaxBatchTime)
+		{
+			return 0;
+		}
+		timeout = (DWORD)(MaxBatchTime - elapsed < SettleTime ? MaxBatchTime - elapsed : SettleTime);
+	}
+}
+
+void NtfsChangeWatcher::Stop()
+{
+	PostQueuedCompletionStatus(hPort, 0, 0, NULL);
+}
+
+/**
+ * Starts the next read of changes to a watched subtree.
+ */
+DWORD NtfsChangeWatcher::Read(Watch* Dir)
+{
+	memset(&Dir->Overlapped, 0, sizeof(Dir->Overlapped));
+	if (!ReadDirectoryChangesW(Dir->hDirectory, Dir->Buffer, sizeof(Dir->Buffer), TRUE, NotifyFilter, NULL,
+		&Dir->Overlapped, NULL))
+	{
+		return GetLastError();
+	}
+
+	return 0;
+}
+
+/**
+ * Adds the paths of the entries created or changed in a completed read.
+ *
+ * @param Dir The subtree that the read completed for.
+ * @param Length The number of bytes written to its buffer. Zero if the buffer overflowed and changes were dropped.
+ * @param Paths The paths to add to. [IN/OUT]
+ */
+void NtfsChangeWatcher::AddChanges(const Watch* Dir, DWORD Length, std::vector<String>& Paths)
+{
+	// Changes were dropped, so the whole subtree must be walked again
+	if (Length == 0)
+	{
+		Paths.push_back(Dir->Path);
+		return;
+	}
+
+	const BYTE* next = (const BYTE*)Dir->Buffer;
+	for (;;)
+	{
+		const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)next;
+		if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED ||
+			info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+		{
+			String path(Dir->Path);
+			if (path.empty() || path[path.size() - 1] != PATH_SEPARATOR)
+			{
+				path.push_back(PATH_SEPARATOR);
+			}
+
+			// The name is relative to the watched directory and not terminated
+			int nameLength = info->FileNameLength / sizeof(WCHAR);
+#ifdef UNICODE
+			path.append(info->FileName, nameLength);
+#else
+			int length = WideCharToMultiByte(CP_ACP, 0, info->FileName, nameLength, NULL, 0, NULL, NULL);
+			std::vector<char> name(length > 0 ? length : 1);
+			length = WideCharToMultiByte(CP_ACP, 0, info->FileName, nameLength, &name[0], length, NULL, NULL);
+			path.append(&name[0], length);
+#endif
+			Paths.push_back(path);
+		}
+
+		if (info->NextEntryOffset == 0)
+		{
+			break;
+		}
+		next += info->NextEntryOffset;
+	}
+}
+
+#endif //_WIN32
@@ -0,0 +1,812 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+
+#include "NtfsFileSystem.h"
+
+#include "NtfsChangeWatcher.h"
+#include "NtfsLinks.h"
+
+#include <ntfstypes.h>
+#include <WinIoCtl.h>
+#include <winternl.h>
+#include <vector>
+
+using namespace libntfslinks;
+
+#ifndef MAXIMUM_REPARSE_DATA_BUFFER_SIZE
+#define MAXIMUM_REPARSE_DATA_BUFFER_SIZE (16 * 1024)
+#endif
+
+// Only declared when targeting Windows 7 or later, though older versions simply reject it
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH 0x00000002
+#endif
+
+// The NtCreateFile options used to open a link relative to its directory
+#ifndef FILE_OPEN
+#define FILE_OPEN 0x00000001
+#endif
+#ifndef FILE_SYNCHRONOUS_IO_NONALERT
+#define FILE_SYNCHRONOUS_IO_NONALERT 0x00000020
+#endif
+#ifndef FILE_DELETE_ON_CLOSE
+#define FILE_DELETE_ON_CLOSE 0x00001000
+#endif
+#ifndef FILE_OPEN_FOR_BACKUP_INTENT
+#define FILE_OPEN_FOR_BACKUP_INTENT 0x00004000
+#endif
+#ifndef FILE_OPEN_REPARSE_POINT
+#define FILE_OPEN_REPARSE_POINT 0x00200000
+#endif
+#ifndef OBJ_CASE_INSENSITIVE
+#define OBJ_CASE_INSENSITIVE 0x00000040
+#endif
+
+typedef NTSTATUS (NTAPI* NtCreateFileFunc)(PHANDLE FileHandle, ACCESS_MASK DesiredAccess,
+	POBJECT_ATTRIBUTES ObjectAttributes, PIO_STATUS_BLOCK IoStatusBlock, PLARGE_INTEGER AllocationSize,
+	ULONG FileAttributes, ULONG ShareAccess, ULONG CreateDisposition, ULONG CreateOptions, PVOID EaBuffer,
+	ULONG EaLength);
+typedef ULONG (NTAPI* RtlNtStatusToDosErrorFunc)(NTSTATUS Status);
+
+// ntdll is always loaded, so the native functions are looked up once before any worker starts. Directories are only
+// held open for relative opens if both were found.
+static HMODULE NtDll = GetModuleHandle(TEXT("ntdll.dll"));
+static NtCreateFileFunc NtCreateFileProc = (NtCreateFileFunc)GetProcAddress(NtDll, "NtCreateFile");
+static RtlNtStatusToDosErrorFunc RtlNtStatusToDosErrorProc =
+	(RtlNtStatusToDosErrorFunc)GetProcAddress(NtDll, "RtlNtStatusToDosError");
+
+/** The prefix of an NT object manager path, stripped from substitute names. */
+static const WCHAR NtPathPrefix[] = L"\\??\\";
+/** The component that follows NtPathPrefix in the path of a share. */
+static const WCHAR NtUncComponent[] = L"UNC\\";
+
+/**
+ * Copies a counted, non-terminated name out of a REPARSE_DATA_BUFFER path buffer.
+ */
+static DWORD CopyReparseName(const WCHAR* PathBuffer, USHORT Offset, USHORT Length, ::PathBuffer& Dest)
+{
+	const WCHAR* name = (const WCHAR*)((const BYTE*)PathBuffer + Offset);
+	int nameLength = Length / sizeof(WCHAR);
+
+	// Substitute names are NT paths, drop the prefix so the result can be passed back to the Win32 API
+	const int prefixLength = ARRAYSIZE(NtPathPrefix) - 1;
+	bool bUnc = false;
+	if (nameLength >= prefixLength && wcsncmp(name, NtPathPrefix, prefixLength) == 0)
+	{
+		name += prefixLength;
+		nameLength -= prefixLength;
+
+		// \??\UNC\server\share is \\server\share. Keep the 'C\' of 'UNC\' and turn the 'C' into the first separator.
+		const int uncLength = ARRAYSIZE(NtUncComponent) - 1;
+		if (nameLength >= uncLength && _wcsnicmp(name, NtUncComponent, uncLength) == 0)
+		{
+			name += uncLength - 2;
+			nameLength -= uncLength - 2;
+			bUnc = true;
+		}
+	}
+
+#ifdef UNICODE
+	if (Dest.Assign(name, nameLength) != 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+#else
+	int length = nameLength > 0 ? WideCharToMultiByte(CP_ACP, 0, name, nameLength, NULL, 0, NULL, NULL) : 0;
+	LPTSTR buffer = Dest.Reserve(length);
+	if (buffer == NULL)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	length = WideCharToMultiByte(CP_ACP, 0, name, nameLength, buffer, length, NULL, NULL);
+	if (length == 0 && nameLength > 0)
+	{
+		return GetLastError();
+	}
+
+	Dest.SetLength(length);
+#endif
+
+	if (bUnc)
+	{
+		Dest.Reserve(Dest.Length())[0] = '\\';
+	}
+
+	return 0;
+}
+
+/** The size of the tag and length fields that precede the reparse data in a REPARSE_DATA_BUFFER. */
+static const DWORD ReparseHeaderSize = sizeof(ULONG) + 2 * sizeof(USHORT);
+
+/** The flag marking a symbolic link reparse buffer as relative to the directory containing the link. */
+#ifndef SYMLINK_FLAG_RELATIVE
+#define SYMLINK_FLAG_RELATIVE 1
+#endif
+
+/**
+ * Copies a path into a null terminated wide character string, returning the number of characters copied.
+ */
+static int ToWideName(LPCTSTR Name, std::vector<WCHAR>& Dest)
+{
+#ifdef UNICODE
+	size_t length = wcslen(Name);
+	Dest.assign(Name, Name + length + 1);
+	return (int)length;
+#else
+	int length = MultiByteToWideChar(CP_ACP, 0, Name, -1, NULL, 0);
+	if (length <= 0)
+	{
+		return 0;
+	}
+
+	Dest.resize(length);
+	length = MultiByteToWideChar(CP_ACP, 0, Name, -1, &Dest[0], length);
+	return length > 0 ? length - 1 : 0;
+#endif
+}
+
+/**
+ * Opens a reparse point itself rather than whatever it points to.
+ *
+ * @param Directory The open directory containing the reparse point, or NULL if Name is a full path.
+ * @param Name The name of the reparse point within Directory, or its full path.
+ * @param Access The access to open the reparse point with.
+ * @param Options Additional NtCreateFile create options, used only when opening relative to Directory.
+ * @param Handle The open reparse point, which the caller closes. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+static DWORD OpenReparsePoint(const DirectoryHandle* Directory, LPCTSTR Name, ACCESS_MASK Access, ULONG Options,
+	HANDLE& Handle)
+{
+	if (Directory == NULL)
+	{
+		Handle = CreateFile(Name, Access, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+			FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		return Handle == INVALID_HANDLE_VALUE ? GetLastError() : 0;
+	}
+
+	// NtCreateFile takes a counted wide name, which the name of a directory entry always fits
+#ifdef UNICODE
+	size_t length = wcslen(Name);
+	PWSTR wideName = (PWSTR)Name;
+#else
+	std::vector<WCHAR> wideNameBuffer;
+	size_t length = ToWideName(Name, wideNameBuffer);
+	PWSTR wideName = length > 0 ? &wideNameBuffer[0] : NULL;
+#endif
+	if (length == 0 || length > MAXSHORT / sizeof(WCHAR))
+	{
+		return ERROR_INVALID_NAME;
+	}
+
+	UNICODE_STRING objectName;
+	objectName.Buffer = wideName;
+	objectName.Length = (USHORT)(length * sizeof(WCHAR));
+	objectName.MaximumLength = objectName.Length;
+
+	OBJECT_ATTRIBUTES attributes = {0};
+	attributes.Length = sizeof(attributes);
+	attributes.RootDirectory = (HANDLE)Directory->Native;
+	attributes.ObjectName = &objectName;
+	attributes.Attributes = OBJ_CASE_INSENSITIVE;
+
+	// Synchronous I/O so that DeviceIoControl can be used on the handle just as on one from CreateFile
+	IO_STATUS_BLOCK ioStatus = {0};
+	NTSTATUS status = NtCreateFileProc(&Handle, Access | SYNCHRONIZE, &attributes, &ioStatus, NULL, 0,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_OPEN,
+		Options | FILE_OPEN_REPARSE_POINT | FILE_OPEN_FOR_BACKUP_INTENT | FILE_SYNCHRONOUS_IO_NONALERT, NULL, 0);
+	if (status < 0)
+	{
+		Handle = INVALID_HANDLE_VALUE;
+		return RtlNtStatusToDosErrorProc(status);
+	}
+
+	return 0;
+}
+
+/** The prefix of a Win32 long path, which maps directly onto the NT path prefix. */
+static const TCHAR LongPathPrefix[] = TEXT("\\\\?\\");
+/** The prefix of an NT path, as accepted in a target. */
+static const TCHAR NtTargetPrefix[] = TEXT("\\??\\");
+/** The component that follows either prefix in the path of a share. */
+static const TCHAR UncComponent[] = TEXT("UNC\\");
+
+/**
+ * Determines if a character separates path components.
+ */
+static bool IsTargetSeparator(TCHAR c)
+{
+	return c == '\\' || c == '/';
+}
+
+/**
+ * Expands the relative target of a junction to a full path, resolving it against the directory containing the
+ * junction rather than the current directory of the process.
+ *
+ * @param Directory The open directory containing the junction, or NULL if Name is a full path.
+ * @param Name The name of the junction within Directory, or its full path.
+ * @param Target The relative target, either relative to the directory (dir\file) or to the root of its volume (\dir).
+ * @param FullTarget The full path of the target, without a long path prefix. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+static DWORD ResolveJunctionTarget(const DirectoryHandle* Directory, LPCTSTR Name, LPCTSTR Target,
+	PathBuffer& FullTarget)
+{
+	// Find the directory containing the junction
+	LPCTSTR directory = NULL;
+	size_t directoryLength = 0;
+	if (Directory != NULL)
+	{
+		directory = Directory->Path;
+		directoryLength = _tcslen(directory);
+	}
+	else
+	{
+		for (LPCTSTR c = Name; *c != 0; c++)
+		{
+			if (IsTargetSeparator(*c))
+			{
+				directoryLength = c - Name;
+			}
+		}
+		directory = Name;
+	}
+
+	// Drop the long path prefix, which GetFullPathName would take as a reason not to collapse '..'
+	PathBuffer base;
+	const size_t prefixLength = ARRAYSIZE(LongPathPrefix) - 1;
+	const size_t uncLength = ARRAYSIZE(UncComponent) - 1;
+	DWORD result = 0;
+	if (directoryLength >= prefixLength + uncLength && _tcsncmp(directory, LongPathPrefix, prefixLength) == 0 &&
+		_tcsnicmp(directory + prefixLength, UncComponent, uncLength) == 0)
+	{
+		// \\?\UNC\server\share becomes \\server\share
+		size_t skip = prefixLength + uncLength;
+		result = base.Assign(TEXT("\\\\"));
+		if (result == 0)
+		{
+			result = base.Append(directory + skip);
+			base.Truncate(directoryLength - skip + 2);
+		}
+	}
+	else if (directoryLength >= prefixLength && _tcsncmp(directory, LongPathPrefix, prefixLength) == 0)
+	{
+		result = base.Assign(directory + prefixLength, directoryLength - prefixLength);
+	}
+	else
+	{
+		result = base.Assign(directory, directoryLength);
+	}
+
+	if (result != 0)
+	{
+		return result;
+	}
+	else if (base.IsEmpty())
+	{
+		return ERROR_INVALID_NAME;
+	}
+
+	// A target beginning with a separator is relative to the root of the volume: the drive, or the share of a UNC path
+	PathBuffer combined;
+	if (IsTargetSeparator(Target[0]))
+	{
+		LPCTSTR path = base.Get();
+		size_t rootLength = 2;
+		if (IsTargetSeparator(path[0]) && IsTargetSeparator(path[1]))
+		{
+			// Skip past the server and share names
+			int separators = 0;
+			for (rootLength = 2; path[rootLength] != 0; rootLength++)
+			{
+				if (IsTargetSeparator(path[rootLength]) && ++separators == 2)
+				{
+					break;
+				}
+			}
+		}
+
+		result = combined.Assign(path, rootLength);
+		if (result == 0)
+		{
+			result = combined.Append(Target);
+		}
+	}
+	else
+	{
+		result = CombinePath(combined, base.Get(), Target);
+	}
+
+	if (result != 0)
+	{
+		return result;
+	}
+
+	// Collapse any '.' and '..' components
+	DWORD length = GetFullPathName(combined.Get(), 0, NULL, NULL);
+	LPTSTR buffer = length > 0 ? FullTarget.Reserve(length) : NULL;
+	if (length == 0)
+	{
+		return GetLastError();
+	}
+	else if (buffer == NULL)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	length = GetFullPathName(combined.Get(), length, buffer, NULL);
+	if (length == 0)
+	{
+		return GetLastError();
+	}
+	FullTarget.SetLength(length);
+
+	return 0;
+}
+
+/**
+ * Builds the substitute and print names stored in the reparse data of a link.
+ *
+ * The substitute name is an NT path, \??\C:\dir for a full path and \??\UNC\server\share for a UNC path. A target that
+ * already has the \\?\ or \??\ prefix is kept as it is. Symbolic links keep a target relative to their directory or to
+ * the root of their volume as a relative link. Junctions must point to a full path on a local volume, so a relative
+ * target is resolved against the directory containing the junction and a UNC target is rejected.
+ *
+ * @param Directory The open directory containing the link, or NULL if Name is a full path.
+ * @param Name The name of the link within Directory, or its full path.
+ * @param Tag The reparse tag of the link.
+ * @param Target The new target of the link.
+ * @param Substitute The substitute name. [OUT]
+ * @param Print The print name, the target as displayed by the shell. [OUT]
+ * @param bRelative Set if the link is a relative symbolic link. [OUT]
+ * @return Returns zero if the operation was successful, otherwise a non-zero value if an error occurred.
+ */
+static DWORD GetReparseNames(const DirectoryHandle* Directory, LPCTSTR Name, DWORD Tag, LPCTSTR Target,
+	PathBuffer& Substitute, PathBuffer& Print, bool& bRelative)
+{
+	bRelative = false;
+	if (Target[0] == 0)
+	{
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	const size_t prefixLength = ARRAYSIZE(LongPathPrefix) - 1;
+	const size_t uncLength = ARRAYSIZE(UncComponent) - 1;
+	bool bUnc = false;
+	if (_tcsncmp(Target, LongPathPrefix, prefixLength) == 0 || _tcsncmp(Target, NtTargetPrefix, prefixLength) == 0)
+	{
+		// Already an NT path once the prefix is swapped. The print name is the plain Win32 form.
+		LPCTSTR path = Target + prefixLength;
+		bUnc = _tcsnicmp(path, UncComponent, uncLength) == 0;
+		if (Substitute.Assign(NtTargetPrefix) != 0 || Substitute.Append(path) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+		if (bUnc ? Print.Assign(TEXT("\\\\")) != 0 || Print.Append(path + uncLength) != 0 : Print.Assign(path) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+	else if (IsTargetSeparator(Target[0]) && IsTargetSeparator(Target[1]))
+	{
+		// A UNC path, whose leading separators are replaced by the UNC component
+		bUnc = true;
+		if (Substitute.Assign(NtTargetPrefix) != 0 || Substitute.Append(UncComponent) != 0 ||
+			Substitute.Append(Target + 2) != 0 || Print.Assign(Target) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+	else if (Target[1] == ':' && IsTargetSeparator(Target[2]))
+	{
+		if (Substitute.Assign(NtTargetPrefix) != 0 || Substitute.Append(Target) != 0 || Print.Assign(Target) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+	else if (Target[1] == ':')
+	{
+		// Relative to the current directory of a drive, which is different in every process
+		return ERROR_INVALID_NAME;
+	}
+	else if (Tag != IO_REPARSE_TAG_MOUNT_POINT)
+	{
+		bRelative = true;
+		if (Substitute.Assign(Target) != 0 || Print.Assign(Target) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+	}
+	else
+	{
+		PathBuffer fullTarget;
+		DWORD result = ResolveJunctionTarget(Directory, Name, Target, fullTarget);
+		if (result != 0)
+		{
+			return result;
+		}
+
+		return GetReparseNames(Directory, Name, Tag, fullTarget.Get(), Substitute, Print, bRelative);
+	}
+
+	// NTFS only mounts local volumes
+	if (bUnc && Tag == IO_REPARSE_TAG_MOUNT_POINT)
+	{
+		return ERROR_NOT_SUPPORTED;
+	}
+
+	return 0;
+}
+
+/**
+ * Overwrites the reparse data of an existing junction or symbolic link with a new target.
+ *
+ * @param Directory The open directory containing the link, or NULL if Name is a full path.
+ * @param Name The name of the link within Directory, or its full path.
+ * @param Tag The reparse tag of the link.
+ * @param Target The new target of the link.
+ */
+static DWORD SetReparseTarget(const DirectoryHandle* Directory, LPCTSTR Name, DWORD Tag, LPCTSTR Target)
+{
+	std::vector<WCHAR> printName;
+	std::vector<WCHAR> substituteName;
+	ULONG flags = 0;
+
+	PathBuffer substitute;
+	PathBuffer print;
+	bool bRelative = false;
+	DWORD result = GetReparseNames(Directory, Name, Tag, Target, substitute, print, bRelative);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	int printLength = ToWideName(print.Get(), printName);
+	int substituteLength = ToWideName(substitute.Get(), substituteName);
+	if (printLength == 0 || substituteLength == 0)
+	{
+		return GetLastError();
+	}
+
+	if (bRelative)
+	{
+		flags = SYMLINK_FLAG_RELATIVE;
+	}
+
+	// Both names, with their terminators, must fit in a single reparse buffer
+	size_t namesSize = (substituteLength + printLength + 2) * sizeof(WCHAR);
+	if (namesSize > MAXIMUM_REPARSE_DATA_BUFFER_SIZE - sizeof(REPARSE_DATA_BUFFER))
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	BYTE Buffer[MAXIMUM_REPARSE_DATA_BUFFER_SIZE] = {0};
+	REPARSE_DATA_BUFFER* data = (REPARSE_DATA_BUFFER*)Buffer;
+	data->ReparseTag = Tag;
+
+	// Both names are stored in the path buffer along with their null terminators
+	USHORT substituteSize = (USHORT)(substituteLength * sizeof(WCHAR));
+	USHORT printSize = (USHORT)(printLength * sizeof(WCHAR));
+	WCHAR* PathBuffer = NULL;
+	if (Tag == IO_REPARSE_TAG_MOUNT_POINT)
+	{
+		data->MountPointReparseBuffer.SubstituteNameOffset = 0;
+		data->MountPointReparseBuffer.SubstituteNameLength = substituteSize;
+		data->MountPointReparseBuffer.PrintNameOffset = substituteSize + sizeof(WCHAR);
+		data->MountPointReparseBuffer.PrintNameLength = printSize;
+		PathBuffer = data->MountPointReparseBuffer.PathBuffer;
+	}
+	else
+	{
+		data->SymbolicLinkReparseBuffer.SubstituteNameOffset = 0;
+		data->SymbolicLinkReparseBuffer.SubstituteNameLength = substituteSize;
+		data->SymbolicLinkReparseBuffer.PrintNameOffset = substituteSize + sizeof(WCHAR);
+		data->SymbolicLinkReparseBuffer.PrintNameLength = printSize;
+		data->SymbolicLinkReparseBuffer.Flags = flags;
+		PathBuffer = data->SymbolicLinkReparseBuffer.PathBuffer;
+	}
+
+	memcpy(PathBuffer, &substituteName[0], substituteSize + sizeof(WCHAR));
+	memcpy((BYTE*)PathBuffer + substituteSize + sizeof(WCHAR), &printName[0], printSize + sizeof(WCHAR));
+	USHORT nameHeaderSize = (USHORT)((BYTE*)PathBuffer - Buffer - ReparseHeaderSize);
+	data->ReparseDataLength = nameHeaderSize + substituteSize + printSize + 2 * sizeof(WCHAR);
+
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	result = OpenReparsePoint(Directory, Name, GENERIC_WRITE, 0, hFile);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	// Setting a reparse point with the same tag replaces the existing data
+	DWORD bytesReturned = 0;
+	DWORD dataSize = ReparseHeaderSize + data->ReparseDataLength;
+	BOOL bSuccess = DeviceIoControl(hFile, FSCTL_SET_REPARSE_POINT, Buffer, dataSize, NULL, 0, &bytesReturned, NULL);
+	result = bSuccess ? 0 : GetLastError();
+	CloseHandle(hFile);
+
+	return result;
+}
+
+/**
+ * Reads the tag, target and print name of a reparse point with a single FSCTL_GET_REPARSE_POINT.
+ *
+ * @param Directory The open directory containing the reparse point, or NULL if Name is a full path.
+ * @param Name The name of the reparse point within Directory, or its full path.
+ * @param Info The contents of the reparse point. [OUT]
+ */
+static DWORD ReadReparsePoint(const DirectoryHandle* Directory, LPCTSTR Name, ReparsePointInfo& Info)
+{
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	DWORD result = OpenReparsePoint(Directory, Name, FILE_READ_ATTRIBUTES, 0, hFile);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	BYTE Buffer[MAXIMUM_REPARSE_DATA_BUFFER_SIZE];
+	DWORD bytesReturned = 0;
+	BOOL bSuccess = DeviceIoControl(hFile, FSCTL_GET_REPARSE_POINT, NULL, 0, Buffer, sizeof(Buffer), &bytesReturned, NULL);
+	result = bSuccess ? 0 : GetLastError();
+	CloseHandle(hFile);
+
+	if (result != 0)
+	{
+		return result;
+	}
+
+	const REPARSE_DATA_BUFFER* data = (const REPARSE_DATA_BUFFER*)Buffer;
+	Info.Tag = data->ReparseTag;
+
+	if (data->ReparseTag == IO_REPARSE_TAG_MOUNT_POINT)
+	{
+		const WCHAR* PathBuffer = data->MountPointReparseBuffer.PathBuffer;
+		result = CopyReparseName(PathBuffer, data->MountPointReparseBuffer.SubstituteNameOffset,
+			data->MountPointReparseBuffer.SubstituteNameLength, Info.Target);
+		if (result == 0)
+		{
+			result = CopyReparseName(PathBuffer, data->MountPointReparseBuffer.PrintNameOffset,
+				data->MountPointReparseBuffer.PrintNameLength, Info.PrintName);
+		}
+	}
+	else if (data->ReparseTag == IO_REPARSE_TAG_SYMLINK)
+	{
+		const WCHAR* PathBuffer = data->SymbolicLinkReparseBuffer.PathBuffer;
+		result = CopyReparseName(PathBuffer, data->SymbolicLinkReparseBuffer.SubstituteNameOffset,
+			data->SymbolicLinkReparseBuffer.SubstituteNameLength, Info.Target);
+		if (result == 0)
+		{
+			result = CopyReparseName(PathBuffer, data->SymbolicLinkReparseBuffer.PrintNameOffset,
+				data->SymbolicLinkReparseBuffer.PrintNameLength, Info.PrintName);
+		}
+	}
+
+	return result;
+}
+
+DWORD NtfsFileSystem::GetAttributes(LPCTSTR Path, DWORD& Attributes)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributeData = {0};
+	if (!GetFileAttributesEx(Path, GetFileExInfoStandard, &attributeData))
+	{
+		return GetLastError();
+	}
+
+	Attributes = attributeData.dwFileAttributes;
+	return 0;
+}
+
+DWORD NtfsFileSystem::GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributeData = {0};
+	if (!GetFileAttributesEx(Path, GetFileExInfoStandard, &attributeData))
+	{
+		return GetLastError();
+	}
+
+	Time = ((ULONGLONG)attributeData.ftLastWriteTime.dwHighDateTime << 32) | attributeData.ftLastWriteTime.dwLowDateTime;
+	return 0;
+}
+
+DWORD NtfsFileSystem::Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context)
+{
+	PathBuffer szDir;
+	HANDLE hFind;
+
+	// The search path must include '\*'
+	if (CombinePath(szDir, Path, TEXT("*")) != 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	// Each entry of a batch is read into its own slot, so the names stay valid until the batch is handed on
+	std::vector<WIN32_FIND_DATA> found(EnumerateBatchSize);
+	std::vector<DirectoryEntry> entries;
+	entries.reserve(EnumerateBatchSize);
+
+	// The basic information level and large fetches need Windows 7. Older versions reject them and fall back to the
+	// defaults.
+	hFind = FindFirstFileEx(szDir.Get(), FindExInfoBasic, &found[0], FindExSearchNameMatch, NULL,
+		FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+	{
+		hFind = FindFirstFile(szDir.Get(), &found[0]);
+	}
+	if (hFind == INVALID_HANDLE_VALUE)
+	{
+		return GetLastError();
+	}
+
+	// Hold the directory open until the last batch has been handled so that its entries can be opened relative to
+	// it. If it can't be opened the entries are simply used by their full paths.
+	DirectoryHandle directory = { Path, INVALID_DIRECTORY_HANDLE };
+	if (NtCreateFileProc != NULL && RtlNtStatusToDosErrorProc != NULL)
+	{
+		HANDLE hDir = CreateFile(Path, FILE_LIST_DIRECTORY | FILE_TRAVERSE, FILE_SHARE_READ | FILE_SHARE_WRITE |
+			FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if (hDir != INVALID_HANDLE_VALUE)
+		{
+			directory.Native = (intptr_t)hDir;
+		}
+	}
+
+	do
+	{
+		// Ignore the '.' and '..' entries
+		const WIN32_FIND_DATA& ffd = found[entries.size()];
+		if (ffd.cFileName[0] == 0 ||
+			(ffd.cFileName[0] == '.' && ffd.cFileName[1] == 0) ||
+			(ffd.cFileName[0] == '.' && ffd.cFileName[1] == '.' && ffd.cFileName[2] == 0))
+		{
+			continue;
+		}
+
+		// The reparse tag is reported in dwReserved0 for reparse points
+		DirectoryEntry entry;
+		entry.Name = ffd.cFileName;
+		entry.Attributes = ffd.dwFileAttributes;
+		entry.ReparseTag = (ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 ? ffd.dwReserved0 : 0;
+		entries.push_back(entry);
+
+		if (entries.size() == found.size())
+		{
+			Callback(Context, directory, &entries[0], entries.size());
+			entries.clear();
+		}
+	} while (FindNextFile(hFind, &found[entries.size()]) != 0);
+
+	DWORD result = GetLastError();
+	FindClose(hFind);
+
+	if (!entries.empty())
+	{
+		Callback(Context, directory, &entries[0], entries.size());
+	}
+
+	if (directory.IsOpen())
+	{
+		CloseHandle((HANDLE)directory.Native);
+	}
+
+	return result == ERROR_NO_MORE_FILES ? 0 : result;
+}
+
+DWORD NtfsFileSystem::ReadLink(LPCTSTR Path, ReparsePointInfo& Info)
+{
+	return ReadReparsePoint(NULL, Path, Info);
+}
+
+DWORD NtfsFileSystem::ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, ReparsePointInfo& Info)
+{
+	return ReadReparsePoint(&Directory, Name, Info);
+}
+
+DWORD NtfsFileSystem::CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT ? CreateJunction(Path, Target) : CreateSymlink(Path, Target);
+}
+
+DWORD NtfsFileSystem::SetLinkTarget(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	return SetReparseTarget(NULL, Path, Tag, Target);
+}
+
+DWORD NtfsFileSystem::SetLinkTargetAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target)
+{
+	return SetReparseTarget(&Directory, Name, Tag, Target);
+}
+
+DWORD NtfsFileSystem::DeleteLink(DWORD Tag, LPCTSTR Path)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT ? DeleteJunction(Path) : DeleteSymlink(Path);
+}
+
+DWORD NtfsFileSystem::DeleteLinkAt(DWORD Tag, const DirectoryHandle& Directory, LPCTSTR Name)
+{
+	// Opening the reparse point itself for delete on close removes the link whether it is a file or a directory,
+	// leaving whatever it points to alone
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	DWORD result = OpenReparsePoint(&Directory, Name, DELETE, FILE_DELETE_ON_CLOSE, hFile);
+	if (result != 0)
+	{
+		return result;
+	}
+
+	return CloseHandle(hFile) ? 0 : GetLastError();
+}
+
+DWORD NtfsFileSystem::Rename(LPCTSTR OldPath, LPCTSTR NewPath)
+{
+	return MoveFileEx(OldPath, NewPath, MOVEFILE_REPLACE_EXISTING) ? 0 : GetLastError();
+}
+
+DWORD NtfsFileSystem::CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path)
+{
+	// Only the attributes of the template are copied. The security descriptor is inherited from the new parent.
+	return CreateDirectoryEx(TemplatePath, Path, NULL) ? 0 : GetLastError();
+}
+
+DWORD NtfsFileSystem::CreateEmptyFile(LPCTSTR Path)
+{
+	HANDLE hFile = CreateFile(Path, GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		return GetLastError();
+	}
+
+	CloseHandle(hFile);
+	return 0;
+}
+
+DWORD NtfsFileSystem::RemoveFile(LPCTSTR Path)
+{
+	return DeleteFile(Path) ? 0 : GetLastError();
+}
+
+DWORD NtfsFileSystem::RemoveEmptyDirectory(LPCTSTR Path)
+{
+	return RemoveDirectory(Path) ? 0 : GetLastError();
+}
+
+ChangeWatcher* NtfsFileSystem::CreateWatcher()
+{
+	NtfsChangeWatcher* watcher = new NtfsChangeWatcher();
+	if (watcher->Open() != 0)
+	{
+		delete watcher;
+		return NULL;
+	}
+
+	return watcher;
+}
+
+#endif //_WIN32
@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PathBuffer.h"
+
+PathBuffer::PathBuffer()
+	: Buffer(Inline)
+	, Size(0)
+	, Capacity(InlineSize)
+{
+	Inline[0] = 0;
+}
+
+PathBuffer::PathBuffer(const PathBuffer& Other)
+	: Buffer(Inline)
+	, Size(0)
+	, Capacity(InlineSize)
+{
+	Inline[0] = 0;
+	Assign(Other.Buffer, Other.Size);
+}
+
+PathBuffer::~PathBuffer()
+{
+	if (Buffer != Inline)
+	{
+		delete[] Buffer;
+	}
+}
+
+PathBuffer& PathBuffer::operator=(const PathBuffer& Other)
+{
+	if (this != &Other)
+	{
+		Assign(Other.Buffer, Other.Size);
+	}
+
+	return *this;
+}
+
+DWORD PathBuffer::Assign(LPCTSTR Path)
+{
+	return Assign(Path, _tcslen(Path));
+}
+
+DWORD PathBuffer::Assign(LPCTSTR Path, size_t Length)
+{
+	if (!Grow(Length))
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	memmove(Buffer, Path, Length * sizeof(TCHAR));
+	SetLength(Length);
+	return 0;
+}
+
+DWORD PathBuffer::Append(LPCTSTR Text)
+{
+	size_t length = _tcslen(Text);
+	if (!Grow(Size + length))
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	memcpy(&Buffer[Size], Text, length * sizeof(TCHAR));
+	SetLength(Size + length);
+	return 0;
+}
+
+DWORD PathBuffer::AppendName(LPCTSTR Name)
+{
+	if (Size > 0 && Buffer[Size-1] != PATH_SEPARATOR)
+	{
+		if (!Grow(Size + 1))
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+
+		Buffer[Size] = PATH_SEPARATOR;
+		SetLength(Size + 1);
+	}
+
+	return Append(Name);
+}
+
+void PathBuffer::Truncate(size_t Length)
+{
+	if (Length < Size)
+	{
+		SetLength(Length);
+	}
+}
+
+LPTSTR PathBuffer::Reserve(size_t Length)
+{
+	return Grow(Length) ? Buffer : NULL;
+}
+
+void PathBuffer::SetLength(size_t Length)
+{
+	Size = Length;
+	Buffer[Size] = 0;
+}
+
+/**
+ * Makes sure the buffer can hold a path of the given length, keeping the current contents.
+ */
+bool PathBuffer::Grow(size_t Length)
+{
+	if (Length <= Capacity)
+	{
+		return true;
+	}
+	else if (Length > MAX_LONG_PATH)
+	{
+		return false;
+	}
+
+	// Double the capacity each time so that building a path one component at a time stays linear
+	size_t capacity = Capacity * 2;
+	if (capacity < Length)
+	{
+		capacity = Length;
+	}
+	if (capacity > MAX_LONG_PATH)
+	{
+		capacity = MAX_LONG_PATH;
+	}
+
+	LPTSTR buffer = new TCHAR[capacity + 1];
+	memcpy(buffer, Buffer, (Size + 1) * sizeof(TCHAR));
+	if (Buffer != Inline)
+	{
+		delete[] Buffer;
+	}
+
+	Buffer = buffer;
+	Capacity = capacity;
+	return true;
+}
@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PathFilter.h"
+
+namespace
+{
+
+/** The prefix that marks a pattern as a regular expression. */
+const TCHAR RegexPrefix[] = TEXT("re:");
+
+/**
+ * Returns true if the given character separates path components.
+ */
+bool IsSeparator(TCHAR c)
+{
+#ifdef _WIN32
+	return c == '\\' || c == '/';
+#else
+	return c == '/';
+#endif
+}
+
+/**
+ * Folds a character for comparison. NTFS names are compared without regard to case, POSIX names are not.
+ */
+TCHAR FoldCase(TCHAR c)
+{
+#ifdef _WIN32
+	return (TCHAR)_totlower(c);
+#else
+	return c;
+#endif
+}
+
+/**
+ * Returns the last component of a path.
+ */
+LPCTSTR GetLastComponent(LPCTSTR Path)
+{
+	LPCTSTR name = Path;
+	for (LPCTSTR c = Path; *c != 0; c++)
+	{
+		if (IsSeparator(*c))
+		{
+			name = c + 1;
+		}
+	}
+
+	return name;
+}
+
+/**
+ * Matches text against a folded glob.
+ */
+bool MatchGlob(LPCTSTR Pattern, LPCTSTR Text)
+{
+	for (;;)
+	{
+		TCHAR p = *Pattern;
+		if (p == 0)
+		{
+			return *Text == 0;
+		}
+		else if (p == '*')
+		{
+			bool bAnyDepth = Pattern[1] == '*';
+			Pattern += bAnyDepth ? 2 : 1;
+
+			// '**/' also matches no directories at all
+			if (bAnyDepth && IsSeparator(*Pattern) && MatchGlob(Pattern + 1, Text))
+			{
+				return true;
+			}
+
+			// Try the rest of the pattern after every run of characters the wildcard can swallow
+			for (;;)
+			{
+				if (MatchGlob(Pattern, Text))
+				{
+					return true;
+				}
+				else if (*Text == 0 || (!bAnyDepth && IsSeparator(*Text)))
+				{
+					return false;
+				}
+				Text++;
+			}
+		}
+		else if (*Text == 0)
+		{
+			return false;
+		}
+		else if (p == '?' ? IsSeparator(*Text) :
+			!(p == FoldCase(*Text) || (IsSeparator(p) && IsSeparator(*Text))))
+		{
+			return false;
+		}
+
+		Pattern++;
+		Text++;
+	}
+}
+
+} // namespace
+
+DWORD PathFilter::AddPattern(FilterField Field, bool bExclude, LPCTSTR Pattern)
+{
+	PatternSet& patterns = bExclude ? Excludes[Field] : Includes[Field];
+	const size_t prefixLength = ARRAYSIZE(RegexPrefix) - 1;
+
+	if (_tcsncmp(Pattern, RegexPrefix, prefixLength) == 0)
+	{
+		// The regex library reports a bad expression with an exception, which stops here
+		try
+		{
+			Regex::flag_type flags = std::regex_constants::ECMAScript | std::regex_constants::optimize;
+#ifdef _WIN32
+			flags |= std::regex_constants::icase;
+#endif
+			patterns.Regexes.push_back(Regex(Pattern + prefixLength, flags));
+		}
+		catch (const std::regex_error&)
+		{
+			return ERROR_BAD_FORMAT;
+		}
+
+		return 0;
+	}
+
+	String glob;
+	bool bWildcards = false;
+	bool bSeparators = false;
+	for (LPCTSTR c = Pattern; *c != 0; c++)
+	{
+		bWildcards = bWildcards || *c == '*' || *c == '?';
+		bSeparators = bSeparators || IsSeparator(*c);
+		glob.push_back(FoldCase(*c));
+	}
+
+	if (glob.empty())
+	{
+		return ERROR_BAD_FORMAT;
+	}
+	else if (bSeparators)
+	{
+		patterns.PathGlobs.push_back(glob);
+	}
+	else if (bWildcards)
+	{
+		patterns.NameGlobs.push_back(glob);
+	}
+	else
+	{
+		patterns.Names.insert(glob);
+	}
+
+	return 0;
+}
+
+bool PathFilter::IsEmpty() const
+{
+	for (int i = 0; i < NumFilterFields; i++)
+	{
+		if (!Includes[i].IsEmpty() || !Excludes[i].IsEmpty())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool PathFilter::HasTargetPatterns() const
+{
+	return !Includes[FilterTarget].IsEmpty() || !Excludes[FilterTarget].IsEmpty();
+}
+
+bool PathFilter::IsExcludedDirectory(LPCTSTR RelativePath) const
+{
+	return Excludes[FilterPath].Matches(RelativePath);
+}
+
+bool PathFilter::MatchesLinkPath(LPCTSTR RelativePath) const
+{
+	return !Excludes[FilterPath].Matches(RelativePath) &&
+		(Includes[FilterPath].IsEmpty() || Includes[FilterPath].Matches(RelativePath));
+}
+
+bool PathFilter::MatchesLinkTarget(LPCTSTR Target) const
+{
+	return !Excludes[FilterTarget].Matches(Target) &&
+		(Includes[FilterTarget].IsEmpty() || Includes[FilterTarget].Matches(Target));
+}
+
+/**
+ * Returns true if any pattern of the set matches the given path or target.
+ */
+bool PathFilter::PatternSet::Matches(LPCTSTR Path) const
+{
+	LPCTSTR name = GetLastComponent(Path);
+
+	if (!Names.empty())
+	{
+		String folded;
+		for (LPCTSTR c = name; *c != 0; c++)
+		{
+			folded.push_back(FoldCase(*c));
+		}
+
+		if (Names.find(folded) != Names.end())
+		{
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < NameGlobs.size(); i++)
+	{
+		if (MatchGlob(NameGlobs[i].c_str(), name))
+		{
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < PathGlobs.size(); i++)
+	{
+		if (MatchGlob(PathGlobs[i].c_str(), Path))
+		{
+			return true;
+		}
+	}
+
+	for (size_t i = 0; i < Regexes.size(); i++)
+	{
+		if (std::regex_search(Path, Regexes[i]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
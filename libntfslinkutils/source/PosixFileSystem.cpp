@@ -0,0 +1,439 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+
+#include "PosixFileSystem.h"
+
+#include "InotifyWatcher.h"
+#include "NtfsLinks.h"
+
+#include <atomic>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+using namespace libntfslinks;
+
+/**
+ * Creates a new symbolic link next to Path and renames it over the top of the existing one.
+ *
+ * @param DirFd The directory that Path is relative to, or AT_FDCWD if Path is a full path.
+ * @param Path The path of the existing link.
+ * @param Target The new target of the link.
+ */
+static DWORD ReplaceSymlink(int DirFd, LPCTSTR Path, LPCTSTR Target)
+{
+	// Give every temporary link a unique name so that concurrent callers in the same directory don't collide
+	static std::atomic<unsigned long> NextTempId(0);
+
+	TCHAR suffix[64];
+	snprintf(suffix, ARRAYSIZE(suffix), ".%d.%lu.tmp", (int)getpid(), NextTempId++);
+
+	PathBuffer tempPath;
+	if (tempPath.Assign(Path) != 0 || tempPath.Append(suffix) != 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	NumSystemCalls++;
+	if (symlinkat(Target, DirFd, tempPath.Get()) != 0)
+	{
+		return GetLastError();
+	}
+
+	// rename replaces the destination atomically, so the link is never missing
+	NumSystemCalls++;
+	if (renameat(DirFd, tempPath.Get(), DirFd, Path) != 0)
+	{
+		DWORD result = GetLastError();
+		NumSystemCalls++;
+		unlinkat(DirFd, tempPath.Get(), 0);
+		return result;
+	}
+
+	return 0;
+}
+
+/**
+ * Reads a symbolic link with one lstat and one readlink.
+ *
+ * @param DirFd The directory that Path is relative to, or AT_FDCWD if Path is a full path.
+ * @param Path The path of the link.
+ * @param Info The contents of the link. [OUT]
+ */
+static DWORD ReadSymlink(int DirFd, LPCTSTR Path, ReparsePointInfo& Info)
+{
+	struct stat st;
+	NumSystemCalls++;
+	if (fstatat(DirFd, Path, &st, AT_SYMLINK_NOFOLLOW) != 0)
+	{
+		return GetLastError();
+	}
+	else if (!S_ISLNK(st.st_mode))
+	{
+		return ERROR_NOT_A_REPARSE_POINT;
+	}
+
+	// lstat reports the length of the target, so it can be read straight into a buffer of the right size. Some
+	// pseudo file systems report zero instead.
+	size_t size = st.st_size > 0 ? (size_t)st.st_size : PATH_MAX;
+	LPTSTR buffer = Info.Target.Reserve(size);
+	if (buffer == NULL)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	NumSystemCalls++;
+	ssize_t length = readlinkat(DirFd, Path, buffer, size);
+	if (length < 0)
+	{
+		return GetLastError();
+	}
+
+	Info.Target.SetLength((size_t)length);
+	Info.Tag = IO_REPARSE_TAG_SYMLINK;
+	Info.PrintName = Info.Target;
+
+	return 0;
+}
+
+#ifdef __linux__
+/** A directory entry as read by getdents64, which older C libraries don't declare. */
+struct LinuxDirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+#endif
+
+/**
+ * Returns true if the given name is the '.' or '..' entry of a directory.
+ */
+static bool IsDotEntry(const char* Name)
+{
+	return Name[0] == 0 || (Name[0] == '.' && Name[1] == 0) || (Name[0] == '.' && Name[1] == '.' && Name[2] == 0);
+}
+
+/**
+ * Sets the attributes of an entry from the type reported by the enumeration. Only file systems that don't report a
+ * type need an lstat.
+ *
+ * @param DirFd The directory being enumerated.
+ * @param Type The d_type of the entry.
+ * @param Entry The entry, whose name must already be set. [IN/OUT]
+ */
+static void SetEntryType(int DirFd, unsigned char Type, DirectoryEntry& Entry)
+{
+	if (Type == DT_UNKNOWN)
+	{
+		struct stat st;
+		NumSystemCalls++;
+		if (fstatat(DirFd, Entry.Name, &st, AT_SYMLINK_NOFOLLOW) == 0)
+		{
+			Type = S_ISLNK(st.st_mode) ? DT_LNK : S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+		}
+	}
+
+	Entry.ReparseTag = 0;
+	if (Type == DT_LNK)
+	{
+		Entry.Attributes = FILE_ATTRIBUTE_REPARSE_POINT;
+		Entry.ReparseTag = IO_REPARSE_TAG_SYMLINK;
+	}
+	else if (Type == DT_DIR)
+	{
+		Entry.Attributes = FILE_ATTRIBUTE_DIRECTORY;
+	}
+	else
+	{
+		Entry.Attributes = FILE_ATTRIBUTE_NORMAL;
+	}
+}
+
+const size_t PosixFileSystem::DefaultEnumerateBufferSize;
+const size_t PosixFileSystem::MinEnumerateBufferSize;
+
+PosixFileSystem::PosixFileSystem()
+	: EnumerateBufferSize(DefaultEnumerateBufferSize)
+{
+}
+
+void PosixFileSystem::SetEnumerateBufferSize(size_t Bytes)
+{
+	EnumerateBufferSize = Bytes < MinEnumerateBufferSize ? MinEnumerateBufferSize : Bytes;
+}
+
+DWORD PosixFileSystem::GetAttributes(LPCTSTR Path, DWORD& Attributes)
+{
+	struct stat st;
+	NumSystemCalls++;
+	if (lstat(Path, &st) != 0)
+	{
+		return GetLastError();
+	}
+
+	if (S_ISLNK(st.st_mode))
+	{
+		Attributes = FILE_ATTRIBUTE_REPARSE_POINT;
+	}
+	else if (S_ISDIR(st.st_mode))
+	{
+		Attributes = FILE_ATTRIBUTE_DIRECTORY;
+	}
+	else
+	{
+		Attributes = FILE_ATTRIBUTE_NORMAL;
+	}
+
+	return 0;
+}
+
+DWORD PosixFileSystem::GetLastWriteTime(LPCTSTR Path, ULONGLONG& Time)
+{
+	struct stat st;
+	NumSystemCalls++;
+	if (lstat(Path, &st) != 0)
+	{
+		return GetLastError();
+	}
+
+	Time = (ULONGLONG)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	return 0;
+}
+
+DWORD PosixFileSystem::Enumerate(LPCTSTR Path, EnumerateCallback Callback, void* Context)
+{
+#ifdef __linux__
+	NumSystemCalls++;
+	int fd = open(Path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return GetLastError();
+	}
+
+	// The buffer is left uninitialized, as it can be large and most directories only fill a small part of it
+	size_t bufferSize = EnumerateBufferSize;
+	char* buffer = (char*)malloc(bufferSize);
+	if (buffer == NULL)
+	{
+		NumSystemCalls++;
+		close(fd);
+		return ERROR_NOT_ENOUGH_MEMORY;
+	}
+
+	// Each buffer full of entries is handed on as one batch, with the names pointing straight into the buffer. The
+	// descriptor stays open until the last batch has been handled so that the entries can be used relative to it.
+	DirectoryHandle directory = { Path, fd };
+	std::vector<DirectoryEntry> entries;
+	DWORD result = 0;
+	for (;;)
+	{
+		NumSystemCalls++;
+		long length = syscall(SYS_getdents64, fd, buffer, bufferSize);
+		if (length <= 0)
+		{
+			result = length < 0 ? GetLastError() : 0;
+			break;
+		}
+
+		entries.clear();
+		for (long offset = 0; offset < length; )
+		{
+			const LinuxDirent64* dirent = (const LinuxDirent64*)&buffer[offset];
+			offset += dirent->d_reclen;
+			if (IsDotEntry(dirent->d_name))
+			{
+				continue;
+			}
+
+			DirectoryEntry entry;
+			entry.Name = dirent->d_name;
+			SetEntryType(fd, dirent->d_type, entry);
+			entries.push_back(entry);
+		}
+
+		if (!entries.empty())
+		{
+			Callback(Context, directory, &entries[0], entries.size());
+		}
+	}
+
+	free(buffer);
+	NumSystemCalls++;
+	close(fd);
+
+	return result;
+#else
+	NumSystemCalls++;
+	DIR* dir = opendir(Path);
+	if (dir == NULL)
+	{
+		return GetLastError();
+	}
+
+	// The next call to readdir may reuse the name, so each entry is handed on by itself
+	DirectoryHandle directory = { Path, dirfd(dir) };
+	for (;;)
+	{
+		errno = 0;
+		struct dirent* entry = readdir(dir);
+		if (entry == NULL)
+		{
+			break;
+		}
+		else if (IsDotEntry(entry->d_name))
+		{
+			continue;
+		}
+
+		DirectoryEntry dirEntry;
+		dirEntry.Name = entry->d_name;
+		SetEntryType((int)directory.Native, entry->d_type, dirEntry);
+		Callback(Context, directory, &dirEntry, 1);
+	}
+
+	DWORD result = GetLastError();
+	NumSystemCalls++;
+	closedir(dir);
+
+	return result;
+#endif
+}
+
+DWORD PosixFileSystem::ReadLink(LPCTSTR Path, ReparsePointInfo& Info)
+{
+	return ReadSymlink(AT_FDCWD, Path, Info);
+}
+
+DWORD PosixFileSystem::ReadLinkAt(const DirectoryHandle& Directory, LPCTSTR Name, ReparsePointInfo& Info)
+{
+	return ReadSymlink((int)Directory.Native, Name, Info);
+}
+
+DWORD PosixFileSystem::CreateLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT ? CreateJunction(Path, Target) : CreateSymlink(Path, Target);
+}
+
+DWORD PosixFileSystem::SetLinkTarget(DWORD /*Tag*/, LPCTSTR Path, LPCTSTR Target)
+{
+	return ReplaceSymlink(AT_FDCWD, Path, Target);
+}
+
+DWORD PosixFileSystem::SetLinkTargetAt(DWORD /*Tag*/, const DirectoryHandle& Directory, LPCTSTR Name, LPCTSTR Target)
+{
+	return ReplaceSymlink((int)Directory.Native, Name, Target);
+}
+
+DWORD PosixFileSystem::DeleteLink(DWORD Tag, LPCTSTR Path)
+{
+	return Tag == IO_REPARSE_TAG_MOUNT_POINT ? DeleteJunction(Path) : DeleteSymlink(Path);
+}
+
+DWORD PosixFileSystem::DeleteLinkAt(DWORD /*Tag*/, const DirectoryHandle& Directory, LPCTSTR Name)
+{
+	// Junctions are created as symbolic links, so both kinds are unlinked
+	NumSystemCalls++;
+	return unlinkat((int)Directory.Native, Name, 0) == 0 ? 0 : GetLastError();
+}
+
+DWORD PosixFileSystem::Rename(LPCTSTR OldPath, LPCTSTR NewPath)
+{
+	NumSystemCalls++;
+	return rename(OldPath, NewPath) == 0 ? 0 : GetLastError();
+}
+
+DWORD PosixFileSystem::CreateDirectoryFrom(LPCTSTR TemplatePath, LPCTSTR Path)
+{
+	struct stat st;
+	mode_t mode = 0777;
+	NumSystemCalls++;
+	if (stat(TemplatePath, &st) == 0)
+	{
+		mode = st.st_mode & 07777;
+	}
+
+	NumSystemCalls++;
+	return mkdir(Path, mode) == 0 ? 0 : GetLastError();
+}
+
+DWORD PosixFileSystem::CreateEmptyFile(LPCTSTR Path)
+{
+	NumSystemCalls++;
+	int fd = open(Path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd < 0)
+	{
+		return GetLastError();
+	}
+
+	NumSystemCalls++;
+	close(fd);
+	return 0;
+}
+
+DWORD PosixFileSystem::RemoveFile(LPCTSTR Path)
+{
+	NumSystemCalls++;
+	return unlink(Path) == 0 ? 0 : GetLastError();
+}
+
+DWORD PosixFileSystem::RemoveEmptyDirectory(LPCTSTR Path)
+{
+	NumSystemCalls++;
+	return rmdir(Path) == 0 ? 0 : GetLastError();
+}
+
+ChangeWatcher* PosixFileSystem::CreateWatcher()
+{
+#ifdef __linux__
+	InotifyWatcher* watcher = new InotifyWatcher();
+	if (watcher->Open() != 0)
+	{
+		delete watcher;
+		return NULL;
+	}
+
+	return watcher;
+#else
+	return NULL;
+#endif
+}
+
+#endif //_WIN32
@@ -0,0 +1,169 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef _WIN32
+
+#include "NtfsLinks.h"
+#include "Platform.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::atomic<ULONGLONG> NumSystemCalls(0);
+
+namespace libntfslinks
+{
+
+bool IsJunction(LPCTSTR /*Path*/)
+{
+	errno = 0;
+	return false;
+}
+
+DWORD GetJunctionTarget(LPCTSTR Path, LPTSTR TargetPath, size_t TargetSize)
+{
+	return GetSymlinkTarget(Path, TargetPath, TargetSize);
+}
+
+DWORD CreateJunction(LPCTSTR Link, LPCTSTR Target)
+{
+	return CreateSymlink(Link, Target);
+}
+
+DWORD DeleteJunction(LPCTSTR Path)
+{
+	return DeleteSymlink(Path);
+}
+
+bool IsSymlink(LPCTSTR Path)
+{
+	struct stat st;
+	NumSystemCalls++;
+	if (lstat(Path, &st) != 0)
+	{
+		return false;
+	}
+
+	errno = 0;
+	return S_ISLNK(st.st_mode);
+}
+
+DWORD GetSymlinkTarget(LPCTSTR Path, LPTSTR TargetPath, size_t TargetSize)
+{
+	if (TargetSize == 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	NumSystemCalls++;
+	ssize_t length = readlink(Path, TargetPath, TargetSize - 1);
+	if (length < 0)
+	{
+		return GetLastError();
+	}
+
+	TargetPath[length] = 0;
+	return 0;
+}
+
+DWORD CreateSymlink(LPCTSTR Link, LPCTSTR Target)
+{
+	NumSystemCalls++;
+	return symlink(Target, Link) == 0 ? 0 : GetLastError();
+}
+
+DWORD DeleteSymlink(LPCTSTR Path)
+{
+	NumSystemCalls++;
+	return unlink(Path) == 0 ? 0 : GetLastError();
+}
+
+} // namespace libntfslinks
+
+int StrFind(LPCTSTR Str, LPCTSTR Sub, int StartIdx, int Dir)
+{
+	int strLength = (int)strlen(Str);
+	int subLength = (int)strlen(Sub);
+	if (subLength == 0 || subLength > strLength)
+	{
+		return -1;
+	}
+
+	// A negative starting index counts backwards from the end of the string
+	int idx = StartIdx < 0 ? strLength + StartIdx : StartIdx;
+	if (idx < 0 || idx >= strLength)
+	{
+		return -1;
+	}
+
+	if (Dir >= 0)
+	{
+		for (; idx + subLength <= strLength; idx++)
+		{
+			if (strncmp(&Str[idx], Sub, subLength) == 0)
+			{
+				return idx;
+			}
+		}
+	}
+	else
+	{
+		if (idx + subLength > strLength)
+		{
+			idx = strLength - subLength;
+		}
+
+		for (; idx >= 0; idx--)
+		{
+			if (strncmp(&Str[idx], Sub, subLength) == 0)
+			{
+				return idx;
+			}
+		}
+	}
+
+	return -1;
+}
+
+bool StrReplace(LPCTSTR SrcStr, LPCTSTR Search, LPCTSTR Replace, LPTSTR DestStr, int StartIdx, int Dir)
+{
+	// DestStr is assumed to be MAX_PATH characters, as it is for every caller of the libntfslinks version
+	int idx = StrFind(SrcStr, Search, StartIdx, Dir);
+	if (idx < 0)
+	{
+		StringCchCopy(DestStr, MAX_PATH, SrcStr);
+		return false;
+	}
+
+	StringCchCopy(DestStr, idx + 1 < MAX_PATH ? idx + 1 : MAX_PATH, SrcStr);
+	StringCchCat(DestStr, MAX_PATH, Replace);
+	return SUCCEEDED(StringCchCat(DestStr, MAX_PATH, &SrcStr[idx + strlen(Search)]));
+}
+
+#endif //_WIN32
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RemoveLink.h"
+
+#include "LinkIndex.h"
+#include "Log.h"
+#include "NtfsLinks.h"
+#include "ReparsePoint.h"
+#include "TreeWalker.h"
+
+using namespace libntfslinks;
+
+namespace
+{
+
+/**
+ * Deletes each reparse point found in the tree.
+ */
+class RemoveLinkVisitor : public TreeVisitor
+{
+public:
+	RemoveLinkVisitor(const rmlinkOptions& Options, rmlinkStats& Stats)
+		: Options(Options)
+		, Stats(Stats)
+	{
+	}
+
+	virtual bool VisitDirectory(const WalkEntry& /*Entry*/)
+	{
+		return true;
+	}
+
+	virtual void VisitLink(const WalkEntry& Entry)
+	{
+		DWORD result = 0;
+		LPCTSTR Path = Entry.Path;
+
+		// Is this a junction or a symlink? The enumeration normally reports the tag so the link needn't be opened. A dry
+		// run opens it anyway to record its target in the plan, as does filtering or selecting on the target.
+		ReparsePointInfo Info;
+		Info.Tag = Entry.ReparseTag;
+		bool bNeedTarget = Options.Plan != NULL || Options.Selector != NULL ||
+			(Options.Filter != NULL && Options.Filter->HasTargetPatterns());
+		if (Info.Tag == 0 || (bNeedTarget && IsLinkTag(Info.Tag)))
+		{
+			result = GetReparsePointInfoAt(Entry.Directory, Entry.Name, Info);
+		}
+
+		// Links whose target is filtered out or not selected are left alone
+		if (result == 0 && IsLinkTag(Info.Tag) && Options.Filter != NULL &&
+			!Options.Filter->MatchesLinkTarget(Info.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return;
+		}
+		if (result == 0 && IsLinkTag(Info.Tag) && Options.Selector != NULL &&
+			!Options.Selector->IsSelected(Path, Info.Target.Get()))
+		{
+			Stats.NumSkipped++;
+			return;
+		}
+
+		if (result == 0)
+		{
+			if (Options.Plan != NULL && IsLinkTag(Info.Tag))
+			{
+				// A dry run only records what would be done
+				Options.Plan->Add(PlanRemove, Info.Tag, Path, NULL, Info.Target.Get(), NULL);
+				Stats.NumDeleted++;
+			}
+			else if (IsLinkTag(Info.Tag))
+			{
+				// Delete the junction or symlink relative to the enumerated directory
+				result = DeleteReparseLinkAt(Info.Tag, Entry.Directory, Entry.Name);
+				if (result == 0)
+				{
+					Stats.NumDeleted++;
+				}
+			}
+			else
+			{
+				LogMessage(TEXT("Unrecognized reparse point: %s\n"), Path);
+				Stats.NumSkipped++;
+			}
+		}
+
+		// Was the operation successful?
+		if (result != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(result, Path);
+		}
+	}
+
+	virtual void VisitError(const WalkEntry& Entry, DWORD ErrorCode)
+	{
+		// If we failed to be able to read the directory listing due to a access violation count it as a skip
+		// instead of a complete failure.
+		if (ErrorCode == ERROR_ACCESS_DENIED && (Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+		{
+			PrintErrorMessage(ErrorCode, Entry.Path);
+			Stats.NumSkipped++;
+		}
+		else
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(ErrorCode, Entry.Path);
+		}
+	}
+
+private:
+	const rmlinkOptions& Options;
+	rmlinkStats& Stats;
+
+	// Not copyable
+	RemoveLinkVisitor& operator=(const RemoveLinkVisitor&);
+};
+
+} // namespace
+
+DWORD rmlink(LPCTSTR Path, const rmlinkOptions& Options, rmlinkStats& Stats)
+{
+	return rmlink(std::vector<LPCTSTR>(1, Path), Options, Stats);
+}
+
+DWORD rmlink(const std::vector<LPCTSTR>& Paths, const rmlinkOptions& Options, rmlinkStats& Stats)
+{
+	// Only the directories that changed since the index was written are enumerated
+	LinkIndex index;
+	LinkIndex* pIndex = NULL;
+	if (!Options.IndexPath.IsEmpty())
+	{
+		pIndex = &index;
+		DWORD indexResult = index.Load(Options.IndexPath.Get());
+		if (indexResult != 0 && indexResult != ERROR_FILE_NOT_FOUND)
+		{
+			LogMessage(TEXT("Unable to read index %s, the entire tree will be scanned.\n"), Options.IndexPath.Get());
+		}
+	}
+
+	RemoveLinkVisitor visitor(Options, Stats);
+	TreeWalker walker(visitor, Options.NumThreads, Options.MaxDepth, pIndex, Options.Order);
+	walker.SetProgress(Options.Progress);
+	walker.SetFilter(Options.Filter);
+	DWORD result = walker.Walk(Paths);
+
+	// Save the index for the next run. A dry run leaves it as it was.
+	if (pIndex != NULL && Options.Plan == NULL)
+	{
+		DWORD indexResult = index.Save(Options.IndexPath.Get());
+		if (indexResult != 0)
+		{
+			Stats.NumFailed++;
+			PrintErrorMessage(indexResult, Options.IndexPath.Get());
+		}
+	}
+
+	return result;
+}
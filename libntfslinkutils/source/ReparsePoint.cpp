@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReparsePoint.h"
+
+#include "FileSystemBackend.h"
+#include "Metrics.h"
+
+namespace libntfslinks
+{
+
+DWORD GetReparsePointInfo(LPCTSTR Path, ReparsePointInfo& Info)
+{
+	MetricTimer timer(MetricRead);
+
+	Info.Tag = 0;
+	Info.Target.Truncate(0);
+	Info.PrintName.Truncate(0);
+
+	return GetFileSystemBackend().ReadLink(Path, Info);
+}
+
+DWORD GetReparsePointInfoAt(const DirectoryHandle* Directory, LPCTSTR Name, ReparsePointInfo& Info)
+{
+	if (Directory == NULL)
+	{
+		return GetReparsePointInfo(Name, Info);
+	}
+	else if (!Directory->IsOpen())
+	{
+		// The backend didn't open the directory, so the entry is named by its full path instead
+		PathBuffer path;
+		if (CombinePath(path, Directory->Path, Name) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+		return GetReparsePointInfo(path.Get(), Info);
+	}
+
+	MetricTimer timer(MetricRead);
+
+	Info.Tag = 0;
+	Info.Target.Truncate(0);
+	Info.PrintName.Truncate(0);
+
+	return GetFileSystemBackend().ReadLinkAt(*Directory, Name, Info);
+}
+
+DWORD SetJunctionTarget(LPCTSTR Path, LPCTSTR Target)
+{
+	MetricTimer timer(MetricModify);
+
+	return GetFileSystemBackend().SetLinkTarget(IO_REPARSE_TAG_MOUNT_POINT, Path, Target);
+}
+
+DWORD SetSymlinkTarget(LPCTSTR Path, LPCTSTR Target)
+{
+	MetricTimer timer(MetricModify);
+
+	return GetFileSystemBackend().SetLinkTarget(IO_REPARSE_TAG_SYMLINK, Path, Target);
+}
+
+DWORD SetReparseTargetAt(DWORD Tag, const DirectoryHandle* Directory, LPCTSTR Name, LPCTSTR Target)
+{
+	MetricTimer timer(MetricModify);
+
+	if (Directory == NULL)
+	{
+		return GetFileSystemBackend().SetLinkTarget(Tag, Name, Target);
+	}
+	else if (!Directory->IsOpen())
+	{
+		PathBuffer path;
+		if (CombinePath(path, Directory->Path, Name) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+		return GetFileSystemBackend().SetLinkTarget(Tag, path.Get(), Target);
+	}
+
+	return GetFileSystemBackend().SetLinkTargetAt(Tag, *Directory, Name, Target);
+}
+
+DWORD CreateReparseLink(DWORD Tag, LPCTSTR Path, LPCTSTR Target)
+{
+	MetricTimer timer(MetricCreate);
+
+	return GetFileSystemBackend().CreateLink(Tag, Path, Target);
+}
+
+DWORD DeleteReparseLink(DWORD Tag, LPCTSTR Path)
+{
+	MetricTimer timer(MetricDelete);
+
+	return GetFileSystemBackend().DeleteLink(Tag, Path);
+}
+
+DWORD DeleteReparseLinkAt(DWORD Tag, const DirectoryHandle* Directory, LPCTSTR Name)
+{
+	MetricTimer timer(MetricDelete);
+
+	if (Directory == NULL)
+	{
+		return GetFileSystemBackend().DeleteLink(Tag, Name);
+	}
+	else if (!Directory->IsOpen())
+	{
+		PathBuffer path;
+		if (CombinePath(path, Directory->Path, Name) != 0)
+		{
+			return ERROR_FILENAME_EXCED_RANGE;
+		}
+		return GetFileSystemBackend().DeleteLink(Tag, path.Get());
+	}
+
+	return GetFileSystemBackend().DeleteLinkAt(Tag, *Directory, Name);
+}
+
+} // namespace libntfslinks
@@ -0,0 +1,274 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RewriteRules.h"
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace
+{
+
+/**
+ * Removes leading and trailing whitespace, including line endings, from the given range.
+ */
+void Trim(LPCTSTR& Begin, LPCTSTR& End)
+{
+	while (Begin < End && (*Begin == ' ' || *Begin == '\t'))
+	{
+		Begin++;
+	}
+	while (End > Begin && (End[-1] == ' ' || End[-1] == '\t' || End[-1] == '\r' || End[-1] == '\n'))
+	{
+		End--;
+	}
+}
+
+} // namespace
+
+/**
+ * Orders matches by their start position, longest first.
+ */
+struct RewriteRules::MatchOrder
+{
+	explicit MatchOrder(const std::vector<Rule>& Rules)
+		: Rules(&Rules)
+	{
+	}
+
+	bool operator()(const Match& A, const Match& B) const
+	{
+		if (A.Start != B.Start)
+		{
+			return A.Start < B.Start;
+		}
+
+		return (*Rules)[A.Rule].Find.size() > (*Rules)[B.Rule].Find.size();
+	}
+
+	const std::vector<Rule>* Rules;
+};
+
+RewriteRules::RewriteRules()
+{
+	Compile();
+}
+
+DWORD RewriteRules::Load(LPCTSTR RulesPath)
+{
+#ifdef UNICODE
+	FILE* file = _tfopen(RulesPath, TEXT("rt, ccs=UTF-8"));
+#else
+	FILE* file = _tfopen(RulesPath, TEXT("rt"));
+#endif
+	if (file == NULL)
+	{
+		return GetLastError();
+	}
+
+	DWORD result = 0;
+	// Room for two paths of the longest length plus the separator
+	std::vector<TCHAR> Line(MAX_LONG_PATH * 2 + 16);
+	while (result == 0 && _fgetts(&Line[0], (int)Line.size(), file) != NULL)
+	{
+		LPCTSTR begin = &Line[0];
+		LPCTSTR end = begin + _tcslen(begin);
+		Trim(begin, end);
+
+		// Skip blank lines and comments
+		if (begin == end || *begin == '#')
+		{
+			continue;
+		}
+
+		LPCTSTR separator = begin;
+		while (separator < end && *separator != '|')
+		{
+			separator++;
+		}
+
+		LPCTSTR findEnd = separator;
+		LPCTSTR replaceBegin = separator + 1;
+		LPCTSTR replaceEnd = end;
+		Trim(begin, findEnd);
+		Trim(replaceBegin, replaceEnd);
+		if (separator == end || begin == findEnd)
+		{
+			result = ERROR_BAD_FORMAT;
+			break;
+		}
+
+		Rule rule;
+		rule.Find.assign(begin, findEnd);
+		rule.Replace.assign(replaceBegin, replaceBegin < replaceEnd ? replaceEnd : replaceBegin);
+		Rules.push_back(rule);
+	}
+
+	fclose(file);
+	Compile();
+
+	return result;
+}
+
+void RewriteRules::AddRule(LPCTSTR Find, LPCTSTR Replace)
+{
+	Rule rule;
+	rule.Find = Find;
+	rule.Replace = Replace;
+	Rules.push_back(rule);
+}
+
+void RewriteRules::Compile()
+{
+	States.clear();
+
+	State root;
+	root.Fail = 0;
+	root.Rule = -1;
+	root.Output = -1;
+	States.push_back(root);
+
+	// Build the trie of all find strings
+	for (size_t i = 0; i < Rules.size(); i++)
+	{
+		const String& find = Rules[i].Find;
+		int state = 0;
+		for (size_t j = 0; j < find.size(); j++)
+		{
+			std::map<TCHAR, int>::const_iterator next = States[state].Next.find(find[j]);
+			if (next != States[state].Next.end())
+			{
+				state = next->second;
+				continue;
+			}
+
+			State child;
+			child.Fail = 0;
+			child.Rule = -1;
+			child.Output = -1;
+			States.push_back(child);
+			States[state].Next[find[j]] = (int)States.size() - 1;
+			state = (int)States.size() - 1;
+		}
+
+		// The first of several identical rules wins
+		if (!find.empty() && States[state].Rule < 0)
+		{
+			States[state].Rule = (int)i;
+		}
+	}
+
+	// Link each state to its longest proper suffix, breadth first so that shorter states are always linked first
+	std::deque<int> pending;
+	for (std::map<TCHAR, int>::const_iterator it = States[0].Next.begin(); it != States[0].Next.end(); ++it)
+	{
+		pending.push_back(it->second);
+	}
+
+	while (!pending.empty())
+	{
+		int state = pending.front();
+		pending.pop_front();
+
+		for (std::map<TCHAR, int>::const_iterator it = States[state].Next.begin(); it != States[state].Next.end(); ++it)
+		{
+			TCHAR c = it->first;
+			int child = it->second;
+
+			int fail = States[state].Fail;
+			while (fail != 0 && States[fail].Next.find(c) == States[fail].Next.end())
+			{
+				fail = States[fail].Fail;
+			}
+
+			std::map<TCHAR, int>::const_iterator next = States[fail].Next.find(c);
+			States[child].Fail = next != States[fail].Next.end() ? next->second : 0;
+
+			int suffix = States[child].Fail;
+			States[child].Output = States[suffix].Rule >= 0 ? suffix : States[suffix].Output;
+			pending.push_back(child);
+		}
+	}
+}
+
+DWORD RewriteRules::Rewrite(LPCTSTR Target, PathBuffer& Result) const
+{
+	MetricTimer timer(MetricRewrite);
+
+	// Find every rule that occurs in the target with a single scan
+	std::vector<Match> matches;
+	int state = 0;
+	for (size_t i = 0; Target[i] != 0; i++)
+	{
+		std::map<TCHAR, int>::const_iterator next;
+		while ((next = States[state].Next.find(Target[i])) == States[state].Next.end() && state != 0)
+		{
+			state = States[state].Fail;
+		}
+		state = next != States[state].Next.end() ? next->second : 0;
+
+		for (int output = States[state].Rule >= 0 ? state : States[state].Output; output >= 0;
+			output = States[output].Output)
+		{
+			Match match;
+			match.Rule = States[output].Rule;
+			match.Start = i + 1 - Rules[match.Rule].Find.size();
+			matches.push_back(match);
+		}
+	}
+
+	// Order the matches leftmost first, longest first, and replace those that don't overlap an earlier one
+	std::sort(matches.begin(), matches.end(), MatchOrder(Rules));
+
+	String rewritten;
+	size_t copied = 0;
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		if (matches[i].Start < copied)
+		{
+			continue;
+		}
+
+		const Rule& rule = Rules[matches[i].Rule];
+		rewritten.append(Target + copied, Target + matches[i].Start);
+		rewritten.append(rule.Replace);
+		copied = matches[i].Start + rule.Find.size();
+	}
+
+	LPCTSTR Source = Target;
+	if (!matches.empty())
+	{
+		rewritten.append(Target + copied);
+		Source = rewritten.c_str();
+	}
+
+	return Result.Assign(Source);
+}
@@ -0,0 +1,333 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RootMap.h"
+
+#include "Metrics.h"
+
+namespace
+{
+
+/**
+ * Returns true if the given character separates path components.
+ */
+bool IsSeparator(TCHAR c)
+{
+#ifdef _WIN32
+	return c == '\\' || c == '/';
+#else
+	return c == '/';
+#endif
+}
+
+/**
+ * Folds a character for comparison. NTFS names are compared without regard to case, POSIX names are not.
+ */
+TCHAR FoldCase(TCHAR c)
+{
+#ifdef _WIN32
+	return (TCHAR)_totlower(c);
+#else
+	return c;
+#endif
+}
+
+/**
+ * Returns the length of the native "\??\" or "\\?\" prefix of the given path, if it has one.
+ */
+size_t GetPrefixLength(LPCTSTR Path)
+{
+#ifdef _WIN32
+	if (Path[0] == '\\' && (Path[1] == '?' || Path[1] == '\\') && Path[2] == '?' && Path[3] == '\\')
+	{
+		return 4;
+	}
+#else
+	(void)Path;
+#endif
+	return 0;
+}
+
+/**
+ * Reads the next component of a path. A leading separator is returned as an empty component so that absolute and
+ * relative paths never match each other, after which runs of separators are skipped.
+ *
+ * @param Path The path being read. Advanced past the component and any separators that follow it. [IN/OUT]
+ * @param Component The folded component. [OUT]
+ * @param End The end of the component within the path. [OUT]
+ * @return Returns false if there are no more components.
+ */
+bool NextComponent(LPCTSTR& Path, std::basic_string<TCHAR>& Component, LPCTSTR& End)
+{
+	Component.clear();
+	if (*Path == 0)
+	{
+		return false;
+	}
+
+	if (!IsSeparator(*Path))
+	{
+		while (*Path != 0 && !IsSeparator(*Path))
+		{
+			Component.push_back(FoldCase(*Path));
+			Path++;
+		}
+	}
+
+	End = Path;
+	while (IsSeparator(*Path))
+	{
+		Path++;
+	}
+
+	return true;
+}
+
+/**
+ * Returns the given path without its native prefix or trailing separators.
+ */
+std::basic_string<TCHAR> TrimRoot(LPCTSTR Path)
+{
+	Path += GetPrefixLength(Path);
+
+	size_t length = _tcslen(Path);
+	while (length > 0 && IsSeparator(Path[length - 1]))
+	{
+		length--;
+	}
+
+	return std::basic_string<TCHAR>(Path, length);
+}
+
+} // namespace
+
+RootMap::RootMap()
+{
+	Node root;
+	root.Root = -1;
+	root.bHasDeeperRoot = false;
+	Nodes.push_back(root);
+
+	for (int i = 0; i < NumRecent; i++)
+	{
+		Recent[i] = -1;
+	}
+}
+
+void RootMap::AddRoot(LPCTSTR OldRoot, LPCTSTR NewRoot)
+{
+	// Walk the components of the old root, adding nodes as needed
+	String component;
+	LPCTSTR path = OldRoot + GetPrefixLength(OldRoot);
+	LPCTSTR end = path;
+	int node = 0;
+	std::vector<int> parents;
+	while (NextComponent(path, component, end))
+	{
+		parents.push_back(node);
+
+		std::map<String, int>::const_iterator child = Nodes[node].Children.find(component);
+		if (child != Nodes[node].Children.end())
+		{
+			node = child->second;
+			continue;
+		}
+
+		Node next;
+		next.Root = -1;
+		next.bHasDeeperRoot = false;
+		Nodes.push_back(next);
+		Nodes[node].Children[component] = (int)Nodes.size() - 1;
+		node = (int)Nodes.size() - 1;
+	}
+
+	Root root;
+	root.OldRoot = TrimRoot(OldRoot);
+	root.NewRoot = TrimRoot(NewRoot);
+	root.Node = node;
+
+	if (Nodes[node].Root >= 0)
+	{
+		Roots[Nodes[node].Root] = root;
+		return;
+	}
+
+	Roots.push_back(root);
+	Nodes[node].Root = (int)Roots.size() - 1;
+	for (size_t i = 0; i < parents.size(); i++)
+	{
+		Nodes[parents[i]].bHasDeeperRoot = true;
+	}
+}
+
+DWORD RootMap::Rebase(LPCTSTR Target, PathBuffer& Result) const
+{
+	MetricTimer timer(MetricRewrite);
+
+	// Match against the remembered roots first, then against the trie
+	size_t prefixLength = GetPrefixLength(Target);
+	LPCTSTR path = Target + prefixLength;
+	size_t length = 0;
+	int rootIdx = FindRecent(path, length);
+	if (rootIdx < 0)
+	{
+		rootIdx = FindRoot(path, length);
+		if (rootIdx < 0)
+		{
+			return Result.Assign(Target);
+		}
+
+		AddRecent(rootIdx);
+	}
+
+	// Keep the native prefix and whatever follows the old root, including the separator
+	String rebased(Target, prefixLength);
+	rebased.append(Roots[rootIdx].NewRoot);
+	rebased.append(path + length);
+	if (rebased.size() == prefixLength)
+	{
+		rebased.push_back(PATH_SEPARATOR);
+	}
+
+	return Result.Assign(rebased.c_str(), rebased.size());
+}
+
+bool RootMap::Contains(LPCTSTR Target, size_t* Length) const
+{
+	size_t prefixLength = GetPrefixLength(Target);
+	LPCTSTR path = Target + prefixLength;
+	size_t length = 0;
+	int rootIdx = FindRecent(path, length);
+	if (rootIdx < 0)
+	{
+		rootIdx = FindRoot(path, length);
+		if (rootIdx < 0)
+		{
+			return false;
+		}
+
+		AddRecent(rootIdx);
+	}
+
+	if (Length != NULL)
+	{
+		*Length = prefixLength + length;
+	}
+
+	return true;
+}
+
+/**
+ * Matches the path against the recently matched roots.
+ *
+ * @param Path The path to match, without its native prefix.
+ * @param Length The length of the matched old root within Path. [OUT]
+ * @return Returns the index of the matched root, or -1 if none of the recent roots matched.
+ */
+int RootMap::FindRecent(LPCTSTR Path, size_t& Length) const
+{
+	for (int i = 0; i < NumRecent; i++)
+	{
+		int rootIdx = Recent[i];
+		if (rootIdx < 0)
+		{
+			break;
+		}
+
+		const String& oldRoot = Roots[rootIdx].OldRoot;
+		size_t j = 0;
+		while (j < oldRoot.size() && Path[j] != 0 && FoldCase(Path[j]) == FoldCase(oldRoot[j]))
+		{
+			j++;
+		}
+
+		// The old root must end on a component boundary of the path
+		if (j == oldRoot.size() && (Path[j] == 0 || IsSeparator(Path[j])))
+		{
+			Length = j;
+			return rootIdx;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Walks the trie along the components of the path, remembering the deepest root passed.
+ *
+ * @param Path The path to match, without its native prefix.
+ * @param Length The length of the matched old root within Path. [OUT]
+ * @return Returns the index of the matched root, or -1 if the path is not beneath any root.
+ */
+int RootMap::FindRoot(LPCTSTR Path, size_t& Length) const
+{
+	int rootIdx = Nodes[0].Root;
+	Length = 0;
+
+	String component;
+	LPCTSTR path = Path;
+	LPCTSTR end = Path;
+	int node = 0;
+	while (Nodes[node].bHasDeeperRoot && NextComponent(path, component, end))
+	{
+		std::map<String, int>::const_iterator child = Nodes[node].Children.find(component);
+		if (child == Nodes[node].Children.end())
+		{
+			break;
+		}
+
+		node = child->second;
+		if (Nodes[node].Root >= 0)
+		{
+			rootIdx = Nodes[node].Root;
+			Length = end - Path;
+		}
+	}
+
+	return rootIdx;
+}
+
+/**
+ * Remembers a matched root if no deeper root could also match the same paths.
+ */
+void RootMap::AddRecent(int RootIdx) const
+{
+	if (Nodes[Roots[RootIdx].Node].bHasDeeperRoot || Recent[0] == RootIdx)
+	{
+		return;
+	}
+
+	// Other threads may shuffle the slots at the same time. Each slot always holds a valid root or -1, which is all
+	// that FindRecent relies on.
+	for (int i = NumRecent - 1; i > 0; i--)
+	{
+		Recent[i] = Recent[i - 1].load();
+	}
+	Recent[0] = RootIdx;
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TargetRewriter.h"
+
+#include "Metrics.h"
+#include "NtfsLinks.h"
+
+TargetRewriter::TargetRewriter(const RewriteRules* Rules, const RootMap* Roots, LPCTSTR OldTarget,
+	LPCTSTR NewTarget, TargetRewriteMode Mode)
+	: Rules(Rules)
+	, Roots(Roots)
+{
+	if (Rules != NULL || Roots != NULL || OldTarget[0] == 0)
+	{
+		return;
+	}
+
+	// A single old and new root pair is looked up through a map of its own
+	if (Mode == RewriteRebase)
+	{
+		if (NewTarget[0] != 0)
+		{
+			SingleRoot.AddRoot(OldTarget, NewTarget);
+			this->Roots = &SingleRoot;
+		}
+	}
+	else
+	{
+		Find = OldTarget;
+		Replace = NewTarget;
+	}
+}
+
+DWORD TargetRewriter::Rewrite(LPCTSTR Target, PathBuffer& Result) const
+{
+	if (Rules != NULL)
+	{
+		return Rules->Rewrite(Target, Result);
+	}
+	else if (Roots != NULL)
+	{
+		return Roots->Rebase(Target, Result);
+	}
+	else if (!Find.empty())
+	{
+		return ReplaceLast(Target, Result);
+	}
+
+	return Result.Assign(Target);
+}
+
+/**
+ * Replaces the last occurrence of Find in Target with Replace, as StrReplace does, without limiting the result to
+ * MAX_PATH characters.
+ */
+DWORD TargetRewriter::ReplaceLast(LPCTSTR Target, PathBuffer& Result) const
+{
+	MetricTimer timer(MetricRewrite);
+
+	int idx = StrFind(Target, Find.c_str(), -1, -1);
+	if (idx < 0)
+	{
+		return Result.Assign(Target);
+	}
+
+	if (Result.Assign(Target, idx) != 0 || Result.Append(Replace.c_str()) != 0 ||
+		Result.Append(&Target[idx + Find.size()]) != 0)
+	{
+		return ERROR_FILENAME_EXCED_RANGE;
+	}
+
+	return 0;
+}
@@ -0,0 +1,612 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TreeWalker.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdlib.h>
+#include <thread>
+
+TreeWalker::TreeWalker(TreeVisitor& Visitor, int NumWorkers, int MaxDepth, LinkIndex* Index, WalkOrder Order)
+	: Visitor(Visitor)
+	, MaxDepth(MaxDepth)
+	, Order(Order)
+	, Index(Index)
+	, Progress(NULL)
+	, Filter(NULL)
+	, Watcher(NULL)
+	, NumPending(0)
+	, NumQueued(0)
+	, NumIdle(0)
+{
+	NumWorkers = GetNumWorkers(NumWorkers);
+	for (int i = 0; i < NumWorkers; i++)
+	{
+		Queues.push_back(new WorkQueue());
+	}
+}
+
+TreeWalker::~TreeWalker()
+{
+	for (size_t i = 0; i < Queues.size(); i++)
+	{
+		delete Queues[i];
+	}
+}
+
+DWORD TreeWalker::Walk(LPCTSTR Root)
+{
+	return Walk(std::vector<LPCTSTR>(1, Root));
+}
+
+DWORD TreeWalker::Walk(const std::vector<LPCTSTR>& Roots)
+{
+	DWORD result = 0;
+
+	// Expand each root to a full path once. Every other path in the walk is built from them.
+	std::vector<PathBuffer> rootPaths(Roots.size());
+	std::vector<std::pair<size_t, size_t> > order;
+	for (size_t i = 0; i < Roots.size(); i++)
+	{
+		DWORD rootResult = GetFullPath(Roots[i], rootPaths[i]);
+		if (rootResult != 0)
+		{
+			Visitor.VisitError(MakeEntry(Roots[i], 0, 0, 0), rootResult);
+			result = result != 0 ? result : rootResult;
+			continue;
+		}
+
+		order.push_back(std::make_pair(rootPaths[i].Length(), i));
+	}
+
+	// Add the shortest roots first, so that a root is always added before any root nested beneath it
+	std::sort(order.begin(), order.end());
+
+	size_t nextWorker = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		DWORD rootResult = AddRoot(rootPaths[order[i].second].Get(), nextWorker);
+		result = result != 0 ? result : rootResult;
+	}
+
+	if (NumPending > 0)
+	{
+		Run();
+	}
+
+	return result;
+}
+
+void TreeWalker::WalkChanges(const std::vector<std::basic_string<TCHAR> >& Paths)
+{
+	// Look at the shortest paths first, so that a directory is queued before any change beneath it is looked at
+	std::vector<std::pair<size_t, std::basic_string<TCHAR> > > order;
+	for (size_t i = 0; i < Paths.size(); i++)
+	{
+		order.push_back(std::make_pair(Paths[i].size(), Paths[i]));
+	}
+	std::sort(order.begin(), order.end());
+
+	RootMap queued;
+	size_t nextWorker = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		// Skip repeats, paths outside of the walked trees and paths beneath a directory that is already queued
+		LPCTSTR path = order[i].second.c_str();
+		size_t rootLength = 0;
+		if ((i > 0 && order[i].second == order[i - 1].second) || !Walked.Contains(path, &rootLength) ||
+			queued.Contains(path))
+		{
+			continue;
+		}
+
+		// The depth of an entry is the number of components it has beneath its root
+		WalkEntry entry = MakeEntry(path, 0, 1, rootLength);
+		entry.Depth = 0;
+		for (LPCTSTR c = entry.RelativePath; *c != 0; c++)
+		{
+			if (*c == PATH_SEPARATOR || c == entry.RelativePath)
+			{
+				entry.Depth++;
+			}
+		}
+
+		// Changes can be reported after the entry is gone again
+		if (!IsReachable(entry.RelativePath, entry.Depth) || GetPathAttributes(path, entry.Attributes) != 0)
+		{
+			continue;
+		}
+
+		// Reparse points must be processed first as they can also be considered a directory.
+		if ((entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+		{
+			if (Filter == NULL || entry.Depth == 0 || Filter->MatchesLinkPath(entry.RelativePath))
+			{
+				Visitor.VisitLink(entry);
+			}
+		}
+		else if ((entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 ||
+			(Filter != NULL && entry.Depth > 0 && Filter->IsExcludedDirectory(entry.RelativePath)))
+		{
+			// Not something the walk would visit
+		}
+		else if (Visitor.VisitDirectory(entry) && CanDescend(entry.Depth))
+		{
+			WalkTask* task = NewTask(path, order[i].first, entry.Depth, rootLength);
+			if (task == NULL)
+			{
+				Visitor.VisitError(entry, ERROR_NOT_ENOUGH_MEMORY);
+				continue;
+			}
+
+			queued.AddRoot(path, path);
+			Push(nextWorker++ % Queues.size(), task);
+		}
+	}
+
+	if (NumPending > 0)
+	{
+		Run();
+	}
+}
+
+int TreeWalker::GetNumWorkers(int NumWorkers)
+{
+	if (NumWorkers <= 0)
+	{
+		NumWorkers = (int)std::thread::hardware_concurrency();
+		if (NumWorkers <= 0)
+		{
+			NumWorkers = 1;
+		}
+	}
+
+	return NumWorkers;
+}
+
+/**
+ * Visits a root and, if it is a directory to descend into, queues it. Roots are handed to the workers in turn so that
+ * each starts out with a root of its own.
+ *
+ * @param Root The full path of the root. A root beneath a directory root that was already added is skipped.
+ * @param NextWorker The worker to queue the next root on. [IN/OUT]
+ * @return Returns zero if the root could be read, otherwise a non-zero value on failure.
+ */
+DWORD TreeWalker::AddRoot(LPCTSTR Root, size_t& NextWorker)
+{
+	// Everything beneath a root that is already queued will be walked anyway
+	if (Walked.Contains(Root))
+	{
+		return 0;
+	}
+
+	size_t rootLength = _tcslen(Root);
+	if (Index != NULL)
+	{
+		Index->AddRoot(Root);
+	}
+
+	// Retrieve the file attributes of the root
+	WalkEntry entry = MakeEntry(Root, 0, 0, rootLength);
+	DWORD result = GetPathAttributes(Root, entry.Attributes);
+	if (result != 0)
+	{
+		Visitor.VisitError(entry, result);
+		return result;
+	}
+
+	// Reparse points must be processed first as they can also be considered a directory.
+	if ((entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+	{
+		Visitor.VisitLink(entry);
+		return 0;
+	}
+	else if ((entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 || !Visitor.VisitDirectory(entry) || !CanDescend(0))
+	{
+		return 0;
+	}
+
+	WalkTask* task = NewTask(Root, rootLength, 0, rootLength);
+	if (task == NULL)
+	{
+		Visitor.VisitError(entry, ERROR_NOT_ENOUGH_MEMORY);
+		return ERROR_NOT_ENOUGH_MEMORY;
+	}
+
+	Walked.AddRoot(Root, Root);
+	Push(NextWorker++ % Queues.size(), task);
+	return 0;
+}
+
+/**
+ * Determines if a walk from the root would reach an entry, which it does unless the entry is too deep or one of the
+ * directories above it is excluded.
+ *
+ * @param RelativePath The path of the entry relative to its root.
+ * @param Depth The level of the entry in the tree.
+ */
+bool TreeWalker::IsReachable(LPCTSTR RelativePath, int Depth) const
+{
+	if (Depth > 0 && !CanDescend(Depth - 1))
+	{
+		return false;
+	}
+	else if (Filter == NULL)
+	{
+		return true;
+	}
+
+	std::basic_string<TCHAR> ancestor;
+	for (LPCTSTR c = RelativePath; *c != 0; c++)
+	{
+		if (*c == PATH_SEPARATOR && Filter->IsExcludedDirectory(ancestor.c_str()))
+		{
+			return false;
+		}
+		ancestor.push_back(*c);
+	}
+
+	return true;
+}
+
+/**
+ * Works through the queued directories with every worker, the calling thread acting as the first, until none are
+ * left.
+ */
+void TreeWalker::Run()
+{
+	std::vector<std::thread*> threads;
+	for (size_t i = 1; i < Queues.size(); i++)
+	{
+		threads.push_back(new std::thread(&TreeWalker::WorkerMain, this, i));
+	}
+
+	WorkerMain(0);
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+}
+
+void TreeWalker::WorkerMain(size_t WorkerIdx)
+{
+	// Reused for the path of every entry this worker enumerates
+	PathBuffer entryPath;
+
+	for (;;)
+	{
+		WalkTask* task = Pop(WorkerIdx);
+		if (task != NULL)
+		{
+			Enumerate(WorkerIdx, task, entryPath);
+			DeleteTask(task);
+
+			// Was that the last directory in the tree? If so wake everybody up so they can exit.
+			if (--NumPending == 0)
+			{
+				std::lock_guard<std::mutex> lock(IdleLock);
+				IdleSignal.notify_all();
+			}
+			continue;
+		}
+
+		// Nothing to steal, wait for another worker to queue something or for the walk to finish
+		std::unique_lock<std::mutex> lock(IdleLock);
+		++NumIdle;
+		while (NumPending > 0 && NumQueued == 0)
+		{
+			IdleSignal.wait(lock);
+		}
+		--NumIdle;
+
+		if (NumPending == 0)
+		{
+			break;
+		}
+	}
+}
+
+void TreeWalker::Push(size_t WorkerIdx, WalkTask* Task)
+{
+	Push(WorkerIdx, &Task, 1);
+}
+
+/**
+ * Pushes several tasks onto the queue of a worker, taking its lock once for all of them.
+ */
+void TreeWalker::Push(size_t WorkerIdx, WalkTask* const* Tasks, size_t NumTasks)
+{
+	NumPending += (long)NumTasks;
+
+	WorkQueue* queue = Queues[WorkerIdx];
+	{
+		std::lock_guard<std::mutex> lock(queue->Lock);
+		queue->Tasks.insert(queue->Tasks.end(), Tasks, Tasks + NumTasks);
+	}
+
+	NumQueued += (long)NumTasks;
+	if (NumIdle > 0)
+	{
+		std::lock_guard<std::mutex> lock(IdleLock);
+		if (NumTasks > 1)
+		{
+			IdleSignal.notify_all();
+		}
+		else
+		{
+			IdleSignal.notify_one();
+		}
+	}
+}
+
+TreeWalker::WalkTask* TreeWalker::Pop(size_t WorkerIdx)
+{
+	// Take from our own queue first. Depth-first takes the most recently found directory, as does breadth-first once
+	// too many directories are waiting.
+	WorkQueue* queue = Queues[WorkerIdx];
+	{
+		std::lock_guard<std::mutex> lock(queue->Lock);
+		if (!queue->Tasks.empty())
+		{
+			WalkTask* task = NULL;
+			if (Order == WalkDepthFirst || NumQueued >= MaxQueuedTasks)
+			{
+				task = queue->Tasks.back();
+				queue->Tasks.pop_back();
+			}
+			else
+			{
+				task = queue->Tasks.front();
+				queue->Tasks.pop_front();
+			}
+			--NumQueued;
+			return task;
+		}
+	}
+
+	// Otherwise steal the oldest directory from somebody else
+	for (size_t i = 1; i < Queues.size(); i++)
+	{
+		WorkQueue* victim = Queues[(WorkerIdx + i) % Queues.size()];
+		std::lock_guard<std::mutex> lock(victim->Lock);
+		if (!victim->Tasks.empty())
+		{
+			WalkTask* task = victim->Tasks.front();
+			victim->Tasks.pop_front();
+			--NumQueued;
+			return task;
+		}
+	}
+
+	return NULL;
+}
+
+void TreeWalker::Enumerate(size_t WorkerIdx, const WalkTask* Task, PathBuffer& EntryPath)
+{
+	EnumerateContext context = { this, WorkerIdx, Task, NULL, &EntryPath, NULL, 0, { NULL }, 0 };
+	DWORD result = 0;
+
+	// Every task path was built in a PathBuffer to begin with, so it always fits
+	EntryPath.Assign(Task->Path, Task->PathLength);
+
+	// Watch the directory before reading it, so that nothing changed while it is read is missed
+	if (Watcher != NULL)
+	{
+		result = Watcher->WatchDirectory(Task->Path);
+		if (result != 0)
+		{
+			Visitor.VisitError(MakeEntry(Task->Path, FILE_ATTRIBUTE_DIRECTORY, Task->Depth, Task->RootLength), result);
+			result = 0;
+		}
+	}
+
+	if (Index == NULL)
+	{
+		result = EnumerateDirectory(Task->Path, &TreeWalker::EnumerateEntries, &context);
+	}
+	else
+	{
+		// Take the stamp before enumerating so that a change made during the enumeration is caught by the next walk
+		ULONGLONG lastWriteTime = 0;
+		result = GetLastWriteTime(Task->Path, lastWriteTime);
+		if (result == 0 && !Index->ReplayDirectory(Task->Path, lastWriteTime, &TreeWalker::EnumerateEntries, &context))
+		{
+			std::vector<LinkIndex::Entry> found;
+			context.Found = &found;
+			result = EnumerateDirectory(Task->Path, &TreeWalker::EnumerateEntries, &context);
+			if (result == 0)
+			{
+				Index->AddDirectory(Task->Path, lastWriteTime, found);
+			}
+		}
+	}
+
+	// Counted once per directory rather than per entry so that the workers don't contend on the counter
+	if (Progress != NULL)
+	{
+		Progress->NumScanned += context.NumEntries;
+		Progress->Depth = Task->Depth;
+	}
+
+	if (result != 0)
+	{
+		Visitor.VisitError(MakeEntry(Task->Path, FILE_ATTRIBUTE_DIRECTORY, Task->Depth, Task->RootLength), result);
+	}
+}
+
+/**
+ * Handles a batch of entries found in a directory, then pushes the subdirectories found in it.
+ */
+void TreeWalker::EnumerateEntries(void* Context, const DirectoryHandle& Directory, const DirectoryEntry* Entries,
+	size_t NumEntries)
+{
+	EnumerateContext* context = (EnumerateContext*)Context;
+	context->NumEntries += NumEntries;
+	context->Directory = &Directory;
+
+	for (size_t i = 0; i < NumEntries; i++)
+	{
+		EnumerateEntry(context, Entries[i]);
+	}
+
+	PushSubdirectories(context);
+}
+
+/**
+ * Pushes the subdirectories held back by EnumerateEntry onto the queue of the enumerating worker.
+ */
+void TreeWalker::PushSubdirectories(EnumerateContext* Context)
+{
+	if (Context->NumSubdirectories > 0)
+	{
+		Context->Walker->Push(Context->WorkerIdx, Context->Subdirectories, Context->NumSubdirectories);
+		Context->NumSubdirectories = 0;
+	}
+}
+
+void TreeWalker::EnumerateEntry(EnumerateContext* Context, const DirectoryEntry& Entry)
+{
+	TreeWalker* walker = Context->Walker;
+	int depth = Context->Parent->Depth + 1;
+	size_t rootLength = Context->Parent->RootLength;
+
+	// Ignore anything that isn't a directory or reparse point
+	if ((Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+		(Entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+	{
+		return;
+	}
+
+	// Build the path of the entry on top of the parent path, then put the parent path back once done with it
+	PathBuffer& filePath = *Context->EntryPath;
+	DWORD result = filePath.AppendName(Entry.Name);
+	if (result != 0)
+	{
+		filePath.Truncate(Context->Parent->PathLength);
+		walker->Visitor.VisitError(MakeEntry(Context->Parent->Path, 0, depth, rootLength), result);
+		return;
+	}
+
+	if (Context->Found != NULL)
+	{
+		LinkIndex::Entry found;
+		found.Name = Entry.Name;
+		found.Attributes = Entry.Attributes;
+		found.ReparseTag = Entry.ReparseTag;
+		Context->Found->push_back(found);
+	}
+
+	// The enumeration already told us what the entry is, there is no need to query it again
+	WalkEntry entry = MakeEntry(filePath.Get(), Entry.Attributes, depth, rootLength);
+	entry.ReparseTag = Entry.ReparseTag;
+	if (Context->Directory->IsOpen())
+	{
+		entry.Directory = Context->Directory;
+		entry.Name = Entry.Name;
+	}
+
+	// Reparse points must be processed first as they can also be considered a directory. Excluded directories are
+	// dropped here, before they are ever queued.
+	const PathFilter* filter = walker->Filter;
+	if ((entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+	{
+		if (filter == NULL || filter->MatchesLinkPath(entry.RelativePath))
+		{
+			walker->Visitor.VisitLink(entry);
+		}
+	}
+	else if (filter != NULL && filter->IsExcludedDirectory(entry.RelativePath))
+	{
+		// Pruned
+	}
+	else if (walker->Visitor.VisitDirectory(entry) && walker->CanDescend(depth))
+	{
+		WalkTask* task = NewTask(filePath.Get(), filePath.Length(), depth, rootLength);
+		if (task != NULL)
+		{
+			Context->Subdirectories[Context->NumSubdirectories++] = task;
+			if (Context->NumSubdirectories == PushBatchSize)
+			{
+				PushSubdirectories(Context);
+			}
+		}
+		else
+		{
+			walker->Visitor.VisitError(entry, ERROR_NOT_ENOUGH_MEMORY);
+		}
+	}
+
+	filePath.Truncate(Context->Parent->PathLength);
+}
+
+/**
+ * Allocates a task with room for the entire path after it.
+ */
+TreeWalker::WalkTask* TreeWalker::NewTask(LPCTSTR Path, size_t PathLength, int Depth, size_t RootLength)
+{
+	WalkTask* task = (WalkTask*)malloc(offsetof(WalkTask, Path) + (PathLength + 1) * sizeof(TCHAR));
+	if (task != NULL)
+	{
+		task->Depth = Depth;
+		task->RootLength = RootLength;
+		task->PathLength = PathLength;
+		memcpy(task->Path, Path, PathLength * sizeof(TCHAR));
+		task->Path[PathLength] = 0;
+	}
+
+	return task;
+}
+
+void TreeWalker::DeleteTask(WalkTask* Task)
+{
+	free(Task);
+}
+
+WalkEntry TreeWalker::MakeEntry(LPCTSTR Path, DWORD Attributes, int Depth, size_t RootLength)
+{
+	WalkEntry entry;
+	entry.Path = Path;
+	entry.Attributes = Attributes;
+	entry.ReparseTag = 0;
+	entry.Depth = Depth;
+	entry.Directory = NULL;
+	entry.Name = Path;
+
+	// Paths below the root share its prefix, the remainder (minus the separator) is the relative path
+	entry.RelativePath = Path + (Depth > 0 ? RootLength : _tcslen(Path));
+	if (*entry.RelativePath == PATH_SEPARATOR)
+	{
+		entry.RelativePath++;
+	}
+
+	return entry;
+}
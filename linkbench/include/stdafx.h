@@ -27,41 +27,25 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///////////////////////////////////////////////////////////////////////////////
 
-#ifndef DATATYPES_H
-#define DATATYPES_H
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
 #pragma once
 
-#include <memory.h>
+// linkbench also builds on Linux, where the engines run against the POSIX backend
+#ifdef _WIN32
+
+#include "targetver.h"
 
-struct rmlinkOptions
-{
-	/** Set to true to enable verbose logging. */
-	bool bVerbose;
-	/** The maximum file tree depth to traverse before stopping. */
-	int MaxDepth;
+#include <stdio.h>
+#include <tchar.h>
 
-	rmlinkOptions()
-		: bVerbose(false)
-		, MaxDepth(-1)
-	{
-	}
-};
+#include <Windows.h>
 
-struct rmlinkStats
-{
-	/** The number of file objects that failed to be moved. */
-	size_t NumFailed;
-	/** The number of file objects successfully deleted. */
-	size_t NumDeleted;
-	/** The number of file objects that were skipped. */
-	size_t NumSkipped;
+#else
 
-	rmlinkStats()
-		: NumFailed(0)
-		, NumDeleted(0)
-		, NumSkipped(0)
-	{
-	}
-};
+#include <stdio.h>
 
-#endif //DATATYPES_H
\ No newline at end of file
+#endif //_WIN32
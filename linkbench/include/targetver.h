@@ -27,47 +27,13 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///////////////////////////////////////////////////////////////////////////////
 
-#ifndef DATATYPES_H
-#define DATATYPES_H
 #pragma once
 
-#include <memory.h>
+// Including SDKDDKVer.h defines the highest available Windows platform.
 
-struct fixlinkOptions
-{
-	/** Set to true to enable verbose logging. */
-	bool bVerbose;
-	/** The maximum file tree depth to traverse before stopping. */
-	int MaxDepth;
-	/** The path to rebase targets to. */
-	TCHAR NewTargetBase[MAX_PATH];
-	/** The path to rebase targets from. */
-	TCHAR OldTargetBase[MAX_PATH];
+// If you wish to build your application for a previous Windows platform, include WinSDKVer.h and
+// set the _WIN32_WINNT macro to the platform you wish to support before including SDKDDKVer.h.
 
-	fixlinkOptions()
-		: bVerbose(false)
-		, MaxDepth(-1)
-	{
-		memset(NewTargetBase, 0, sizeof(NewTargetBase));
-		memset(OldTargetBase, 0, sizeof(OldTargetBase));
-	}
-};
+#include <winsdkver.h>
 
-struct fixlinkStats
-{
-	/** The number of file objects that failed to be moved. */
-	size_t NumFailed;
-	/** The number of file objects successfully modified. */
-	size_t NumModified;
-	/** The number of file objects that were skipped. */
-	size_t NumSkipped;
-
-	fixlinkStats()
-		: NumFailed(0)
-		, NumModified(0)
-		, NumSkipped(0)
-	{
-	}
-};
-
-#endif //DATATYPES_H
\ No newline at end of file
+#define _WIN32_WINNT _WIN32_WINNT_VISTA
\ No newline at end of file
@@ -0,0 +1,591 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+
+#include <chrono>
+#include <memory.h>
+
+#ifdef _WIN32
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "CopyLink.h"
+#include "FileSystem.h"
+#include "FixLink.h"
+#include "Log.h"
+#include "MemoryFileSystem.h"
+#include "MoveLink.h"
+#include "NtfsLinks.h"
+#include "RemoveLink.h"
+#include "ReparsePoint.h"
+
+using namespace libntfslinks;
+
+struct linkbenchOptions
+{
+	/** The number of directory levels to generate below the root. */
+	int Depth;
+	/** The number of subdirectories to generate in each directory. */
+	int FanOut;
+	/** The number of plain files to generate in each directory. */
+	int NumFiles;
+	/** The number of links to generate in each directory. */
+	int NumLinks;
+	/** The percentage of generated links that are junctions rather than symbolic links. */
+	int JunctionPercent;
+	/** The number of worker threads the engines traverse the tree with. Zero uses one per processor. */
+	int NumThreads;
+	/** Set to true to leave the generated trees in place when finished. */
+	bool bKeep;
+	/** Set to true to run against an in-memory file system instead of the disk. */
+	bool bMemory;
+	/** The delay added to every operation of the in-memory file system, in microseconds. */
+	int Latency;
+	/** The size of the buffer directories are read into, in kilobytes. Zero keeps the default. */
+	int BufferSize;
+
+	linkbenchOptions()
+		: Depth(4)
+		, FanOut(8)
+		, NumFiles(4)
+		, NumLinks(2)
+		, JunctionPercent(50)
+		, NumThreads(0)
+		, bKeep(false)
+		, bMemory(false)
+		, Latency(0)
+		, BufferSize(0)
+	{
+	}
+};
+
+struct linkbenchStats
+{
+	/** The number of directories generated, not counting the root. */
+	size_t NumDirectories;
+	/** The number of plain files generated. */
+	size_t NumFiles;
+	/** The number of links generated. */
+	size_t NumLinks;
+
+	linkbenchStats()
+		: NumDirectories(0)
+		, NumFiles(0)
+		, NumLinks(0)
+	{
+	}
+};
+
+linkbenchOptions Options;
+linkbenchStats Stats;
+MemoryFileSystem MemoryBackend;
+
+/**
+ * Returns the number of file system calls made by the process so far.
+ */
+ULONGLONG GetSystemCallCount()
+{
+	if (Options.bMemory)
+	{
+		return MemoryBackend.GetOperationCount();
+	}
+
+#ifdef _WIN32
+	IO_COUNTERS counters = {0};
+	GetProcessIoCounters(GetCurrentProcess(), &counters);
+	return counters.ReadOperationCount + counters.WriteOperationCount + counters.OtherOperationCount;
+#else
+	return NumSystemCalls;
+#endif
+}
+
+/**
+ * Returns the peak resident set size of the process, in kilobytes.
+ */
+size_t GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {0};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss;
+#endif
+}
+
+/**
+ * Returns the given full path in the form that link targets are stored in, without the long path prefix.
+ */
+LPCTSTR GetLinkTarget(LPCTSTR Path)
+{
+#ifdef _WIN32
+	if (_tcsncmp(Path, TEXT("\\\\?\\"), 4) == 0 && Path[5] == ':')
+	{
+		return Path + 4;
+	}
+#endif
+	return Path;
+}
+
+/**
+ * Generates one level of the synthetic tree at Path.
+ */
+DWORD GenerateTree(LPCTSTR Path, LPCTSTR Target, int Depth)
+{
+	DWORD result = 0;
+	PathBuffer ChildPath;
+
+	for (int i = 0; i < Options.NumFiles && result == 0; i++)
+	{
+		TCHAR Name[32];
+		StringCchPrintf(Name, ARRAYSIZE(Name), TEXT("file%d"), i);
+		result = CombinePath(ChildPath, Path, Name);
+		if (result == 0)
+		{
+			result = GetFileSystemBackend().CreateEmptyFile(ChildPath.Get());
+			Stats.NumFiles++;
+		}
+	}
+
+	// Spread the junctions evenly through the tree
+	for (int i = 0; i < Options.NumLinks && result == 0; i++)
+	{
+		TCHAR Name[32];
+		StringCchPrintf(Name, ARRAYSIZE(Name), TEXT("link%d"), i);
+		result = CombinePath(ChildPath, Path, Name);
+		if (result == 0)
+		{
+			bool bJunction = (int)(Stats.NumLinks % 100) < Options.JunctionPercent;
+			result = CreateReparseLink(bJunction ? IO_REPARSE_TAG_MOUNT_POINT : IO_REPARSE_TAG_SYMLINK, ChildPath.Get(),
+				Target);
+			Stats.NumLinks++;
+		}
+	}
+
+	for (int i = 0; i < Options.FanOut && Depth < Options.Depth && result == 0; i++)
+	{
+		TCHAR Name[32];
+		StringCchPrintf(Name, ARRAYSIZE(Name), TEXT("dir%d"), i);
+		result = CombinePath(ChildPath, Path, Name);
+		if (result == 0)
+		{
+			result = CreateDirectoryFrom(Path, ChildPath.Get());
+		}
+		if (result == 0)
+		{
+			Stats.NumDirectories++;
+			result = GenerateTree(ChildPath.Get(), Target, Depth + 1);
+		}
+	}
+
+	return result;
+}
+
+/** Context passed through EnumerateDirectory to DeleteTreeEntries. */
+struct DeleteContext
+{
+	/** The path of the directory being deleted. */
+	LPCTSTR Path;
+	/** The first error that occurred. */
+	DWORD Result;
+};
+
+/**
+ * Deletes a generated tree, including Path itself.
+ */
+DWORD DeleteTree(LPCTSTR Path);
+
+void DeleteTreeEntry(DeleteContext* context, const DirectoryHandle& Directory, const DirectoryEntry& Entry)
+{
+	PathBuffer ChildPath;
+	DWORD result = CombinePath(ChildPath, context->Path, Entry.Name);
+	if (result != 0)
+	{
+		// Nothing to do
+	}
+	else if ((Entry.Attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+	{
+		result = DeleteReparseLinkAt(Entry.ReparseTag, &Directory, Entry.Name);
+	}
+	else if ((Entry.Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+	{
+		result = DeleteTree(ChildPath.Get());
+	}
+	else
+	{
+		result = GetFileSystemBackend().RemoveFile(ChildPath.Get());
+	}
+
+	if (context->Result == 0)
+	{
+		context->Result = result;
+	}
+}
+
+/**
+ * Deletes each entry of a batch found by EnumerateDirectory.
+ */
+void DeleteTreeEntries(void* Context, const DirectoryHandle& Directory, const DirectoryEntry* Entries,
+	size_t NumEntries)
+{
+	for (size_t i = 0; i < NumEntries; i++)
+	{
+		DeleteTreeEntry((DeleteContext*)Context, Directory, Entries[i]);
+	}
+}
+
+DWORD DeleteTree(LPCTSTR Path)
+{
+	DeleteContext context = { Path, 0 };
+	DWORD result = EnumerateDirectory(Path, &DeleteTreeEntries, &context);
+	if (result == 0)
+	{
+		result = context.Result;
+	}
+	if (result == 0)
+	{
+		result = GetFileSystemBackend().RemoveEmptyDirectory(Path);
+	}
+
+	return result;
+}
+
+/**
+ * Measures a single engine run from construction to destruction and prints the results.
+ */
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer(LPCTSTR Name, size_t NumEntries)
+		: Name(Name)
+		, NumEntries(NumEntries)
+		, StartCalls(GetSystemCallCount())
+		, StartTime(std::chrono::high_resolution_clock::now())
+	{
+	}
+
+	/**
+	 * Prints the results of the run.
+	 *
+	 * @param NumLinks The number of links the engine processed.
+	 */
+	void Report(size_t NumLinks)
+	{
+		std::chrono::high_resolution_clock::duration elapsed = std::chrono::high_resolution_clock::now() - StartTime;
+		double seconds = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000000.0;
+		if (seconds <= 0.0)
+		{
+			seconds = 0.000001;
+		}
+
+		_tprintf(TEXT("%-10s %10.3f %12.0f %12.0f %12llu %12llu\n"), Name, seconds, NumEntries / seconds,
+			NumLinks / seconds, (unsigned long long)(GetSystemCallCount() - StartCalls),
+			(unsigned long long)GetPeakMemoryUsage());
+	}
+
+private:
+	LPCTSTR Name;
+	size_t NumEntries;
+	ULONGLONG StartCalls;
+	std::chrono::high_resolution_clock::time_point StartTime;
+};
+
+void PrintUsage()
+{
+	_tprintf(TEXT("Generates a synthetic tree of links and measures each of the link utilities against it.\n\n"));
+	_tprintf(TEXT("Usage: linkbench [/BUF:n] [/DEPTH:n] [/FANOUT:n] [/FILES:n] [/LINKS:n] [/JUNCTIONS:n] [/MEM[:n]] [/MT[:n]] [/KEEP] <path>\n\n"));
+	_tprintf(TEXT("Options:\n"));
+	_tprintf(TEXT("\t\t/BUF:n\t\tRead directories into a buffer of n kilobytes, where the platform allows it.\n"));
+	_tprintf(TEXT("\t\t/DEPTH:n\tGenerate n levels of directories (default is 4).\n"));
+	_tprintf(TEXT("\t\t/FANOUT:n\tGenerate n subdirectories in each directory (default is 8).\n"));
+	_tprintf(TEXT("\t\t/FILES:n\tGenerate n plain files in each directory (default is 4).\n"));
+	_tprintf(TEXT("\t\t/JUNCTIONS:n\tMake n percent of the links junctions instead of symbolic links (default is 50).\n"));
+	_tprintf(TEXT("\t\t/KEEP\t\tLeave the generated trees in place when finished.\n"));
+	_tprintf(TEXT("\t\t/LINKS:n\tGenerate n links in each directory (default is 2).\n"));
+	_tprintf(TEXT("\t\t/MEM[:n]\tRun against an in-memory file system, adding n microseconds to each operation.\n"));
+	_tprintf(TEXT("\t\t/MT[:n]\t\tUse n threads to traverse the directory tree (default is one per processor).\n"));
+	_tprintf(TEXT("\t\t/VER\t\tDisplay the version and copyright information.\n"));
+	_tprintf(TEXT("\t\t/?\t\tView this list of options.\n"));
+}
+
+void PrintVersion()
+{
+	_tprintf(TEXT("Copyright (C) 2014, Jean-Philippe Steinmetz. All rights reserved.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("Redistribution and use in source and binary forms, with or without\n"));
+	_tprintf(TEXT("modification, are permitted provided that the following conditions are met:\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("* Redistributions of source code must retain the above copyright notice, this\n"));
+	_tprintf(TEXT("  list of conditions and the following disclaimer.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("* Redistributions in binary form must reproduce the above copyright notice,\n"));
+	_tprintf(TEXT("  this list of conditions and the following disclaimer in the documentation\n"));
+	_tprintf(TEXT("  and/or other materials provided with the distribution.\n"));
+	_tprintf(TEXT("\n"));
+	_tprintf(TEXT("THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS \"AS IS\"\n"));
+	_tprintf(TEXT("AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE\n"));
+	_tprintf(TEXT("IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE\n"));
+	_tprintf(TEXT("DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE\n"));
+	_tprintf(TEXT("FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL\n"));
+	_tprintf(TEXT("DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR\n"));
+	_tprintf(TEXT("SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER\n"));
+	_tprintf(TEXT("CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,\n"));
+	_tprintf(TEXT("OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE\n"));
+	_tprintf(TEXT("OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.\n"));
+}
+
+int _tmain(int argc, TCHAR* argv[])
+{
+	DWORD result = 0;
+	int requiredArgs = 2;
+	LPCTSTR Root = NULL;
+
+	// Parse the command line arguments. Options are only matched at the start of an argument as POSIX paths begin
+	// with '/' as well.
+	for (int i = 1; i < argc; i++)
+	{
+		if (StrFind(argv[i], TEXT("/VER")) == 0 || StrFind(argv[i], TEXT("/ver")) == 0)
+		{
+			PrintVersion();
+			return 0;
+		}
+		else if (StrFind(argv[i], TEXT("/?")) == 0)
+		{
+			PrintUsage();
+			return 0;
+		}
+		else if (StrFind(argv[i], TEXT("/BUF:")) == 0 || StrFind(argv[i], TEXT("/buf:")) == 0)
+		{
+			Options.BufferSize = _ttoi(&argv[i][5]);
+		}
+		else if (StrFind(argv[i], TEXT("/DEPTH:")) == 0 || StrFind(argv[i], TEXT("/depth:")) == 0)
+		{
+			Options.Depth = _ttoi(&argv[i][7]);
+		}
+		else if (StrFind(argv[i], TEXT("/FANOUT:")) == 0 || StrFind(argv[i], TEXT("/fanout:")) == 0)
+		{
+			Options.FanOut = _ttoi(&argv[i][8]);
+		}
+		else if (StrFind(argv[i], TEXT("/FILES:")) == 0 || StrFind(argv[i], TEXT("/files:")) == 0)
+		{
+			Options.NumFiles = _ttoi(&argv[i][7]);
+		}
+		else if (StrFind(argv[i], TEXT("/LINKS:")) == 0 || StrFind(argv[i], TEXT("/links:")) == 0)
+		{
+			Options.NumLinks = _ttoi(&argv[i][7]);
+		}
+		else if (StrFind(argv[i], TEXT("/JUNCTIONS:")) == 0 || StrFind(argv[i], TEXT("/junctions:")) == 0)
+		{
+			Options.JunctionPercent = _ttoi(&argv[i][11]);
+		}
+		else if (StrFind(argv[i], TEXT("/KEEP")) == 0 || StrFind(argv[i], TEXT("/keep")) == 0)
+		{
+			Options.bKeep = true;
+		}
+		else if (StrFind(argv[i], TEXT("/MEM")) == 0 || StrFind(argv[i], TEXT("/mem")) == 0)
+		{
+			Options.bMemory = true;
+			Options.Latency = argv[i][4] == ':' ? _ttoi(&argv[i][5]) : 0;
+		}
+		else if (StrFind(argv[i], TEXT("/MT")) == 0 || StrFind(argv[i], TEXT("/mt")) == 0)
+		{
+			Options.NumThreads = argv[i][3] == ':' ? _ttoi(&argv[i][4]) : 0;
+		}
+		else
+		{
+			Root = argv[i];
+		}
+	}
+
+	// Check the minimum required arguments
+	if (argc < requiredArgs || Root == NULL)
+	{
+		_tprintf(TEXT("Error: Missing argument(s).\n"));
+		PrintUsage();
+		return 1;
+	}
+
+	// Lay out the benchmark directory. The source tree links to Target, which fixlink then rebases to NewTarget.
+	PathBuffer RootPath, SrcPath, CopyPath, MovePath, TargetPath, NewTargetPath;
+	DWORD attributes = 0;
+	if (GetFullPath(Root, RootPath) != 0 ||
+		CombinePath(SrcPath, RootPath.Get(), TEXT("src")) != 0 ||
+		CombinePath(CopyPath, RootPath.Get(), TEXT("copy")) != 0 ||
+		CombinePath(MovePath, RootPath.Get(), TEXT("moved")) != 0 ||
+		CombinePath(TargetPath, RootPath.Get(), TEXT("target")) != 0 ||
+		CombinePath(NewTargetPath, RootPath.Get(), TEXT("newtarget")) != 0)
+	{
+		_tprintf(TEXT("Invalid benchmark path specified.\n"));
+		return 1;
+	}
+
+	if (Options.BufferSize > 0)
+	{
+		SetEnumerateBufferSize((size_t)Options.BufferSize * 1024);
+	}
+
+	// The in-memory tree starts out with just the benchmark path in it
+	if (Options.bMemory)
+	{
+		MemoryBackend.SetLatency((DWORD)Options.Latency);
+		MemoryBackend.AddDirectory(RootPath.Get());
+		SetFileSystemBackend(&MemoryBackend);
+	}
+
+	if (GetPathAttributes(SrcPath.Get(), attributes) == 0 || GetPathAttributes(CopyPath.Get(), attributes) == 0 ||
+		GetPathAttributes(MovePath.Get(), attributes) == 0)
+	{
+		_tprintf(TEXT("The benchmark path %s already contains a generated tree.\n"), RootPath.Get());
+		return 1;
+	}
+
+	// Generate the source tree
+	bool bCreatedRoot = false;
+	if (GetPathAttributes(RootPath.Get(), attributes) != 0)
+	{
+		result = CreateDirectoryFrom(RootPath.Get(), RootPath.Get());
+		bCreatedRoot = result == 0;
+	}
+	if (result == 0)
+	{
+		result = CreateDirectoryFrom(RootPath.Get(), SrcPath.Get());
+	}
+	if (result == 0)
+	{
+		result = CreateDirectoryFrom(RootPath.Get(), TargetPath.Get());
+	}
+	if (result == 0)
+	{
+		result = CreateDirectoryFrom(RootPath.Get(), NewTargetPath.Get());
+	}
+
+	ULONGLONG startCalls = GetSystemCallCount();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (result == 0)
+	{
+		result = GenerateTree(SrcPath.Get(), GetLinkTarget(TargetPath.Get()), 0);
+	}
+	if (result != 0)
+	{
+		_tprintf(TEXT("Failed to generate the benchmark tree (error %u).\n"), (unsigned)result);
+		return 1;
+	}
+
+	std::chrono::high_resolution_clock::duration elapsed = std::chrono::high_resolution_clock::now() - start;
+	_tprintf(TEXT("Generated %u directories, %u files and %u links in %.3f seconds (%llu calls).\n\n"),
+		(unsigned)Stats.NumDirectories, (unsigned)Stats.NumFiles, (unsigned)Stats.NumLinks,
+		std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000000.0,
+		(unsigned long long)(GetSystemCallCount() - startCalls));
+
+	// The source tree also contains the plain files, the trees built from it contain only directories and links
+	size_t numSrcEntries = Stats.NumDirectories + Stats.NumFiles + Stats.NumLinks;
+	size_t numLinkEntries = Stats.NumDirectories + Stats.NumLinks;
+	size_t numFailed = 0;
+
+	_tprintf(TEXT("%-10s %10s %12s %12s %12s %12s\n"), TEXT("engine"), TEXT("seconds"), TEXT("entries/s"),
+		TEXT("links/s"), TEXT("calls"), TEXT("peak KB"));
+
+	{
+		cplinkOptions options;
+		options.NumThreads = Options.NumThreads;
+		cplinkStats stats;
+		BenchmarkTimer timer(TEXT("cplink"), numSrcEntries);
+		cplink(SrcPath.Get(), CopyPath.Get(), options, stats);
+		timer.Report(stats.NumCopied);
+		numFailed += stats.NumFailed;
+	}
+
+	{
+		fixlinkOptions options;
+		options.NumThreads = Options.NumThreads;
+		StringCchCopy(options.OldTargetBase, ARRAYSIZE(options.OldTargetBase), GetLinkTarget(TargetPath.Get()));
+		StringCchCopy(options.NewTargetBase, ARRAYSIZE(options.NewTargetBase), GetLinkTarget(NewTargetPath.Get()));
+		fixlinkStats stats;
+		BenchmarkTimer timer(TEXT("fixlink"), numLinkEntries);
+		fixlink(CopyPath.Get(), options, stats);
+		timer.Report(stats.NumModified);
+		numFailed += stats.NumFailed;
+	}
+
+	{
+		mvlinkOptions options;
+		options.NumThreads = Options.NumThreads;
+		mvlinkStats stats;
+		BenchmarkTimer timer(TEXT("mvlink"), numLinkEntries);
+		mvlink(CopyPath.Get(), MovePath.Get(), options, stats);
+		timer.Report(stats.NumMoved);
+		numFailed += stats.NumFailed;
+	}
+
+	{
+		rmlinkOptions options;
+		options.NumThreads = Options.NumThreads;
+		rmlinkStats stats;
+		BenchmarkTimer timer(TEXT("rmlink"), numLinkEntries);
+		rmlink(MovePath.Get(), options, stats);
+		timer.Report(stats.NumDeleted);
+		numFailed += stats.NumFailed;
+	}
+
+	// Write out any errors the engines logged
+	CloseLog();
+
+	if (numFailed > 0)
+	{
+		_tprintf(TEXT("\nFailed: %d\n"), (int)numFailed);
+		result = 1;
+	}
+
+	// Clean up after ourselves, leaving the benchmark path itself alone unless we created it
+	if (!Options.bKeep)
+	{
+		LPCTSTR Generated[] = { SrcPath.Get(), CopyPath.Get(), MovePath.Get(), TargetPath.Get(), NewTargetPath.Get(),
+			RootPath.Get() };
+		size_t numGenerated = ARRAYSIZE(Generated) - (bCreatedRoot ? 0 : 1);
+		for (size_t i = 0; i < numGenerated; i++)
+		{
+			DWORD cleanupResult = 0;
+			if (GetPathAttributes(Generated[i], attributes) == 0)
+			{
+				cleanupResult = DeleteTree(Generated[i]);
+			}
+			if (cleanupResult != 0)
+			{
+				_tprintf(TEXT("Failed to delete %s (error %u).\n"), Generated[i], (unsigned)cleanupResult);
+			}
+		}
+	}
+
+	return result;
+}
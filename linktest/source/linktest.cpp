@@ -0,0 +1,599 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ActionPlan.h"
+#include "FileSystem.h"
+#include "Log.h"
+#include "MemoryFileSystem.h"
+#include "MoveJournal.h"
+#include "MoveLink.h"
+#include "ReparsePoint.h"
+#include "RewriteRules.h"
+#include "RootMap.h"
+#include "TreeWalker.h"
+
+using namespace libntfslinks;
+
+typedef std::basic_string<TCHAR> String;
+
+/** The number of checks that have failed so far. */
+int NumFailures = 0;
+MemoryFileSystem MemoryBackend;
+/** The full path of the directory that every test builds its tree beneath. */
+PathBuffer RootPath;
+
+/**
+ * Reports a check that failed.
+ */
+void Check(bool bPassed, LPCTSTR Expression, int Line)
+{
+	if (!bPassed)
+	{
+		_tprintf(TEXT("\tFailed at line %d: %s\n"), Line, Expression);
+		NumFailures++;
+	}
+}
+
+#define CHECK(Condition) Check((Condition), TEXT(#Condition), __LINE__)
+
+/**
+ * Returns the full path of an entry of the test tree, given relative to RootPath with '/' separators.
+ */
+String MakePath(LPCTSTR RelativePath)
+{
+	String path(RootPath.Get());
+	if (RelativePath[0] != 0)
+	{
+		path.push_back(PATH_SEPARATOR);
+		path.append(RelativePath);
+	}
+	std::replace(path.begin(), path.end(), (TCHAR)'/', (TCHAR)PATH_SEPARATOR);
+	return path;
+}
+
+/**
+ * Returns the given path with '/' separators replaced by the separator of the platform.
+ */
+String NativePath(LPCTSTR Path)
+{
+	String path(Path);
+	std::replace(path.begin(), path.end(), (TCHAR)'/', (TCHAR)PATH_SEPARATOR);
+	return path;
+}
+
+/**
+ * Creates a directory of the test tree, given relative to RootPath.
+ */
+void MakeDirectory(LPCTSTR RelativePath)
+{
+	CHECK(CreateDirectoryFrom(RootPath.Get(), MakePath(RelativePath).c_str()) == 0);
+}
+
+/**
+ * Creates a symbolic link of the test tree, given relative to RootPath.
+ */
+void MakeLink(LPCTSTR RelativePath, LPCTSTR Target)
+{
+	CHECK(CreateReparseLink(IO_REPARSE_TAG_SYMLINK, MakePath(RelativePath).c_str(), Target) == 0);
+}
+
+/**
+ * Returns the target of a link of the test tree, or an empty string if there is no link there.
+ */
+String ReadTarget(LPCTSTR RelativePath)
+{
+	ReparsePointInfo info;
+	if (GetReparsePointInfo(MakePath(RelativePath).c_str(), info) != 0)
+	{
+		return String();
+	}
+	return info.Target.Get();
+}
+
+/**
+ * Records every entry that a walk visits, in the order visited.
+ */
+class RecordingVisitor : public TreeVisitor
+{
+public:
+	struct Visit
+	{
+		String Path;
+		int Depth;
+	};
+
+	RecordingVisitor()
+		: NumErrors(0)
+	{
+	}
+
+	virtual bool VisitDirectory(const WalkEntry& Entry)
+	{
+		Add(Entry);
+		return true;
+	}
+
+	virtual void VisitLink(const WalkEntry& Entry)
+	{
+		Add(Entry);
+	}
+
+	virtual void VisitError(const WalkEntry& /*Entry*/, DWORD /*ErrorCode*/)
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		NumErrors++;
+	}
+
+	/** Returns the number of times the entry at the given relative path was visited. */
+	size_t Count(LPCTSTR RelativePath) const
+	{
+		String path = MakePath(RelativePath);
+		size_t count = 0;
+		for (size_t i = 0; i < Visits.size(); i++)
+		{
+			count += Visits[i].Path == path ? 1 : 0;
+		}
+		return count;
+	}
+
+	/** Returns the depth that the entry at the given relative path was visited at, or -1 if it wasn't. */
+	int GetDepth(LPCTSTR RelativePath) const
+	{
+		String path = MakePath(RelativePath);
+		for (size_t i = 0; i < Visits.size(); i++)
+		{
+			if (Visits[i].Path == path)
+			{
+				return Visits[i].Depth;
+			}
+		}
+		return -1;
+	}
+
+	/**
+	 * Returns the directories that were enumerated, in the order their first entry was visited. Every entry but a
+	 * root is visited while its parent is being enumerated.
+	 */
+	std::vector<String> GetEnumerated() const
+	{
+		std::vector<String> enumerated;
+		for (size_t i = 0; i < Visits.size(); i++)
+		{
+			String parent = Visits[i].Path.substr(0, Visits[i].Path.rfind(PATH_SEPARATOR));
+			if (Visits[i].Depth > 0 && std::find(enumerated.begin(), enumerated.end(), parent) == enumerated.end())
+			{
+				enumerated.push_back(parent);
+			}
+		}
+		return enumerated;
+	}
+
+	std::vector<Visit> Visits;
+	int NumErrors;
+
+private:
+	void Add(const WalkEntry& Entry)
+	{
+		Visit visit = { Entry.Path, Entry.Depth };
+		std::lock_guard<std::mutex> lock(Lock);
+		Visits.push_back(visit);
+	}
+
+	std::mutex Lock;
+};
+
+/**
+ * Builds the tree that the walker tests run against:
+ *
+ *		walk/a/a1/l3
+ *		walk/a/l2
+ *		walk/b/b1/l4
+ *		walk/b/l2b
+ *		walk/l1
+ */
+void MakeWalkTree()
+{
+	MakeDirectory(TEXT("walk"));
+	MakeDirectory(TEXT("walk/a"));
+	MakeDirectory(TEXT("walk/a/a1"));
+	MakeDirectory(TEXT("walk/b"));
+	MakeDirectory(TEXT("walk/b/b1"));
+	MakeLink(TEXT("walk/l1"), TEXT("t1"));
+	MakeLink(TEXT("walk/a/l2"), TEXT("t2"));
+	MakeLink(TEXT("walk/b/l2b"), TEXT("t2b"));
+	MakeLink(TEXT("walk/a/a1/l3"), TEXT("t3"));
+	MakeLink(TEXT("walk/b/b1/l4"), TEXT("t4"));
+}
+
+/** The entries of the walk tree, relative to RootPath. */
+LPCTSTR WalkEntries[] =
+{
+	TEXT("walk"), TEXT("walk/a"), TEXT("walk/a/a1"), TEXT("walk/b"), TEXT("walk/b/b1"), TEXT("walk/l1"),
+	TEXT("walk/a/l2"), TEXT("walk/b/l2b"), TEXT("walk/a/a1/l3"), TEXT("walk/b/b1/l4")
+};
+
+void TestWalkDepthFirst()
+{
+	RecordingVisitor visitor;
+	TreeWalker walker(visitor, 1, -1, NULL, WalkDepthFirst);
+	CHECK(walker.Walk(MakePath(TEXT("walk")).c_str()) == 0);
+
+	CHECK(visitor.NumErrors == 0);
+	CHECK(visitor.Visits.size() == ARRAYSIZE(WalkEntries));
+	for (size_t i = 0; i < ARRAYSIZE(WalkEntries); i++)
+	{
+		CHECK(visitor.Count(WalkEntries[i]) == 1);
+	}
+	CHECK(visitor.GetDepth(TEXT("walk")) == 0);
+	CHECK(visitor.GetDepth(TEXT("walk/a/a1")) == 2);
+	CHECK(visitor.GetDepth(TEXT("walk/a/a1/l3")) == 3);
+
+	// Each subtree is finished before its siblings, so the directories beneath a directory are enumerated right after it
+	std::vector<String> enumerated = visitor.GetEnumerated();
+	CHECK(enumerated.size() == 5);
+	for (size_t i = 0; i < enumerated.size(); i++)
+	{
+		String prefix = enumerated[i] + PATH_SEPARATOR;
+		size_t end = i + 1;
+		while (end < enumerated.size() && enumerated[end].compare(0, prefix.size(), prefix) == 0)
+		{
+			end++;
+		}
+		for (size_t j = end; j < enumerated.size(); j++)
+		{
+			CHECK(enumerated[j].compare(0, prefix.size(), prefix) != 0);
+		}
+	}
+}
+
+void TestWalkBreadthFirst()
+{
+	RecordingVisitor visitor;
+	TreeWalker walker(visitor, 1, -1, NULL, WalkBreadthFirst);
+	CHECK(walker.Walk(MakePath(TEXT("walk")).c_str()) == 0);
+
+	CHECK(visitor.NumErrors == 0);
+	CHECK(visitor.Visits.size() == ARRAYSIZE(WalkEntries));
+	for (size_t i = 0; i < ARRAYSIZE(WalkEntries); i++)
+	{
+		CHECK(visitor.Count(WalkEntries[i]) == 1);
+	}
+
+	// Every directory of a level is enumerated before any of the next
+	std::vector<String> enumerated = visitor.GetEnumerated();
+	CHECK(enumerated.size() == 5);
+	for (size_t i = 1; i < enumerated.size(); i++)
+	{
+		CHECK(std::count(enumerated[i-1].begin(), enumerated[i-1].end(), (TCHAR)PATH_SEPARATOR) <=
+			std::count(enumerated[i].begin(), enumerated[i].end(), (TCHAR)PATH_SEPARATOR));
+	}
+}
+
+void TestWalkMaxDepth()
+{
+	RecordingVisitor shallow;
+	TreeWalker shallowWalker(shallow, 2, 1);
+	CHECK(shallowWalker.Walk(MakePath(TEXT("walk")).c_str()) == 0);
+	CHECK(shallow.Visits.size() == 4);
+	CHECK(shallow.Count(TEXT("walk/a")) == 1);
+	CHECK(shallow.Count(TEXT("walk/l1")) == 1);
+	CHECK(shallow.Count(TEXT("walk/a/l2")) == 0);
+
+	RecordingVisitor deeper;
+	TreeWalker deeperWalker(deeper, 2, 2);
+	CHECK(deeperWalker.Walk(MakePath(TEXT("walk")).c_str()) == 0);
+	CHECK(deeper.Visits.size() == 8);
+	CHECK(deeper.Count(TEXT("walk/a/a1")) == 1);
+	CHECK(deeper.Count(TEXT("walk/b/l2b")) == 1);
+	CHECK(deeper.Count(TEXT("walk/a/a1/l3")) == 0);
+	CHECK(deeper.Count(TEXT("walk/b/b1/l4")) == 0);
+}
+
+void TestWalkMultipleRoots()
+{
+	// Separate roots are walked together, with depths counted from each
+	String a = MakePath(TEXT("walk/a"));
+	String b = MakePath(TEXT("walk/b"));
+	std::vector<LPCTSTR> roots;
+	roots.push_back(a.c_str());
+	roots.push_back(b.c_str());
+
+	RecordingVisitor separate;
+	TreeWalker separateWalker(separate, 4);
+	CHECK(separateWalker.Walk(roots) == 0);
+	CHECK(separate.Visits.size() == 8);
+	CHECK(separate.Count(TEXT("walk")) == 0);
+	CHECK(separate.Count(TEXT("walk/l1")) == 0);
+	CHECK(separate.GetDepth(TEXT("walk/a")) == 0);
+	CHECK(separate.GetDepth(TEXT("walk/b/b1/l4")) == 2);
+
+	// Repeated and nested roots are dropped, so each entry is visited once, at its depth beneath the outermost root
+	String walk = MakePath(TEXT("walk"));
+	String a1 = MakePath(TEXT("walk/a/a1"));
+	roots.push_back(a1.c_str());
+	roots.push_back(walk.c_str());
+	roots.push_back(a.c_str());
+
+	RecordingVisitor nested;
+	TreeWalker nestedWalker(nested, 4);
+	CHECK(nestedWalker.Walk(roots) == 0);
+	CHECK(nested.Visits.size() == ARRAYSIZE(WalkEntries));
+	for (size_t i = 0; i < ARRAYSIZE(WalkEntries); i++)
+	{
+		CHECK(nested.Count(WalkEntries[i]) == 1);
+	}
+	CHECK(nested.GetDepth(TEXT("walk/a/a1")) == 2);
+}
+
+void TestRootNormalization()
+{
+	// The same root spelled in different ways is only walked once. RootPath is below the current directory.
+	String plain = NativePath(TEXT("linktest.tmp/walk/a"));
+	String dotted = NativePath(TEXT("./linktest.tmp/walk/a/"));
+	String doubled = NativePath(TEXT("linktest.tmp//walk/./b/../a"));
+	std::vector<LPCTSTR> roots;
+	roots.push_back(plain.c_str());
+	roots.push_back(dotted.c_str());
+	roots.push_back(doubled.c_str());
+
+	RecordingVisitor visitor;
+	TreeWalker walker(visitor, 2);
+	CHECK(walker.Walk(roots) == 0);
+	CHECK(visitor.NumErrors == 0);
+	CHECK(visitor.Visits.size() == 4);
+	CHECK(visitor.Count(TEXT("walk/a")) == 1);
+	CHECK(visitor.Count(TEXT("walk/a/a1/l3")) == 1);
+
+	PathBuffer fullPath;
+	CHECK(GetFullPath(doubled.c_str(), fullPath) == 0);
+	CHECK(MakePath(TEXT("walk/a")) == fullPath.Get());
+}
+
+void TestRewriteRules()
+{
+	RewriteRules rules;
+	rules.AddRule(TEXT("/old"), TEXT("/new"));
+	rules.AddRule(TEXT("/old/deep"), TEXT("/deeper"));
+	rules.AddRule(TEXT("ab"), TEXT("1"));
+	rules.AddRule(TEXT("b"), TEXT("2"));
+	rules.Compile();
+
+	PathBuffer result;
+	CHECK(rules.Rewrite(TEXT("/old/x"), result) == 0);
+	CHECK(_tcscmp(result.Get(), TEXT("/new/x")) == 0);
+
+	// Of the matches at the same position the longest wins
+	CHECK(rules.Rewrite(TEXT("/old/deep/x"), result) == 0);
+	CHECK(_tcscmp(result.Get(), TEXT("/deeper/x")) == 0);
+
+	// Of overlapping matches the leftmost wins, and every match is replaced
+	CHECK(rules.Rewrite(TEXT("xab/b/ab"), result) == 0);
+	CHECK(_tcscmp(result.Get(), TEXT("x1/2/1")) == 0);
+
+	CHECK(rules.Rewrite(TEXT("/unrelated"), result) == 0);
+	CHECK(_tcscmp(result.Get(), TEXT("/unrelated")) == 0);
+}
+
+void TestRootMap()
+{
+	String data = NativePath(TEXT("/data"));
+	String dataDeep = NativePath(TEXT("/data/deep"));
+	String dataSlash = NativePath(TEXT("/data/"));
+
+	RootMap roots;
+	roots.AddRoot(data.c_str(), NativePath(TEXT("/one")).c_str());
+	roots.AddRoot(dataDeep.c_str(), NativePath(TEXT("/deeper")).c_str());
+
+	PathBuffer result;
+	CHECK(roots.Rebase(NativePath(TEXT("/data/x")).c_str(), result) == 0);
+	CHECK(NativePath(TEXT("/one/x")) == result.Get());
+
+	// The deepest root wins and only whole components match
+	CHECK(roots.Rebase(NativePath(TEXT("/data/deep/y")).c_str(), result) == 0);
+	CHECK(NativePath(TEXT("/deeper/y")) == result.Get());
+	CHECK(roots.Rebase(NativePath(TEXT("/database/x")).c_str(), result) == 0);
+	CHECK(NativePath(TEXT("/database/x")) == result.Get());
+	CHECK(!roots.Contains(NativePath(TEXT("/database")).c_str()));
+	CHECK(roots.Contains(data.c_str()));
+
+	// A root added again, even with a trailing separator, replaces the first
+	roots.AddRoot(dataSlash.c_str(), NativePath(TEXT("/two")).c_str());
+	CHECK(roots.Rebase(NativePath(TEXT("/data/x")).c_str(), result) == 0);
+	CHECK(NativePath(TEXT("/two/x")) == result.Get());
+	CHECK(roots.Rebase(NativePath(TEXT("/data/deep/y")).c_str(), result) == 0);
+	CHECK(NativePath(TEXT("/deeper/y")) == result.Get());
+}
+
+void TestActionPlanRoundTrip()
+{
+	LPCTSTR planPath = TEXT("linktest.plan");
+	PlanAction written[] =
+	{
+		{ PlanCreateDirectory, 0, TEXT("C:\\src\\dir"), TEXT("D:\\dest\\dir"), TEXT(""), TEXT("") },
+		{ PlanCopy, IO_REPARSE_TAG_SYMLINK, TEXT("C:\\src\\a \"quoted\" link"), TEXT("D:\\dest\\link"),
+			TEXT("C:\\t"), TEXT("D:\\t") },
+		{ PlanMove, IO_REPARSE_TAG_MOUNT_POINT, TEXT("/src/junction"), TEXT("/dest/junction"), TEXT("/t/\ttab"),
+			TEXT("/u") },
+		{ PlanFix, IO_REPARSE_TAG_SYMLINK, TEXT("/src/fixed"), TEXT(""), TEXT("/old"), TEXT("/new") },
+		{ PlanRemove, IO_REPARSE_TAG_SYMLINK, TEXT("/src/removed"), TEXT(""), TEXT("/old"), TEXT("") }
+	};
+
+	ActionPlan plan;
+	CHECK(plan.Create(planPath) == 0);
+	for (size_t i = 0; i < ARRAYSIZE(written); i++)
+	{
+		const PlanAction& action = written[i];
+		plan.Add(action.Operation, action.Tag, action.Src.c_str(), action.Dest.empty() ? NULL : action.Dest.c_str(),
+			action.OldTarget.empty() ? NULL : action.OldTarget.c_str(),
+			action.NewTarget.empty() ? NULL : action.NewTarget.c_str());
+	}
+	CHECK(plan.Close() == 0);
+
+	std::vector<PlanAction> read;
+	CHECK(ActionPlan::Load(planPath, read) == 0);
+	CHECK(read.size() == ARRAYSIZE(written));
+	for (size_t i = 0; i < read.size() && i < ARRAYSIZE(written); i++)
+	{
+		CHECK(read[i].Operation == written[i].Operation);
+		CHECK(read[i].Tag == written[i].Tag);
+		CHECK(read[i].Src == written[i].Src);
+		CHECK(read[i].Dest == written[i].Dest);
+		CHECK(read[i].OldTarget == written[i].OldTarget);
+		CHECK(read[i].NewTarget == written[i].NewTarget);
+	}
+
+	_tremove(planPath);
+}
+
+void TestMoveJournalResume()
+{
+	LPCTSTR journalPath = TEXT("linktest.journal");
+	String src = MakePath(TEXT("move/src"));
+	String dest = MakePath(TEXT("move/dest"));
+	String link0 = MakePath(TEXT("move/src/l0"));
+
+	MakeDirectory(TEXT("move"));
+	MakeDirectory(TEXT("move/src"));
+	MakeDirectory(TEXT("move/dest"));
+	MakeLink(TEXT("move/src/l0"), TEXT("t0"));
+	MakeLink(TEXT("move/src/l1"), TEXT("t1"));
+	MakeLink(TEXT("move/src/l2"), TEXT("t2"));
+
+	// An interrupted run created the destination of l0 but deleted nothing. The created link is given a different
+	// target so that it shows whether the resumed run left it alone.
+	MakeLink(TEXT("move/dest/l0"), TEXT("kept"));
+	{
+		MoveJournal journal;
+		CHECK(journal.Open(journalPath, src.c_str(), dest.c_str()) == 0);
+		journal.AddCreated(link0.c_str(), IO_REPARSE_TAG_SYMLINK);
+		CHECK(journal.Close(false) == 0);
+	}
+
+	// The journal only resumes the move it belongs to
+	{
+		MoveJournal journal;
+		CHECK(journal.Open(journalPath, dest.c_str(), src.c_str()) == ERROR_BAD_FORMAT);
+	}
+	{
+		MoveJournal journal;
+		DWORD tag = 0;
+		CHECK(journal.Open(journalPath, src.c_str(), dest.c_str()) == 0);
+		CHECK(!journal.IsEnumerated());
+		CHECK(journal.FindCreated(link0.c_str(), tag) && tag == IO_REPARSE_TAG_SYMLINK);
+		CHECK(journal.Close(false) == 0);
+	}
+
+	mvlinkOptions options;
+	options.JournalPath.Assign(journalPath);
+	mvlinkStats stats;
+	CHECK(mvlink(src.c_str(), dest.c_str(), options, stats) == 0);
+	CHECK(stats.NumFailed == 0);
+
+	CHECK(ReadTarget(TEXT("move/dest/l0")) == TEXT("kept"));
+	CHECK(ReadTarget(TEXT("move/dest/l1")) == TEXT("t1"));
+	CHECK(ReadTarget(TEXT("move/dest/l2")) == TEXT("t2"));
+	CHECK(ReadTarget(TEXT("move/src/l0")).empty());
+	CHECK(ReadTarget(TEXT("move/src/l1")).empty());
+	CHECK(ReadTarget(TEXT("move/src/l2")).empty());
+
+	// The journal is deleted once the move completes
+	FILE* file = _tfopen(journalPath, TEXT("r"));
+	CHECK(file == NULL);
+	if (file != NULL)
+	{
+		fclose(file);
+		_tremove(journalPath);
+	}
+}
+
+void PrintUsage()
+{
+	_tprintf(TEXT("Runs the tests of libntfslinkutils against an in-memory file system.\n\n"));
+	_tprintf(TEXT("Usage: linktest\n\n"));
+	_tprintf(TEXT("Plan and journal files are written to the current directory while the tests run.\n"));
+}
+
+struct TestInfo
+{
+	LPCTSTR Name;
+	void (*Run)();
+};
+
+const TestInfo TestTable[] =
+{
+	{ TEXT("TreeWalker depth-first"), &TestWalkDepthFirst },
+	{ TEXT("TreeWalker breadth-first"), &TestWalkBreadthFirst },
+	{ TEXT("TreeWalker maximum depth"), &TestWalkMaxDepth },
+	{ TEXT("TreeWalker multiple roots"), &TestWalkMultipleRoots },
+	{ TEXT("Root path normalization"), &TestRootNormalization },
+	{ TEXT("RewriteRules"), &TestRewriteRules },
+	{ TEXT("RootMap"), &TestRootMap },
+	{ TEXT("ActionPlan round trip"), &TestActionPlanRoundTrip },
+	{ TEXT("MoveJournal resume"), &TestMoveJournalResume },
+};
+
+int _tmain(int argc, TCHAR* argv[])
+{
+	if (argc > 1)
+	{
+		PrintUsage();
+		return _tcscmp(argv[1], TEXT("/?")) == 0 ? 0 : 1;
+	}
+
+	// The in-memory tree starts out with just the test directory in it
+	if (GetFullPath(TEXT("linktest.tmp"), RootPath) != 0 || MemoryBackend.AddDirectory(RootPath.Get()) != 0)
+	{
+		_tprintf(TEXT("Unable to create the test directory.\n"));
+		return 1;
+	}
+	SetFileSystemBackend(&MemoryBackend);
+	MakeWalkTree();
+
+	int numFailedTests = 0;
+	for (size_t i = 0; i < ARRAYSIZE(TestTable); i++)
+	{
+		int numFailures = NumFailures;
+		TestTable[i].Run();
+		_tprintf(TEXT("%-30s %s\n"), TestTable[i].Name, NumFailures == numFailures ? TEXT("passed") : TEXT("FAILED"));
+		numFailedTests += NumFailures == numFailures ? 0 : 1;
+	}
+
+	SetFileSystemBackend(NULL);
+	CloseLog();
+
+	_tprintf(TEXT("\n%d of %d tests failed.\n"), numFailedTests, (int)ARRAYSIZE(TestTable));
+	return numFailedTests == 0 ? 0 : 1;
+}
@@ -27,47 +27,25 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ///////////////////////////////////////////////////////////////////////////////
 
-#ifndef DATATYPES_H
-#define DATATYPES_H
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
 #pragma once
 
-#include <memory.h>
+// ntfslink also builds on Linux, where the commands run against the POSIX backend
+#ifdef _WIN32
+
+#include "targetver.h"
 
-struct cplinkOptions
-{
-	/** Set to true to enable verbose logging. */
-	bool bVerbose;
-	/** The maximum file tree depth to traverse before stopping. */
-	int MaxDepth;
-	/** The path to rebase targets to. */
-	TCHAR NewTargetBase[MAX_PATH];
-	/** The path to rebase targets from. */
-	TCHAR OldTargetBase[MAX_PATH];
+#include <stdio.h>
+#include <tchar.h>
 
-	cplinkOptions()
-		: bVerbose(false)
-		, MaxDepth(-1)
-	{
-		memset(NewTargetBase, 0, sizeof(NewTargetBase));
-		memset(OldTargetBase, 0, sizeof(OldTargetBase));
-	}
-};
+#include <Windows.h>
 
-struct cplinkStats
-{
-	/** The number of file objects that failed to be moved. */
-	size_t NumFailed;
-	/** The number of file objects successfully copied. */
-	size_t NumCopied;
-	/** The number of file objects that were skipped. */
-	size_t NumSkipped;
+#else
 
-	cplinkStats()
-		: NumFailed(0)
-		, NumCopied(0)
-		, NumSkipped(0)
-	{
-	}
-};
+#include <stdio.h>
 
-#endif //DATATYPES_H
\ No newline at end of file
+#endif //_WIN32
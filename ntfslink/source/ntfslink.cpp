@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is part of ntfslinkutils.
+//
+// Copyright (c) 2014, Jean-Philippe Steinmetz
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+// 
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+
+#include "LinkCommand.h"
+
+void PrintUsage()
+{
+	_tprintf(TEXT("Runs any of the link utilities from a single program.\n\n"));
+	_tprintf(TEXT("Usage: ntfslink <command> [options] <path>...\n\n"));
+	_tprintf(TEXT("When copied or linked to the name of a utility, such as cplink, runs that utility instead.\n"));
+	_tprintf(TEXT("Use ntfslink <command> /? to view the options of a command.\n\n"));
+	_tprintf(TEXT("Commands:\n"));
+	PrintLinkCommands();
+}
+
+int _tmain(int argc, TCHAR* argv[])
+{
+	// Run as the utility that the program was invoked as, such as a link named cplink
+	LinkCommand command;
+	if (FindLinkCommand(argv[0], command))
+	{
+		return RunLinkCommand(command, argc, argv);
+	}
+
+	// Otherwise the first argument names the command, which is then run with the remaining arguments
+	if (argc > 1 && FindLinkCommand(argv[1], command))
+	{
+		return RunLinkCommand(command, argc - 1, &argv[1]);
+	}
+	else if (argc > 1 && (_tcscmp(argv[1], TEXT("/VER")) == 0 || _tcscmp(argv[1], TEXT("/ver")) == 0))
+	{
+		PrintLinkVersion();
+		return 0;
+	}
+	else if (argc > 1 && _tcscmp(argv[1], TEXT("/?")) == 0)
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	if (argc > 1)
+	{
+		_tprintf(TEXT("Error: Unknown command %s.\n"), argv[1]);
+	}
+	PrintUsage();
+	return 1;
+}